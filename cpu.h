@@ -37,6 +37,9 @@
 /*
  * 0x00-0xEF : Code (240 bytes)
  * 0xF0-0xFF : Stack (16 bytes)
+ *
+ * The stack grows down from STACK_BASE over STACK_SIZE bytes; both can be
+ * overridden at build time (-DSTACK_BASE=0x7F -DSTACK_SIZE=64).
  */
 
 // Legacy constants (kept for compatibility)
@@ -45,9 +48,16 @@
 
 // Memory layout
 #define CODE_BASE 0x00
+#ifndef STACK_BASE
 #define STACK_BASE 0xFF
+#endif
+#ifndef STACK_SIZE
 #define STACK_SIZE 16
+#endif
+#define STACK_LIMIT (STACK_BASE - STACK_SIZE + 1) // Lowest stack slot
 #define MAX_MEMORY_SIZE 256
+_Static_assert(STACK_BASE < MAX_MEMORY_SIZE, "stack outside memory");
+_Static_assert(STACK_SIZE >= 1 && STACK_LIMIT >= 0, "bad stack size");
 
 // Registers
 enum {
@@ -91,6 +101,11 @@ enum {
   OPCODE_INX,        // Increment X
   OPCODE_DEX,        // Decrement X
   OPCODE_HALT,       // Halt
+  OPCODE_JSR,        // Jump to subroutine (push return address)
+  OPCODE_RTS,        // Return from subroutine
+  OPCODE_JMP,        // Jump to the effective address (indirect: [$a], [$a,X])
+  OPCODE_MOVE,       // Copy A bytes from the effective address to X
+  OPCODE_FILL,       // Store the operand value into A bytes from X
 
   OPCODE_COUNT // Number of opcodes (DON'T REMOVE)
 };
@@ -111,6 +126,13 @@ enum {
 _Static_assert(MODE_COUNT <= 256, "too many addressing modes");
 _Static_assert(MODE_COUNT <= 8, "too many addressing modes for packed format");
 
+// Mode sets (bit n = mode n), see opcode_modes
+#define MODES_ANY ((1 << MODE_COUNT) - 1)
+#define MODES_VALUE                                                            \
+  ((1 << MODE_IMMEDIAT) | (1 << MODE_ABSOLUTE) | (1 << MODE_ABSOLUTE_X) |      \
+   (1 << MODE_INDIRECT) | (1 << MODE_INDIRECT_X))
+#define MODES_STORE (MODES_VALUE & ~(1 << MODE_IMMEDIAT))
+
 // Branch conditions (byte après OPCODE_B)
 enum {
   COND_AL = 0x00, // Always (unconditional jump)
@@ -120,17 +142,78 @@ enum {
   COND_CC,        // Carry Clear (C=0)
   COND_MI,        // Minus/Negative (N=1)
   COND_PL,        // Plus/Positive (N=0)
+
+  COND_COUNT // Number of branch conditions (DON'T REMOVE)
+};
+_Static_assert(COND_COUNT <= 8, "too many branch conditions for packed format");
+
+/* PUSH/POP in MODE_REGISTER take a register mask as operand: the selected
+   registers are pushed in A, X, flags order and popped in reverse, so the
+   same mask restores them. Popping flags restores C, Z, N, O; a masked POP
+   leaves the flags alone otherwise. Other modes, and a mask selecting no
+   register (operand 0), push/pop A (POP sets Z, N).
+   Compatibility: PUSH/POP used to move A whatever the mode and operand.
+   MODE_REGISTER with operand 0 still does, but a mask selecting registers
+   changes what moves: PUSH in MODE_REGISTER with operand 2 pushes X.
+   JSR pushes the address of the next instruction and jumps to the operand;
+   RTS pops it back into PC. */
+enum {
+  STACK_REG_A = 1 << 0,     // Accumulator
+  STACK_REG_X = 1 << 1,     // Index register
+  STACK_REG_FLAGS = 1 << 2, // C, Z, N, O
+  STACK_REGS_ALL = STACK_REG_A | STACK_REG_X | STACK_REG_FLAGS
+};
+
+// Flags saved by PUSH/restored by POP (HALTED is not architectural state)
+#define FLAG_ARITH (FLAG_CARRY | FLAG_ZERO | FLAG_NEGATIVE | FLAG_OVERFLOW)
+
+/* Branch lookup table: for each of the 32 flag states (C, Z, N, O, HALTED),
+   a 7-bit mask of the conditions that are taken */
+#define BRANCH_MASK(f)                                                         \
+  ((1 << COND_AL) | (((f) & FLAG_ZERO) ? 1 << COND_EQ : 1 << COND_NE) |        \
+   (((f) & FLAG_CARRY) ? 1 << COND_CS : 1 << COND_CC) |                        \
+   (((f) & FLAG_NEGATIVE) ? 1 << COND_MI : 1 << COND_PL))
+#define BRANCH_MASK4(f)                                                        \
+  BRANCH_MASK(f), BRANCH_MASK((f) + 1), BRANCH_MASK((f) + 2),                  \
+      BRANCH_MASK((f) + 3)
+#define BRANCH_MASK16(f)                                                       \
+  BRANCH_MASK4(f), BRANCH_MASK4((f) + 4), BRANCH_MASK4((f) + 8),               \
+      BRANCH_MASK4((f) + 12)
+
+#define FLAG_STATES 32
+static const uint8_t branch_taken_mask[FLAG_STATES] = {
+    BRANCH_MASK16(0),
+    BRANCH_MASK16(16),
 };
 
 // CPU
+// Aligned on the struct (not the typedef) so sizeof(CPU) is padded to 320
+// and arrays of CPU keep every instance on a cache line boundary
+typedef struct __attribute__((aligned(64))) {
+  uint8_t A;                       // Accumulator
+  uint8_t X;                       // Index register
+  uint8_t PC;                      // Program Counter
+  uint8_t SP;                      // Stack Pointer
+  uint8_t flags;                   // Status flags·
+  uint8_t memory[MAX_MEMORY_SIZE]; // 256 bytes of memory
+} CPU;
+
+// 256-bit bitmap: one bit per address (or per PC value)
 typedef struct {
-  uint8_t A;                        // Accumulator
-  uint8_t X;                        // Index register
-  uint8_t PC;                       // Program Counter
-  uint8_t SP;                       // Stack Pointer
-  uint8_t flags;                    // Status flags·
-  uint8_t memory[MAX_MEMORY_SIZE];  // 256 bytes of memory
-} CPU __attribute__((aligned(64))); // Align to cache line size for performance
+  uint64_t bits[MAX_MEMORY_SIZE / 64];
+} cpu_bitmap;
+
+static inline void bitmap_set(cpu_bitmap *map, uint8_t index) {
+  map->bits[index >> 6] |= (uint64_t)1 << (index & 63);
+}
+
+static inline void bitmap_clear(cpu_bitmap *map, uint8_t index) {
+  map->bits[index >> 6] &= ~((uint64_t)1 << (index & 63));
+}
+
+static inline int bitmap_test(const cpu_bitmap *map, uint8_t index) {
+  return (int)((map->bits[index >> 6] >> (index & 63)) & 1);
+}
 
 /* Fast address calculation helper used by STA, STX */
 static inline uint8_t get_effective_address(const CPU *cpu, uint8_t mode,
@@ -166,6 +249,157 @@ static inline uint8_t get_operand_value(const CPU *cpu, uint8_t mode,
   __builtin_unreachable();  // Unreachable - mode validated in cpu_step
 }
 
+/* Register-passing twins of the helpers above, for engines that keep X in a
+   local instead of reloading it through the CPU pointer */
+static inline uint8_t effective_address_x(const uint8_t *memory, uint8_t x,
+                                          uint8_t mode, uint8_t operand) {
+  switch (mode) {
+  case MODE_ABSOLUTE:
+    return operand;
+  case MODE_ABSOLUTE_X:
+    return (uint8_t)(operand + x);
+  case MODE_INDIRECT:
+    return memory[operand];
+  case MODE_INDIRECT_X:
+    return memory[(uint8_t)(operand + x)];
+  }
+  __builtin_unreachable();
+}
+
+static inline uint8_t operand_value_x(const uint8_t *memory, uint8_t x,
+                                      uint8_t mode, uint8_t operand) {
+  if (mode == MODE_IMMEDIAT)
+    return operand;
+  return memory[effective_address_x(memory, x, mode, operand)];
+}
+
+/* Value-returning flag helpers (same results as the UPDATE_* macros) */
+static inline uint8_t flags_zn(uint8_t flags, uint8_t value) {
+  flags &= (uint8_t)~(FLAG_ZERO | FLAG_NEGATIVE);
+  flags |= (value == 0) ? FLAG_ZERO : 0;
+  flags |= (value & 0x80) ? FLAG_NEGATIVE : 0;
+  return flags;
+}
+
+static inline uint8_t flags_znc(uint8_t flags, uint8_t value, int carry) {
+  flags = flags_zn(flags, value);
+  flags &= (uint8_t)~FLAG_CARRY;
+  flags |= carry ? FLAG_CARRY : 0;
+  return flags;
+}
+
+/* Flags of ADD (A + value), result returned through *result */
+static inline uint8_t flags_add(uint8_t flags, uint8_t a, uint8_t value,
+                                uint8_t *result) {
+  uint16_t sum = (uint16_t)(a + value);
+  uint8_t r = (uint8_t)sum;
+  flags = flags_znc(flags, r, sum > 0xFF);
+  flags &= (uint8_t)~FLAG_OVERFLOW;
+  flags |= (((a ^ value) & 0x80) == 0 && ((a ^ r) & 0x80) != 0)
+               ? FLAG_OVERFLOW
+               : 0;
+  *result = r;
+  return flags;
+}
+
+/* Flags of SUB / CMP / CPX (reg - value), result returned through *result */
+static inline uint8_t flags_sub(uint8_t flags, uint8_t reg, uint8_t value,
+                                uint8_t *result) {
+  uint16_t diff = (uint16_t)(reg - value);
+  uint8_t r = (uint8_t)diff;
+  flags = flags_znc(flags, r, diff < 0x100);
+  flags &= (uint8_t)~FLAG_OVERFLOW;
+  flags |= (((reg ^ value) & 0x80) != 0 && ((reg ^ r) & 0x80) != 0)
+               ? FLAG_OVERFLOW
+               : 0;
+  *result = r;
+  return flags;
+}
+
+/* Branch condition test on a flags value: one table lookup. The condition
+   is validated at decode time (< COND_COUNT); the mask keeps the shift
+   defined for unvalidated input, where bit 7 reads as not taken. */
+static inline int branch_taken(uint8_t flags, uint8_t condition) {
+  return (branch_taken_mask[flags & (FLAG_STATES - 1)] >> (condition & 7)) & 1;
+}
+
+/* Whether a PUSH/POP moves the registers of its mask (else A alone) */
+static inline int stack_masked(uint8_t mode, uint8_t operand) {
+  return mode == MODE_REGISTER && (operand & STACK_REGS_ALL) != 0;
+}
+
+/* Bytes moved by a PUSH/POP with this mode and operand */
+static inline unsigned stack_count(uint8_t mode, uint8_t operand) {
+  if (!stack_masked(mode, operand))
+    return 1;
+  return (unsigned)__builtin_popcount(operand & STACK_REGS_ALL);
+}
+
+/* Room for count more bytes / count bytes to pop at this SP */
+static inline int stack_can_push(uint8_t sp, unsigned count) {
+  return sp + 1u >= (unsigned)STACK_LIMIT + count;
+}
+
+static inline int stack_can_pop(uint8_t sp, unsigned count) {
+  return sp + count <= (unsigned)STACK_BASE;
+}
+
+/* MOVE/FILL bodies: count bytes at dst, addresses wrapping at 256 like the
+   address arithmetic of get_effective_address. MOVE copies as memmove does
+   (the destination gets the source bytes as they were before the copy,
+   overlap or not); both go through the host memmove/memset. */
+static inline void memory_move(uint8_t *memory, uint8_t dst, uint8_t src,
+                               uint8_t count) {
+  if (count == 0 || dst == src)
+    return;
+  if ((unsigned)src + count <= MAX_MEMORY_SIZE &&
+      (unsigned)dst + count <= MAX_MEMORY_SIZE) {
+    __builtin_memmove(memory + dst, memory + src, count);
+    return;
+  }
+
+  // A range wraps: gather the source, then scatter it
+  uint8_t buffer[MAX_MEMORY_SIZE];
+  unsigned head = (unsigned)(MAX_MEMORY_SIZE - src);
+  head = head < count ? head : count;
+  __builtin_memcpy(buffer, memory + src, head);
+  __builtin_memcpy(buffer + head, memory, count - head);
+  head = (unsigned)(MAX_MEMORY_SIZE - dst);
+  head = head < count ? head : count;
+  __builtin_memcpy(memory + dst, buffer, head);
+  __builtin_memcpy(memory, buffer + head, count - head);
+}
+
+static inline void memory_fill(uint8_t *memory, uint8_t dst, uint8_t value,
+                               uint8_t count) {
+  unsigned head = (unsigned)(MAX_MEMORY_SIZE - dst);
+  head = head < count ? head : count;
+  __builtin_memset(memory + dst, value, head);
+  __builtin_memset(memory, value, count - head);
+}
+
+/* Register-mask PUSH/POP bodies on lvalues, bounds already checked */
+#define STACK_PUSH_REGS(memory, sp, regs, a, x, flags)                         \
+  do {                                                                         \
+    if ((regs) & STACK_REG_A)                                                  \
+      (memory)[(sp)--] = (a);                                                  \
+    if ((regs) & STACK_REG_X)                                                  \
+      (memory)[(sp)--] = (x);                                                  \
+    if ((regs) & STACK_REG_FLAGS)                                              \
+      (memory)[(sp)--] = (uint8_t)((flags) & FLAG_ARITH);                      \
+  } while (0)
+
+#define STACK_POP_REGS(memory, sp, regs, a, x, flags)                          \
+  do {                                                                         \
+    if ((regs) & STACK_REG_FLAGS)                                              \
+      (flags) = (uint8_t)(((flags) & ~FLAG_ARITH) |                            \
+                          ((memory)[++(sp)] & FLAG_ARITH));                    \
+    if ((regs) & STACK_REG_X)                                                  \
+      (x) = (memory)[++(sp)];                                                  \
+    if ((regs) & STACK_REG_A)                                                  \
+      (a) = (memory)[++(sp)];                                                  \
+  } while (0)
+
 // Define a function pointer type for opcode handlers
 typedef void (*opcode_handler)(CPU *, uint8_t, uint8_t);
 /* CPU Step function pointer type */
@@ -175,33 +409,55 @@ typedef int (*cpu_step_fn)(CPU *);
 // OPCODE HANDLERS - OPTIMIZED FOR PERFORMANCE
 // ============================================================================
 
-static inline void op_nop(CPU *cpu, uint8_t mode, uint8_t operand) {
+/* Handlers are always inlined into direct calls: the table entries still
+   get a copy, and the per-ISA loops of cpu_dispatch.c, which call them from
+   a switch, get the bodies compiled for their level */
+#define OPCODE_HANDLER static inline __attribute__((always_inline)) void
+
+/* The decoders only reject mode >= MODE_COUNT. Handlers whose address
+   helpers have no case for some of the remaining modes (an immediate store
+   or jump target, a register operand) halt on them, as on any invalid
+   mode. */
+#define HALT_UNLESS_MODE(modes, mode)                                          \
+  do {                                                                         \
+    if (UNLIKELY(!(((modes) >> (mode)) & 1))) {                                \
+      cpu->flags |= FLAG_HALTED;                                               \
+      return;                                                                  \
+    }                                                                          \
+  } while (0)
+
+OPCODE_HANDLER op_nop(CPU *cpu, uint8_t mode, uint8_t operand) {
   (void)cpu;
   (void)mode;
   (void)operand;
 }
 
-static inline void op_lda(CPU *cpu, uint8_t mode, uint8_t operand) {
+OPCODE_HANDLER op_lda(CPU *cpu, uint8_t mode, uint8_t operand) {
+  HALT_UNLESS_MODE(MODES_VALUE, mode);
   cpu->A = get_operand_value(cpu, mode, operand);
   UPDATE_ZN_FLAGS(cpu, cpu->A);
 }
 
-static void op_ldx(CPU *cpu, uint8_t mode, uint8_t operand) {
+OPCODE_HANDLER op_ldx(CPU *cpu, uint8_t mode, uint8_t operand) {
+  HALT_UNLESS_MODE(MODES_VALUE, mode);
   cpu->X = get_operand_value(cpu, mode, operand);
   UPDATE_ZN_FLAGS(cpu, cpu->X);
 }
 
-static inline void op_sta(CPU *cpu, uint8_t mode, uint8_t operand) {
+OPCODE_HANDLER op_sta(CPU *cpu, uint8_t mode, uint8_t operand) {
+  HALT_UNLESS_MODE(MODES_STORE, mode);
   uint8_t address = get_effective_address(cpu, mode, operand);
   cpu->memory[address] = cpu->A;
 }
 
-static void op_stx(CPU *cpu, uint8_t mode, uint8_t operand) {
+OPCODE_HANDLER op_stx(CPU *cpu, uint8_t mode, uint8_t operand) {
+  HALT_UNLESS_MODE(MODES_STORE, mode);
   uint8_t address = get_effective_address(cpu, mode, operand);
   cpu->memory[address] = cpu->X;
 }
 
-static void op_add(CPU *cpu, uint8_t mode, uint8_t operand) {
+OPCODE_HANDLER op_add(CPU *cpu, uint8_t mode, uint8_t operand) {
+  HALT_UNLESS_MODE(MODES_VALUE, mode);
   uint8_t value = get_operand_value(cpu, mode, operand);
 
   uint8_t original_A = cpu->A;
@@ -219,7 +475,8 @@ static void op_add(CPU *cpu, uint8_t mode, uint8_t operand) {
                     : 0;
 }
 
-static void op_sub(CPU *cpu, uint8_t mode, uint8_t operand) {
+OPCODE_HANDLER op_sub(CPU *cpu, uint8_t mode, uint8_t operand) {
+  HALT_UNLESS_MODE(MODES_VALUE, mode);
   uint8_t value = get_operand_value(cpu, mode, operand);
 
   uint8_t original_A = cpu->A;
@@ -237,62 +494,38 @@ static void op_sub(CPU *cpu, uint8_t mode, uint8_t operand) {
                     : 0;
 }
 
-static void op_and(CPU *cpu, uint8_t mode, uint8_t operand) {
+OPCODE_HANDLER op_and(CPU *cpu, uint8_t mode, uint8_t operand) {
+  HALT_UNLESS_MODE(MODES_VALUE, mode);
   uint8_t value = get_operand_value(cpu, mode, operand);
 
   cpu->A &= value;
   UPDATE_ZN_FLAGS(cpu, cpu->A);
 }
 
-static void op_xor(CPU *cpu, uint8_t mode, uint8_t operand) {
+OPCODE_HANDLER op_xor(CPU *cpu, uint8_t mode, uint8_t operand) {
+  HALT_UNLESS_MODE(MODES_VALUE, mode);
   uint8_t value = get_operand_value(cpu, mode, operand);
 
   cpu->A ^= value;
   UPDATE_ZN_FLAGS(cpu, cpu->A);
 }
 
-static void op_or(CPU *cpu, uint8_t mode, uint8_t operand) {
+OPCODE_HANDLER op_or(CPU *cpu, uint8_t mode, uint8_t operand) {
+  HALT_UNLESS_MODE(MODES_VALUE, mode);
   uint8_t value = get_operand_value(cpu, mode, operand);
 
   cpu->A |= value;
   UPDATE_ZN_FLAGS(cpu, cpu->A);
 }
 
-// Optimized branch instruction - most common cases first
-static void op_branch(CPU *cpu, uint8_t condition, uint8_t address) {
-  // Optimize for most common conditions with direct flag checks
-  switch (condition) {
-  case COND_AL: // Always - most common, unconditional
-    cpu->PC = address;
-    break;
-  case COND_EQ: // Equal (Z=1) - very common
-    if (LIKELY(cpu->flags & FLAG_ZERO))
-      cpu->PC = address;
-    break;
-  case COND_NE: // Not Equal (Z=0) - very common
-    if (LIKELY(!(cpu->flags & FLAG_ZERO)))
-      cpu->PC = address;
-    break;
-  case COND_CS: // Carry Set (C=1)
-    if (cpu->flags & FLAG_CARRY)
-      cpu->PC = address;
-    break;
-  case COND_CC: // Carry Clear (C=0)
-    if (!(cpu->flags & FLAG_CARRY))
-      cpu->PC = address;
-    break;
-  case COND_MI: // Minus/Negative (N=1)
-    if (cpu->flags & FLAG_NEGATIVE)
-      cpu->PC = address;
-    break;
-  case COND_PL: // Plus/Positive (N=0)
-    if (!(cpu->flags & FLAG_NEGATIVE))
-      cpu->PC = address;
-    break;
-  }
+// Branch instruction: table lookup + conditional move of the PC
+OPCODE_HANDLER op_branch(CPU *cpu, uint8_t condition, uint8_t address) {
+  int taken = branch_taken(cpu->flags, condition);
+  cpu->PC = taken ? address : cpu->PC;
 }
 
-static void op_cmp(CPU *cpu, uint8_t mode, uint8_t operand) {
+OPCODE_HANDLER op_cmp(CPU *cpu, uint8_t mode, uint8_t operand) {
+  HALT_UNLESS_MODE(MODES_VALUE, mode);
   uint8_t value = get_operand_value(cpu, mode, operand);
 
   // Perform comparison (A - value) without storing result
@@ -311,7 +544,8 @@ static void op_cmp(CPU *cpu, uint8_t mode, uint8_t operand) {
                     : 0;
 }
 
-static void op_cpx(CPU *cpu, uint8_t mode, uint8_t operand) {
+OPCODE_HANDLER op_cpx(CPU *cpu, uint8_t mode, uint8_t operand) {
+  HALT_UNLESS_MODE(MODES_VALUE, mode);
   uint8_t value = get_operand_value(cpu, mode, operand);
 
   // Perform comparison (X - value) without storing result
@@ -330,184 +564,164 @@ static void op_cpx(CPU *cpu, uint8_t mode, uint8_t operand) {
                     : 0;
 }
 
-static void op_push(CPU *cpu, uint8_t mode, uint8_t operand) {
-  (void)mode; (void)operand;
-
-  if (UNLIKELY(cpu->SP < (STACK_BASE - STACK_SIZE + 1))) {
-    cpu->flags |= FLAG_HALTED;  // Stack overflow = halt CPU
+// Stack handlers without bounds checks (verified images only)
+OPCODE_HANDLER op_push_unchecked(CPU *cpu, uint8_t mode, uint8_t operand) {
+  if (stack_masked(mode, operand)) {
+    STACK_PUSH_REGS(cpu->memory, cpu->SP, operand, cpu->A, cpu->X,
+                    cpu->flags);
     return;
   }
-
   cpu->memory[cpu->SP] = cpu->A;
   cpu->SP--;
 }
 
-static void op_pop(CPU *cpu, uint8_t mode, uint8_t operand) {
-  (void)mode; (void)operand;
-
-  if (UNLIKELY(cpu->SP >= STACK_BASE)) {
-    cpu->flags |= FLAG_HALTED;  // Stack underflow = halt CPU
+OPCODE_HANDLER op_pop_unchecked(CPU *cpu, uint8_t mode, uint8_t operand) {
+  if (stack_masked(mode, operand)) {
+    STACK_POP_REGS(cpu->memory, cpu->SP, operand, cpu->A, cpu->X,
+                   cpu->flags);
     return;
   }
-
   cpu->SP++;
   cpu->A = cpu->memory[cpu->SP];
   UPDATE_ZN_FLAGS(cpu, cpu->A);
 }
 
-static inline void op_halt(CPU *cpu, uint8_t mode, uint8_t operand) {
+OPCODE_HANDLER op_jsr_unchecked(CPU *cpu, uint8_t mode, uint8_t operand) {
+  (void)mode;
+  cpu->memory[cpu->SP--] = cpu->PC;
+  cpu->PC = operand;
+}
+
+OPCODE_HANDLER op_rts_unchecked(CPU *cpu, uint8_t mode, uint8_t operand) {
   (void)mode;
   (void)operand;
-  cpu->flags |= FLAG_HALTED;
+  cpu->PC = cpu->memory[++cpu->SP];
 }
 
-static void op_ror(CPU *cpu, uint8_t mode, uint8_t operand) {
-  uint8_t value = 0;
-  uint8_t *target = NULL;
+OPCODE_HANDLER op_push(CPU *cpu, uint8_t mode, uint8_t operand) {
+  if (UNLIKELY(!stack_can_push(cpu->SP, stack_count(mode, operand)))) {
+    cpu->flags |= FLAG_HALTED;  // Stack overflow = halt CPU
+    return;
+  }
+  op_push_unchecked(cpu, mode, operand);
+}
 
-  switch (mode) {
-  case MODE_REGISTER:
-    target = &cpu->A;
-    value = cpu->A;
-    break;
-  case MODE_ABSOLUTE:
-    target = &cpu->memory[operand];
-    value = cpu->memory[operand];
-    break;
-  case MODE_ABSOLUTE_X:
-    target = &cpu->memory[(operand + cpu->X) & 0xFF];
-    value = cpu->memory[(operand + cpu->X) & 0xFF];
-    break;
-  case MODE_INDIRECT:
-    target = &cpu->memory[cpu->memory[operand]];
-    value = cpu->memory[cpu->memory[operand]];
-    break;
-  case MODE_INDIRECT_X:
-    target = &cpu->memory[cpu->memory[(operand + cpu->X) & 0xFF]];
-    value = cpu->memory[cpu->memory[(operand + cpu->X) & 0xFF]];
-    break;
-  default:
+OPCODE_HANDLER op_pop(CPU *cpu, uint8_t mode, uint8_t operand) {
+  if (UNLIKELY(!stack_can_pop(cpu->SP, stack_count(mode, operand)))) {
+    cpu->flags |= FLAG_HALTED;  // Stack underflow = halt CPU
     return;
   }
+  op_pop_unchecked(cpu, mode, operand);
+}
 
-  uint8_t old_carry = (cpu->flags & FLAG_CARRY) ? 1 : 0;
-  uint8_t new_carry = value & 1;
-  uint8_t result = (uint8_t)((value >> 1) | (old_carry << 7));
-  *target = result;
+// JMP: PC = effective address, so [$a] / [$a,X] jump through a table
+OPCODE_HANDLER op_jmp(CPU *cpu, uint8_t mode, uint8_t operand) {
+  HALT_UNLESS_MODE(MODES_STORE, mode); // No #imm / register target
+  cpu->PC = get_effective_address(cpu, mode, operand);
+}
 
-  UPDATE_ZNC_FLAGS(cpu, result, new_carry);
+/* MOVE/FILL: A bytes from X. MOVE reads them from the effective address,
+   FILL stores the operand value. Registers and flags are left alone. */
+OPCODE_HANDLER op_move(CPU *cpu, uint8_t mode, uint8_t operand) {
+  HALT_UNLESS_MODE(MODES_STORE, mode);
+  memory_move(cpu->memory, cpu->X, get_effective_address(cpu, mode, operand),
+              cpu->A);
 }
 
-static void op_rol(CPU *cpu, uint8_t mode, uint8_t operand) {
-  uint8_t value = 0;
-  uint8_t *target = NULL;
+OPCODE_HANDLER op_fill(CPU *cpu, uint8_t mode, uint8_t operand) {
+  HALT_UNLESS_MODE(MODES_VALUE, mode);
+  memory_fill(cpu->memory, cpu->X, get_operand_value(cpu, mode, operand),
+              cpu->A);
+}
 
-  switch (mode) {
-  case MODE_REGISTER:
-    target = &cpu->A;
-    value = cpu->A;
-    break;
-  case MODE_ABSOLUTE:
-    target = &cpu->memory[operand];
-    value = cpu->memory[operand];
-    break;
-  case MODE_ABSOLUTE_X:
-    target = &cpu->memory[(operand + cpu->X) & 0xFF];
-    value = cpu->memory[(operand + cpu->X) & 0xFF];
-    break;
-  case MODE_INDIRECT:
-    target = &cpu->memory[cpu->memory[operand]];
-    value = cpu->memory[cpu->memory[operand]];
-    break;
-  case MODE_INDIRECT_X:
-    target = &cpu->memory[cpu->memory[(operand + cpu->X) & 0xFF]];
-    value = cpu->memory[cpu->memory[(operand + cpu->X) & 0xFF]];
-    break;
-  default:
+// JSR: the return address is the byte after the 3-byte instruction (PC)
+OPCODE_HANDLER op_jsr(CPU *cpu, uint8_t mode, uint8_t operand) {
+  if (UNLIKELY(!stack_can_push(cpu->SP, 1))) {
+    cpu->flags |= FLAG_HALTED; // Stack overflow
     return;
   }
+  op_jsr_unchecked(cpu, mode, operand);
+}
 
-  uint8_t old_carry = (cpu->flags & FLAG_CARRY) ? 1 : 0;
-  uint8_t new_carry = (value & 0x80) ? 1 : 0;
-  uint8_t result = (uint8_t)((value << 1) | old_carry);
-  *target = result;
+OPCODE_HANDLER op_rts(CPU *cpu, uint8_t mode, uint8_t operand) {
+  if (UNLIKELY(!stack_can_pop(cpu->SP, 1))) {
+    cpu->flags |= FLAG_HALTED; // Stack underflow
+    return;
+  }
+  op_rts_unchecked(cpu, mode, operand);
+}
 
-  UPDATE_ZNC_FLAGS(cpu, result, new_carry);
+OPCODE_HANDLER op_halt(CPU *cpu, uint8_t mode, uint8_t operand) {
+  (void)mode;
+  (void)operand;
+  cpu->flags |= FLAG_HALTED;
 }
 
-static void op_shr(CPU *cpu, uint8_t mode, uint8_t operand) {
-  uint8_t value = 0;
-  uint8_t *target = NULL;
+/* Read-modify-write kernels for ROR/ROL/SHR/SHL: branchless, result in the
+   low byte and carry out in bit 8. carry_in is 0 or 1. */
+typedef uint16_t (*rmw_kernel)(uint8_t value, uint8_t carry_in);
 
-  switch (mode) {
-  case MODE_REGISTER:
-    target = &cpu->A;
-    value = cpu->A;
-    break;
-  case MODE_ABSOLUTE:
-    target = &cpu->memory[operand];
-    value = cpu->memory[operand];
-    break;
-  case MODE_ABSOLUTE_X:
-    target = &cpu->memory[(operand + cpu->X) & 0xFF];
-    value = cpu->memory[(operand + cpu->X) & 0xFF];
-    break;
-  case MODE_INDIRECT:
-    target = &cpu->memory[cpu->memory[operand]];
-    value = cpu->memory[cpu->memory[operand]];
-    break;
-  case MODE_INDIRECT_X:
-    target = &cpu->memory[cpu->memory[(operand + cpu->X) & 0xFF]];
-    value = cpu->memory[cpu->memory[(operand + cpu->X) & 0xFF]];
-    break;
-  default:
-    return;
-  }
+#define RMW_RESULT(r) ((uint8_t)(r))
+#define RMW_CARRY(r) ((r) >> 8)
+
+static inline uint16_t rmw_ror(uint8_t value, uint8_t carry_in) {
+  return (uint16_t)((value >> 1) | (carry_in << 7) | ((value & 1) << 8));
+}
 
-  uint8_t new_carry = value & 1;
-  uint8_t result = value >> 1;
-  *target = result;
+static inline uint16_t rmw_rol(uint8_t value, uint8_t carry_in) {
+  return (uint16_t)((value << 1) | carry_in); // Bit 7 shifts into bit 8
+}
 
-  UPDATE_ZNC_FLAGS(cpu, result, new_carry);
+static inline uint16_t rmw_shr(uint8_t value, uint8_t carry_in) {
+  (void)carry_in;
+  return (uint16_t)((value >> 1) | ((value & 1) << 8));
 }
 
-static void op_shl(CPU *cpu, uint8_t mode, uint8_t operand) {
-  uint8_t value = 0;
-  uint8_t *target = NULL;
+static inline uint16_t rmw_shl(uint8_t value, uint8_t carry_in) {
+  (void)carry_in;
+  return (uint16_t)(value << 1);
+}
 
-  switch (mode) {
-  case MODE_REGISTER:
-    target = &cpu->A;
-    value = cpu->A;
-    break;
-  case MODE_ABSOLUTE:
-    target = &cpu->memory[operand];
-    value = cpu->memory[operand];
-    break;
-  case MODE_ABSOLUTE_X:
-    target = &cpu->memory[(operand + cpu->X) & 0xFF];
-    value = cpu->memory[(operand + cpu->X) & 0xFF];
-    break;
-  case MODE_INDIRECT:
-    target = &cpu->memory[cpu->memory[operand]];
-    value = cpu->memory[cpu->memory[operand]];
-    break;
-  case MODE_INDIRECT_X:
-    target = &cpu->memory[cpu->memory[(operand + cpu->X) & 0xFF]];
-    value = cpu->memory[cpu->memory[(operand + cpu->X) & 0xFF]];
-    break;
-  default:
+/* RMW target: A for MODE_REGISTER, else the memory byte at the effective
+   address, resolved once (indirect pointers are dereferenced a single time).
+   NULL for MODE_IMMEDIAT, which leaves the CPU untouched. */
+static inline uint8_t *rmw_target(CPU *cpu, uint8_t mode, uint8_t operand) {
+  if (mode == MODE_REGISTER)
+    return &cpu->A;
+  if (UNLIKELY(mode == MODE_IMMEDIAT))
+    return NULL;
+  return &cpu->memory[get_effective_address(cpu, mode, operand)];
+}
+
+/* Single RMW execution core; kernel is a constant at every call site */
+static inline __attribute__((always_inline)) void
+rmw_execute(CPU *cpu, uint8_t mode, uint8_t operand, rmw_kernel kernel) {
+  uint8_t *target = rmw_target(cpu, mode, operand);
+  if (target == NULL)
     return;
-  }
 
-  uint8_t new_carry = (value & 0x80) ? 1 : 0;
-  uint8_t result = (uint8_t)(value << 1);
-  *target = result;
+  uint16_t r = kernel(*target, cpu->flags & FLAG_CARRY);
+  *target = RMW_RESULT(r);
+  cpu->flags = flags_znc(cpu->flags, RMW_RESULT(r), RMW_CARRY(r));
+}
+
+OPCODE_HANDLER op_ror(CPU *cpu, uint8_t mode, uint8_t operand) {
+  rmw_execute(cpu, mode, operand, rmw_ror);
+}
+
+OPCODE_HANDLER op_rol(CPU *cpu, uint8_t mode, uint8_t operand) {
+  rmw_execute(cpu, mode, operand, rmw_rol);
+}
+
+OPCODE_HANDLER op_shr(CPU *cpu, uint8_t mode, uint8_t operand) {
+  rmw_execute(cpu, mode, operand, rmw_shr);
+}
 
-  UPDATE_ZNC_FLAGS(cpu, result, new_carry);
+OPCODE_HANDLER op_shl(CPU *cpu, uint8_t mode, uint8_t operand) {
+  rmw_execute(cpu, mode, operand, rmw_shl);
 }
 
-static void op_inx(CPU *cpu, uint8_t mode, uint8_t operand) {
+OPCODE_HANDLER op_inx(CPU *cpu, uint8_t mode, uint8_t operand) {
   (void)mode;
   (void)operand; // INX operates only on X register
 
@@ -515,7 +729,7 @@ static void op_inx(CPU *cpu, uint8_t mode, uint8_t operand) {
   UPDATE_ZN_FLAGS(cpu, cpu->X);
 }
 
-static void op_dex(CPU *cpu, uint8_t mode, uint8_t operand) {
+OPCODE_HANDLER op_dex(CPU *cpu, uint8_t mode, uint8_t operand) {
   (void)mode;
   (void)operand; // DEX operates only on X register
 
@@ -532,12 +746,62 @@ static const opcode_handler handlers[OPCODE_COUNT] = {
     [OPCODE_PUSH] = op_push, [OPCODE_CMP] = op_cmp,  [OPCODE_CPX] = op_cpx,
     [OPCODE_HALT] = op_halt, [OPCODE_ROR] = op_ror,  [OPCODE_ROL] = op_rol,
     [OPCODE_SHR] = op_shr,   [OPCODE_SHL] = op_shl,  [OPCODE_INX] = op_inx,
-    [OPCODE_DEX] = op_dex,
+    [OPCODE_DEX] = op_dex,   [OPCODE_JSR] = op_jsr,  [OPCODE_RTS] = op_rts,
+    [OPCODE_JMP] = op_jmp,   [OPCODE_MOVE] = op_move,
+    [OPCODE_FILL] = op_fill,
 };
 
 _Static_assert(OPCODE_COUNT == (sizeof handlers / sizeof handlers[0]),
                "opcode count mismatch");
 
+/* Addressing modes each opcode is defined for (bit n = mode n). cpu_step
+   halts on the others, except for JSR, which ignores its mode; the verifier
+   holds images to this table. OPCODE_B takes a condition instead of a mode. */
+static const uint8_t opcode_modes[OPCODE_COUNT] = {
+    [OPCODE_NOP] = MODES_ANY,    [OPCODE_LDA] = MODES_VALUE,
+    [OPCODE_LDX] = MODES_VALUE,  [OPCODE_STA] = MODES_STORE,
+    [OPCODE_STX] = MODES_STORE,  [OPCODE_B] = 0,
+    [OPCODE_ADD] = MODES_VALUE,  [OPCODE_SUB] = MODES_VALUE,
+    [OPCODE_XOR] = MODES_VALUE,  [OPCODE_AND] = MODES_VALUE,
+    [OPCODE_OR] = MODES_VALUE,   [OPCODE_POP] = MODES_ANY,
+    [OPCODE_PUSH] = MODES_ANY,   [OPCODE_CMP] = MODES_VALUE,
+    [OPCODE_CPX] = MODES_VALUE,  [OPCODE_ROR] = MODES_ANY,
+    [OPCODE_ROL] = MODES_ANY,    [OPCODE_SHR] = MODES_ANY,
+    [OPCODE_SHL] = MODES_ANY,    [OPCODE_INX] = MODES_ANY,
+    [OPCODE_DEX] = MODES_ANY,    [OPCODE_HALT] = MODES_ANY,
+    [OPCODE_JSR] = 1 << MODE_ABSOLUTE, [OPCODE_RTS] = MODES_ANY,
+    [OPCODE_JMP] = MODES_STORE,  [OPCODE_MOVE] = MODES_STORE,
+    [OPCODE_FILL] = MODES_VALUE,
+};
+
+/* Whether cpu_step executes this instruction (opcode < OPCODE_COUNT) rather
+   than halting on its mode or condition */
+static inline int instruction_runs(uint8_t opcode, uint8_t mode) {
+  if (opcode == OPCODE_B)
+    return mode < COND_COUNT;
+  if (mode >= MODE_COUNT)
+    return 0;
+  return opcode == OPCODE_JSR || ((opcode_modes[opcode] >> mode) & 1);
+}
+
+// Dispatch table of the unchecked engine
+static const opcode_handler handlers_unchecked[OPCODE_COUNT] = {
+    [OPCODE_NOP] = op_nop,   [OPCODE_LDA] = op_lda,  [OPCODE_LDX] = op_ldx,
+    [OPCODE_ADD] = op_add,   [OPCODE_SUB] = op_sub,  [OPCODE_XOR] = op_xor,
+    [OPCODE_STA] = op_sta,   [OPCODE_STX] = op_stx,  [OPCODE_AND] = op_and,
+    [OPCODE_OR] = op_or,     [OPCODE_B] = op_branch,
+    [OPCODE_POP] = op_pop_unchecked,
+    [OPCODE_PUSH] = op_push_unchecked,
+    [OPCODE_CMP] = op_cmp,   [OPCODE_CPX] = op_cpx,
+    [OPCODE_HALT] = op_halt, [OPCODE_ROR] = op_ror,  [OPCODE_ROL] = op_rol,
+    [OPCODE_SHR] = op_shr,   [OPCODE_SHL] = op_shl,  [OPCODE_INX] = op_inx,
+    [OPCODE_DEX] = op_dex,
+    [OPCODE_JSR] = op_jsr_unchecked,
+    [OPCODE_RTS] = op_rts_unchecked,
+    [OPCODE_JMP] = op_jmp,   [OPCODE_MOVE] = op_move,
+    [OPCODE_FILL] = op_fill,
+};
+
 // CPU initialization with optimized memset
 static inline void initCPU(CPU *cpu) {
   __builtin_memset(cpu, 0, sizeof(CPU));
@@ -558,21 +822,29 @@ static inline int cpu_step(CPU *cpu) {
   uint8_t mode = cpu->memory[cpu->PC++];
   uint8_t operand = cpu->memory[cpu->PC++];
 
-  // Special case: Branch instruction uses condition, not mode
-  if (opcode == OPCODE_B) {
-    // Don't validate mode for branch - it's actually a condition
-  } else {
-    // Validate mode for all other instructions
-    if (UNLIKELY(mode >= MODE_COUNT)) {
-      cpu->flags |= FLAG_HALTED;
-      return CPU_HALTED;
-    }
+  // Branch instruction uses condition, not mode: validate each against its
+  // own range so the branch handler never sees an unknown condition
+  if (UNLIKELY(mode >= (opcode == OPCODE_B ? COND_COUNT : MODE_COUNT))) {
+    cpu->flags |= FLAG_HALTED;
+    return CPU_HALTED;
   }
   // Execute instruction - no return value overhead!
   handlers[opcode](cpu, mode, operand);
   return (cpu->flags & FLAG_HALTED) ? CPU_HALTED : CPU_OK;
 }
 
+/* cpu_step without opcode/mode validation or stack bounds checks.
+   Only for images accepted by cpu_verify (cpu_verify.h): invalid opcodes,
+   modes or stack faults are undefined behaviour here. */
+static inline int cpu_step_unchecked(CPU *cpu) {
+  uint8_t opcode = cpu->memory[cpu->PC++];
+  uint8_t mode = cpu->memory[cpu->PC++];
+  uint8_t operand = cpu->memory[cpu->PC++];
+
+  handlers_unchecked[opcode](cpu, mode, operand);
+  return (cpu->flags & FLAG_HALTED) ? CPU_HALTED : CPU_OK;
+}
+
 // cpu_step_packed - void handlers, zero return value overhead
 static inline int cpu_step_packed(CPU *cpu) {
   /* Fetch packed byte */
@@ -586,15 +858,11 @@ static inline int cpu_step_packed(CPU *cpu) {
     return CPU_HALTED;
   }
 
-  // Special case: Branch instruction uses condition, not mode
-  if (opcode == OPCODE_B) {
-    // Don't validate mode for branch - it's actually a condition
-  } else {
-    // Validate mode for all other instructions
-    if (UNLIKELY(mode >= MODE_COUNT)) {
-      cpu->flags |= FLAG_HALTED;
-      return CPU_HALTED;
-    }
+  // Branch instruction uses condition, not mode: validate each against its
+  // own range so the branch handler never sees an unknown condition
+  if (UNLIKELY(mode >= (opcode == OPCODE_B ? COND_COUNT : MODE_COUNT))) {
+    cpu->flags |= FLAG_HALTED;
+    return CPU_HALTED;
   }
 
   /* Fetch operand (still one byte) */
@@ -605,6 +873,321 @@ static inline int cpu_step_packed(CPU *cpu) {
   return (cpu->flags & FLAG_HALTED) ? CPU_HALTED : CPU_OK;
 }
 
+/* Packed v2: the packed byte, then an operand byte only for the modes in
+   PACKED_V2_OPERANDS(opcode) (bit n = mode n; the condition for OPCODE_B).
+   NOP, INX, DEX, HALT, RTS, PUSH/POP of A and register or immediate shifts
+   are one byte. cpu_pack_v2 (cpu_pack.h) converts the other formats. */
+#define PACKED_V2_OPERANDS(op)                                                 \
+  ((op) == OPCODE_NOP || (op) == OPCODE_INX || (op) == OPCODE_DEX ||           \
+           (op) == OPCODE_HALT || (op) == OPCODE_RTS                           \
+       ? 0                                                                     \
+   : (op) == OPCODE_PUSH || (op) == OPCODE_POP ? 1 << MODE_REGISTER            \
+   : (op) == OPCODE_ROR || (op) == OPCODE_ROL || (op) == OPCODE_SHR ||         \
+           (op) == OPCODE_SHL                                                  \
+       ? MODES_STORE                                                           \
+       : 0xFF)
+
+/* Instruction size by packed byte, one load on the fetch path (undefined
+   opcodes count 2, cpu_step_packed_v2 halts on them) */
+#define PACKED_V2_SIZE(b)                                                      \
+  (1 + ((PACKED_V2_OPERANDS((b) & 0x1F) >> ((b) >> 5)) & 1))
+#define PACKED_V2_SIZE4(b)                                                     \
+  PACKED_V2_SIZE(b), PACKED_V2_SIZE((b) + 1), PACKED_V2_SIZE((b) + 2),         \
+      PACKED_V2_SIZE((b) + 3)
+#define PACKED_V2_SIZE16(b)                                                    \
+  PACKED_V2_SIZE4(b), PACKED_V2_SIZE4((b) + 4), PACKED_V2_SIZE4((b) + 8),      \
+      PACKED_V2_SIZE4((b) + 12)
+#define PACKED_V2_SIZE64(b)                                                    \
+  PACKED_V2_SIZE16(b), PACKED_V2_SIZE16((b) + 16),                             \
+      PACKED_V2_SIZE16((b) + 32), PACKED_V2_SIZE16((b) + 48)
+
+static const uint8_t packed_v2_size[256] = {
+    PACKED_V2_SIZE64(0),
+    PACKED_V2_SIZE64(64),
+    PACKED_V2_SIZE64(128),
+    PACKED_V2_SIZE64(192),
+};
+
+static inline unsigned packed_v2_length(uint8_t b) { return packed_v2_size[b]; }
+
+// cpu_step_packed_v2 - variable-length packed decode, no branch on length
+static inline int cpu_step_packed_v2(CPU *cpu) {
+  uint8_t packed = cpu->memory[cpu->PC++];
+
+  uint8_t opcode = UNPACK_OPCODE(packed);
+  uint8_t mode = UNPACK_MODE(packed);
+
+  if (UNLIKELY(opcode >= OPCODE_COUNT || !handlers[opcode])) {
+    cpu->flags |= FLAG_HALTED;
+    return CPU_HALTED;
+  }
+  if (UNLIKELY(mode >= (opcode == OPCODE_B ? COND_COUNT : MODE_COUNT))) {
+    cpu->flags |= FLAG_HALTED;
+    return CPU_HALTED;
+  }
+
+  // Always read the next byte; keep it and step over it only if it is ours
+  uint8_t has_operand = (uint8_t)(packed_v2_size[packed] - 1);
+  uint8_t operand = cpu->memory[cpu->PC] & (uint8_t)-has_operand;
+  cpu->PC = (uint8_t)(cpu->PC + has_operand);
+
+  handlers[opcode](cpu, mode, operand);
+  return (cpu->flags & FLAG_HALTED) ? CPU_HALTED : CPU_OK;
+}
+
+// ============================================================================
+// REGISTER-CACHED RUN LOOP
+// ============================================================================
+
+/* Guest stores go through a uint8_t pointer, which may alias anything, so
+   handlers that work on cpu->A / cpu->X / cpu->flags must reload them after
+   every store. cpu_run_fast inlines all instruction bodies and keeps the
+   architectural registers in locals, flushing them to the CPU struct only on
+   exit (halt or step budget exhausted).
+
+   Build with -DCPU_FAST_DEBUG_HOOK=fn to flush and call fn(cpu) before every
+   instruction; without it the loop carries no debug overhead. */
+#ifdef CPU_FAST_DEBUG_HOOK
+#define FAST_HOOK()                                                            \
+  do {                                                                         \
+    cpu->A = a;                                                                \
+    cpu->X = x;                                                                \
+    cpu->PC = pc;                                                              \
+    cpu->SP = sp;                                                              \
+    cpu->flags = flags;                                                        \
+    CPU_FAST_DEBUG_HOOK(cpu);                                                  \
+    a = cpu->A;                                                                \
+    x = cpu->X;                                                                \
+    pc = cpu->PC;                                                              \
+    sp = cpu->SP;                                                              \
+    flags = cpu->flags;                                                        \
+  } while (0)
+#else
+#define FAST_HOOK()                                                            \
+  do {                                                                         \
+  } while (0)
+#endif
+
+#define FAST_HALT()                                                            \
+  do {                                                                         \
+    flags |= FLAG_HALTED;                                                      \
+    goto halted;                                                               \
+  } while (0)
+
+// HALT_UNLESS_MODE of the loop
+#define FAST_MODES(modes)                                                      \
+  do {                                                                         \
+    if (UNLIKELY(!(((modes) >> mode) & 1)))                                    \
+      FAST_HALT();                                                             \
+  } while (0)
+
+/* Read-modify-write body shared by ROR/ROL/SHR/SHL (MODE_IMMEDIAT: no-op) */
+#define FAST_RMW(kernel)                                                       \
+  do {                                                                         \
+    uint8_t address = 0, value;                                                \
+    uint16_t r;                                                                \
+    if (mode == MODE_IMMEDIAT)                                                 \
+      break;                                                                   \
+    if (mode == MODE_REGISTER) {                                               \
+      value = a;                                                               \
+    } else {                                                                   \
+      address = effective_address_x(memory, x, mode, operand);                 \
+      value = memory[address];                                                 \
+    }                                                                          \
+    r = kernel(value, flags & FLAG_CARRY);                                     \
+    flags = flags_znc(flags, RMW_RESULT(r), RMW_CARRY(r));                     \
+    if (mode == MODE_REGISTER)                                                 \
+      a = RMW_RESULT(r);                                                       \
+    else                                                                       \
+      memory[address] = RMW_RESULT(r);                                         \
+  } while (0)
+
+/* Run up to max_steps instructions (3-byte format). Returns CPU_HALTED if the
+   guest halted, CPU_OK if the budget ran out. The number of instructions
+   executed (including the halting one) is stored in *retired if non-NULL.
+   Results are identical to calling cpu_step the same number of times.
+   Always inlined, so callers built for another target (cpu_dispatch.c)
+   get the loop compiled for it. */
+static inline __attribute__((always_inline)) int
+cpu_run_fast(CPU *cpu, uint64_t max_steps, uint64_t *retired) {
+  uint8_t *const memory = cpu->memory;
+  uint8_t a = cpu->A;
+  uint8_t x = cpu->X;
+  uint8_t pc = cpu->PC;
+  uint8_t sp = cpu->SP;
+  uint8_t flags = cpu->flags;
+  uint64_t n = 0;
+  int status = CPU_OK;
+
+  if (UNLIKELY(flags & FLAG_HALTED)) {
+    status = CPU_HALTED;
+    goto done;
+  }
+
+  while (LIKELY(n < max_steps)) {
+    FAST_HOOK();
+    uint8_t opcode = memory[pc];
+    n++;
+
+    if (UNLIKELY(opcode >= OPCODE_COUNT)) {
+      pc++;
+      FAST_HALT();
+    }
+
+    uint8_t mode = memory[(uint8_t)(pc + 1)];
+    uint8_t operand = memory[(uint8_t)(pc + 2)];
+    uint8_t compare; // CMP/CPX result, discarded
+    pc = (uint8_t)(pc + 3);
+
+    if (opcode == OPCODE_B) {
+      if (UNLIKELY(mode >= COND_COUNT))
+        FAST_HALT();
+      pc = branch_taken(flags, mode) ? operand : pc;
+      continue;
+    }
+    if (UNLIKELY(mode >= MODE_COUNT))
+      FAST_HALT();
+
+    switch (opcode) {
+    case OPCODE_NOP:
+      break;
+    case OPCODE_LDA:
+      FAST_MODES(MODES_VALUE);
+      a = operand_value_x(memory, x, mode, operand);
+      flags = flags_zn(flags, a);
+      break;
+    case OPCODE_LDX:
+      FAST_MODES(MODES_VALUE);
+      x = operand_value_x(memory, x, mode, operand);
+      flags = flags_zn(flags, x);
+      break;
+    case OPCODE_STA:
+      FAST_MODES(MODES_STORE);
+      memory[effective_address_x(memory, x, mode, operand)] = a;
+      break;
+    case OPCODE_STX:
+      FAST_MODES(MODES_STORE);
+      memory[effective_address_x(memory, x, mode, operand)] = x;
+      break;
+    case OPCODE_ADD:
+      FAST_MODES(MODES_VALUE);
+      flags = flags_add(flags, a, operand_value_x(memory, x, mode, operand),
+                        &a);
+      break;
+    case OPCODE_SUB:
+      FAST_MODES(MODES_VALUE);
+      flags = flags_sub(flags, a, operand_value_x(memory, x, mode, operand),
+                        &a);
+      break;
+    case OPCODE_XOR:
+      FAST_MODES(MODES_VALUE);
+      a ^= operand_value_x(memory, x, mode, operand);
+      flags = flags_zn(flags, a);
+      break;
+    case OPCODE_AND:
+      FAST_MODES(MODES_VALUE);
+      a &= operand_value_x(memory, x, mode, operand);
+      flags = flags_zn(flags, a);
+      break;
+    case OPCODE_OR:
+      FAST_MODES(MODES_VALUE);
+      a |= operand_value_x(memory, x, mode, operand);
+      flags = flags_zn(flags, a);
+      break;
+    case OPCODE_POP:
+      if (UNLIKELY(!stack_can_pop(sp, stack_count(mode, operand))))
+        FAST_HALT(); // Stack underflow
+      if (stack_masked(mode, operand)) {
+        STACK_POP_REGS(memory, sp, operand, a, x, flags);
+        break;
+      }
+      sp++;
+      a = memory[sp];
+      flags = flags_zn(flags, a);
+      break;
+    case OPCODE_PUSH:
+      if (UNLIKELY(!stack_can_push(sp, stack_count(mode, operand))))
+        FAST_HALT(); // Stack overflow
+      if (stack_masked(mode, operand)) {
+        STACK_PUSH_REGS(memory, sp, operand, a, x, flags);
+        break;
+      }
+      memory[sp] = a;
+      sp--;
+      break;
+    case OPCODE_JSR:
+      if (UNLIKELY(!stack_can_push(sp, 1)))
+        FAST_HALT(); // Stack overflow
+      memory[sp--] = pc;
+      pc = operand;
+      break;
+    case OPCODE_RTS:
+      if (UNLIKELY(!stack_can_pop(sp, 1)))
+        FAST_HALT(); // Stack underflow
+      pc = memory[++sp];
+      break;
+    case OPCODE_JMP:
+      FAST_MODES(MODES_STORE);
+      pc = effective_address_x(memory, x, mode, operand);
+      break;
+    case OPCODE_MOVE:
+      FAST_MODES(MODES_STORE);
+      memory_move(memory, x, effective_address_x(memory, x, mode, operand),
+                  a);
+      break;
+    case OPCODE_FILL:
+      FAST_MODES(MODES_VALUE);
+      memory_fill(memory, x, operand_value_x(memory, x, mode, operand), a);
+      break;
+    case OPCODE_CMP:
+      FAST_MODES(MODES_VALUE);
+      flags = flags_sub(flags, a, operand_value_x(memory, x, mode, operand),
+                        &compare);
+      break;
+    case OPCODE_CPX:
+      FAST_MODES(MODES_VALUE);
+      flags = flags_sub(flags, x, operand_value_x(memory, x, mode, operand),
+                        &compare);
+      break;
+    case OPCODE_ROR:
+      FAST_RMW(rmw_ror);
+      break;
+    case OPCODE_ROL:
+      FAST_RMW(rmw_rol);
+      break;
+    case OPCODE_SHR:
+      FAST_RMW(rmw_shr);
+      break;
+    case OPCODE_SHL:
+      FAST_RMW(rmw_shl);
+      break;
+    case OPCODE_INX:
+      x++;
+      flags = flags_zn(flags, x);
+      break;
+    case OPCODE_DEX:
+      x--;
+      flags = flags_zn(flags, x);
+      break;
+    case OPCODE_HALT:
+      FAST_HALT();
+    }
+  }
+  goto done;
+
+halted:
+  status = CPU_HALTED;
+done:
+  cpu->A = a;
+  cpu->X = x;
+  cpu->PC = pc;
+  cpu->SP = sp;
+  cpu->flags = flags;
+  if (retired)
+    *retired = n;
+  return status;
+}
+
 /* cpu_run that accepts a step-function pointer.
    We capture the instruction start PC (prev_pc) so the reporting works
    independently of the exact decoding/length policy of the step function. */
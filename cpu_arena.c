@@ -0,0 +1,165 @@
+#define _GNU_SOURCE // MAP_ANONYMOUS, MAP_HUGETLB, MADV_HUGEPAGE, syscall()
+
+#include <sys/mman.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+#include "cpu_arena.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define ARENA_X86 1
+#endif
+
+#define ARENA_HUGE_PAGE (2u << 20) // 2 MiB, the x86-64/arm64 default
+#define ARENA_LINE 64              // Slab alignment: one cache line
+
+// Every slot starts on a line only if CPUs are whole lines
+_Static_assert(sizeof(CPU) % ARENA_LINE == 0, "CPU slots must be line aligned");
+
+#ifdef __linux__
+#define ARENA_MPOL_BIND 2 // <linux/mempolicy.h>, not in every libc
+
+/* Bind [addr, addr + bytes) to one node (libnuma not required) */
+static int arena_bind_node(void *addr, size_t bytes, int node) {
+  unsigned long mask[16] = {0};
+  size_t bits = sizeof(mask) * 8;
+
+  if (node < 0 || (size_t)node >= bits)
+    return -1;
+  mask[(size_t)node / (sizeof(unsigned long) * 8)] |=
+      1UL << ((size_t)node % (sizeof(unsigned long) * 8));
+  return (int)syscall(SYS_mbind, addr, bytes, ARENA_MPOL_BIND, mask,
+                      bits + 1, 0);
+}
+#endif
+
+/* Map the slab: explicit huge pages, then THP, then plain pages */
+static void *arena_map(CPUArena *arena, size_t bytes) {
+  void *slab;
+
+#if defined(__linux__) && defined(MAP_HUGETLB)
+  size_t huge_bytes = (bytes + ARENA_HUGE_PAGE - 1) & ~(ARENA_HUGE_PAGE - 1);
+  slab = mmap(NULL, huge_bytes, PROT_READ | PROT_WRITE,
+              MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+  if (slab != MAP_FAILED) {
+    arena->bytes = huge_bytes;
+    arena->huge_pages = 1;
+    return slab;
+  }
+#endif
+
+  slab = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+              MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (slab == MAP_FAILED)
+    return NULL;
+  arena->bytes = bytes;
+#ifdef MADV_HUGEPAGE
+  if (bytes >= ARENA_HUGE_PAGE && madvise(slab, bytes, MADV_HUGEPAGE) == 0)
+    arena->huge_pages = 2;
+#endif
+  return slab;
+}
+
+CPUArena *vm8_arena_create(size_t n, int numa_node) {
+  if (n == 0 || n >= ARENA_NONE)
+    return NULL;
+
+  CPUArena *arena = calloc(1, sizeof(CPUArena));
+  if (!arena)
+    return NULL;
+  arena->count = n;
+  arena->numa_node = -1;
+
+  size_t bytes = n * sizeof(CPU);
+  arena->slab = arena_map(arena, bytes);
+  arena->mapped = arena->slab != NULL;
+  if (!arena->slab) {
+    // aligned_alloc wants a size that is a multiple of the alignment
+    arena->bytes = (bytes + ARENA_LINE - 1) & ~(size_t)(ARENA_LINE - 1);
+    arena->slab = aligned_alloc(ARENA_LINE, arena->bytes);
+  }
+  arena->next_free = malloc(n * sizeof(uint32_t));
+  if (!arena->slab || !arena->next_free) {
+    vm8_arena_destroy(arena);
+    return NULL;
+  }
+
+#ifdef __linux__
+  // Bind before anything touches the slab, so every page lands on the node
+  if (arena->mapped && numa_node >= 0 &&
+      arena_bind_node(arena->slab, arena->bytes, numa_node) == 0)
+    arena->numa_node = numa_node;
+#else
+  (void)numa_node;
+#endif
+
+  // Free list in address order: consecutive acquires are adjacent
+  for (size_t i = 0; i < n; i++)
+    arena->next_free[i] = i + 1 < n ? (uint32_t)(i + 1) : ARENA_NONE;
+  arena->free_head = 0;
+  arena->free_count = n;
+  return arena;
+}
+
+void vm8_arena_destroy(CPUArena *arena) {
+  if (!arena)
+    return;
+  if (arena->mapped)
+    munmap(arena->slab, arena->bytes);
+  else
+    free(arena->slab);
+  free(arena->next_free);
+  free(arena);
+}
+
+void vm8_arena_init(CPUArena *arena, size_t first, size_t count) {
+  CPU *cpu = &arena->slab[first];
+
+  // One vectorised fill for the whole range instead of a memset per CPU
+  __builtin_memset(cpu, 0, count * sizeof(CPU));
+  for (size_t i = 0; i < count; i++)
+    cpu[i].SP = STACK_BASE;
+}
+
+#ifdef ARENA_X86
+/* Template in 10 YMM registers, streamed to each dirty line (CPU is 64-byte
+   aligned, so every 32-byte half is aligned for _mm256_stream_si256) */
+__attribute__((target("avx"))) static void
+reset_stream_avx(CPU *arr, size_t n, const CPU *tmpl, unsigned dirty_lines) {
+  const __m256i *src = (const __m256i *)(const void *)tmpl;
+  __m256i line[VM8_CPU_LINES * 2];
+
+  for (size_t i = 0; i < VM8_CPU_LINES * 2; i++)
+    line[i] = _mm256_load_si256(&src[i]);
+  for (size_t k = 0; k < n; k++) {
+    __m256i *dst = (__m256i *)(void *)&arr[k];
+    for (size_t i = 0; i < VM8_CPU_LINES; i++) {
+      if (dirty_lines & (1u << i)) {
+        _mm256_stream_si256(&dst[2 * i], line[2 * i]);
+        _mm256_stream_si256(&dst[2 * i + 1], line[2 * i + 1]);
+      }
+    }
+  }
+  _mm_sfence(); // Streamed stores are weakly ordered
+}
+#endif
+
+void vm8_reset_stream(CPU *arr, size_t n, const CPU *tmpl,
+                      unsigned dirty_lines) {
+#ifdef ARENA_X86
+  if (__builtin_cpu_supports("avx")) {
+    reset_stream_avx(arr, n, tmpl, dirty_lines);
+    return;
+  }
+#endif
+
+  for (size_t k = 0; k < n; k++) {
+    for (size_t i = 0; i < VM8_CPU_LINES; i++)
+      if (dirty_lines & (1u << i))
+        __builtin_memcpy((uint8_t *)&arr[k] + i * 64,
+                         (const uint8_t *)tmpl + i * 64, 64);
+  }
+}
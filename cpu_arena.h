@@ -0,0 +1,140 @@
+#ifndef CPU_ARENA_H
+#define CPU_ARENA_H
+
+#include <stddef.h> // offsetof
+
+#include "cpu_verify.h"
+
+/*
+ * Arena allocator for large CPU populations.
+ *
+ * One contiguous slab of cache-line-aligned CPUs, backed by huge pages when
+ * the system has them (MAP_HUGETLB, else transparent huge pages through
+ * madvise), optionally bound to a NUMA node. Instances are handed out and
+ * taken back in O(1) through an index free list kept outside the slab.
+ *
+ * The slab is not written by vm8_arena_create: pages are placed by the first
+ * thread that touches them, so the worker owning a range of instances should
+ * call vm8_arena_init on that range itself. vm8_arena_init is the bulk
+ * initCPU: one fill over the whole range, then the SP of each instance.
+ *
+ * An arena is not thread-safe; use one per worker (or lock around it).
+ */
+
+typedef struct {
+  CPU *slab;           // count CPUs, 64-byte aligned
+  size_t count;        // Number of instances
+  size_t bytes;        // Size of the slab mapping
+  uint32_t *next_free; // Free list links (index of the next free instance)
+  uint32_t free_head;  // First free instance, ARENA_NONE when exhausted
+  size_t free_count;   // Instances available
+  int numa_node;       // Node the slab is bound to, -1 if not bound
+  int huge_pages;      // 1 = MAP_HUGETLB, 2 = transparent huge pages, 0 none
+  int mapped;          // Slab comes from mmap (else aligned_alloc)
+} CPUArena;
+
+#define ARENA_NONE UINT32_MAX
+
+/* Reserve n instances, bound to numa_node when >= 0 (best effort: check
+   arena->numa_node). The instances are not initialised. Returns NULL on
+   allocation failure or n >= ARENA_NONE. */
+CPUArena *vm8_arena_create(size_t n, int numa_node);
+void vm8_arena_destroy(CPUArena *arena);
+
+/* Reset instances [first, first + count) to the initCPU state. Call it from
+   the thread that will run them (first touch). */
+void vm8_arena_init(CPUArena *arena, size_t first, size_t count);
+
+/* O(1) acquire/release. Acquired instances keep whatever state they had:
+   initCPU (or vm8_arena_init) them before use. NULL when exhausted. */
+static inline CPU *vm8_arena_acquire(CPUArena *arena) {
+  uint32_t index = arena->free_head;
+  if (UNLIKELY(index == ARENA_NONE))
+    return NULL;
+  arena->free_head = arena->next_free[index];
+  arena->free_count--;
+  return &arena->slab[index];
+}
+
+static inline void vm8_arena_release(CPUArena *arena, CPU *cpu) {
+  uint32_t index = (uint32_t)(cpu - arena->slab);
+  arena->next_free[index] = arena->free_head;
+  arena->free_head = index;
+  arena->free_count++;
+}
+
+/* Instance by index (stable for the arena lifetime) */
+static inline CPU *vm8_arena_at(CPUArena *arena, size_t index) {
+  return &arena->slab[index];
+}
+
+// ============================================================================
+// BULK RESET
+// ============================================================================
+
+/* A CPU is 5 cache lines; line 0 holds the registers and memory[0..58] */
+#define VM8_CPU_LINES (sizeof(CPU) / 64)
+#define VM8_ALL_LINES ((1u << VM8_CPU_LINES) - 1)
+_Static_assert(sizeof(CPU) % 64 == 0, "CPU must be whole cache lines");
+
+/* Populations larger than this are reset with non-temporal stores: they
+   would not stay in cache anyway, so skip the read-for-ownership */
+#ifndef VM8_RESET_STREAM_BYTES
+#define VM8_RESET_STREAM_BYTES (1u << 20)
+#endif
+
+/* Large-population path of vm8_reset_many_lines (streamed stores when the
+   host has AVX, plain copies otherwise) */
+void vm8_reset_stream(CPU *arr, size_t n, const CPU *tmpl,
+                      unsigned dirty_lines);
+
+/* Copy the prebuilt template over arr[0..n), only the cache lines set in
+   dirty_lines (bit i = bytes [64 * i, 64 * i + 64) of the CPU). Skipping a
+   line is only correct if every instance already holds the template there:
+   instances reset from tmpl that since ran code which cannot write it. */
+static inline void vm8_reset_many_lines(CPU *arr, size_t n, const CPU *tmpl,
+                                        unsigned dirty_lines) {
+  dirty_lines &= VM8_ALL_LINES;
+  if (n * sizeof(CPU) >= VM8_RESET_STREAM_BYTES) {
+    vm8_reset_stream(arr, n, tmpl, dirty_lines);
+    return;
+  }
+
+  // Small populations stay cache-resident: inline copies, no dispatch
+  for (size_t k = 0; k < n; k++) {
+    if (dirty_lines == VM8_ALL_LINES) {
+      arr[k] = *tmpl;
+      continue;
+    }
+    for (size_t i = 0; i < VM8_CPU_LINES; i++)
+      if (dirty_lines & (1u << i))
+        __builtin_memcpy((uint8_t *)&arr[k] + i * 64,
+                         (const uint8_t *)tmpl + i * 64, 64);
+  }
+}
+
+/* Copy the template over arr[0..n) */
+static inline void vm8_reset_many(CPU *arr, size_t n, const CPU *tmpl) {
+  vm8_reset_many_lines(arr, n, tmpl, VM8_ALL_LINES);
+}
+
+/* Lines a guest of a verified image can dirty: the registers plus every byte
+   in the verifier's `written` set, and the whole stack when its depth is not
+   proven (`written` then only holds the pushes at the first depth seen).
+   Unverifiable images (or images with code the verifier could not reach
+   through an indexed jump) dirty everything. */
+static inline unsigned vm8_dirty_lines(const CPUVerifyInfo *info) {
+  unsigned lines = 1u << 0; // Registers
+
+  if (!info->valid || info->self_modifying || info->computed_jump)
+    return VM8_ALL_LINES;
+  for (unsigned address = 0; address < MAX_MEMORY_SIZE; address++)
+    if (bitmap_test(&info->written, (uint8_t)address))
+      lines |= 1u << ((offsetof(CPU, memory) + address) / 64);
+  if (!info->stack_proven)
+    for (unsigned address = STACK_LIMIT; address <= STACK_BASE; address++)
+      lines |= 1u << ((offsetof(CPU, memory) + address) / 64);
+  return lines;
+}
+
+#endif // CPU_ARENA_H
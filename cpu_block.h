@@ -0,0 +1,887 @@
+#ifndef CPU_BLOCK_H
+#define CPU_BLOCK_H
+
+#include "cpu.h"
+
+/*
+ * Basic-block translator (3-byte format). Experimental: slower than
+ * cpu_step on most code, see below; use cpu_run_fast for speed.
+ *
+ * A block is the straight-line code from an entry PC up to and including the
+ * first control transfer (B, JSR, RTS, JMP, HALT), at most
+ * CPU_BLOCK_MAX_STEPS instructions. It is decoded once into ops, cached by
+ * entry PC and replayed by cpu_run_blocks. An instruction outside the
+ * verifier's mode table ends a block before it; such instructions, and
+ * blocks longer than the remaining step budget, run through cpu_step.
+ *
+ * Translation propagates constants over A, X and the flag bits: an
+ * instruction whose result is known at translation time (immediate loads,
+ * immediate arithmetic on a known register, INX/DEX, register shifts) emits
+ * nothing. Known values reach the CPU through one BLOCK_OP_SET, placed
+ * before the first instruction that reads them or at the block exit.
+ * Everything is materialized before an instruction that can halt, store or
+ * transfer control, so the CPU state is exact wherever a block can stop.
+ *
+ * Replay runs the ops through one switch holding the instruction bodies of
+ * cpu_run_fast, with the registers in locals for the length of a block. It
+ * still dispatches once per op, and each block adds a cache lookup and the
+ * exit writes, so it only pays off where translation removed work (folded
+ * instructions, dead flags). On the benchmark programs it runs at 0.74-0.84x
+ * of cpu_step on loop, fibonacci and shift, and 1.04x on arithmetic.
+ *
+ * A backward pass then tracks which flag bits are live: all of them at the
+ * block exit and at every instruction that can stop the run, the ones a
+ * branch, ROR/ROL or POP reads elsewhere. ALU instructions whose flags are
+ * all overwritten before being read run without computing them
+ * (BLOCK_OP_NOFLAGS; a dead CMP/CPX does nothing), and dead bits are dropped
+ * from SET ops.
+ *
+ * Self-modifying code: memory is split in CPU_BLOCK_PAGES pages and the
+ * cache keeps a mask of the pages holding translated code, plus the blocks
+ * covering each page. Every guest store tests its page bit, and that single
+ * test is all a store outside code pages costs. A store into a code page
+ * invalidates the blocks whose bytes include the written address (and only
+ * those), bumps the generation and, when one was invalidated, leaves the
+ * current block right after the store. Code changed from outside
+ * cpu_run_blocks (the embedder, another engine) goes through
+ * cpu_block_invalidate, or cpu_block_cache_flush. Use one cache per guest.
+ */
+
+#ifndef CPU_BLOCK_MAX_STEPS
+#define CPU_BLOCK_MAX_STEPS 16
+#endif
+_Static_assert(CPU_BLOCK_MAX_STEPS >= 1 && CPU_BLOCK_MAX_STEPS <= 64,
+               "bad block size");
+
+// Invalidation granularity: 16-byte pages, one bit each in a 32-bit mask
+#ifndef CPU_BLOCK_PAGE_SHIFT
+#define CPU_BLOCK_PAGE_SHIFT 4
+#endif
+#define CPU_BLOCK_PAGES (MAX_MEMORY_SIZE >> CPU_BLOCK_PAGE_SHIFT)
+_Static_assert(CPU_BLOCK_PAGES >= 1 && CPU_BLOCK_PAGES <= 32,
+               "bad block page size");
+
+// One SET before each guest instruction at most, plus the exit SET
+#define CPU_BLOCK_MAX_OPS (2 * CPU_BLOCK_MAX_STEPS + 1)
+
+// Op kinds
+enum {
+  BLOCK_OP_SET = 0x00, // Materialize known registers and flags
+  BLOCK_OP_GUEST,      // Run the guest instruction (body inlined)
+  BLOCK_OP_NOFLAGS,    // Guest ALU instruction whose flags are all dead
+};
+
+// Registers in BLOCK_OP_SET / translation state
+enum {
+  BLOCK_REG_A = 1 << 0,
+  BLOCK_REG_X = 1 << 1,
+  BLOCK_REGS_ALL = BLOCK_REG_A | BLOCK_REG_X
+};
+
+// Guest memory an op writes (checked against translated code)
+enum {
+  BLOCK_STORE_NONE = 0x00,
+  BLOCK_STORE_ADDRESS, // The effective address (STA, STX, memory shifts)
+  BLOCK_STORE_STACK,   // Bytes pushed below SP (PUSH, JSR)
+  BLOCK_STORE_RANGE,   // A bytes from X (MOVE, FILL)
+};
+
+typedef struct {
+  uint8_t kind;       // BLOCK_OP_*
+  uint8_t retire;     // Guest instructions this op completes
+  uint8_t next_pc;    // PC once the op has run
+  uint8_t opcode;     // Guest instruction (BLOCK_OP_GUEST)
+  uint8_t mode;
+  uint8_t operand;
+  uint8_t store;      // BLOCK_STORE_*
+  uint8_t regs;       // BLOCK_REG_* to set (BLOCK_OP_SET)
+  uint8_t a, x;       // Their values
+  uint8_t flag_mask;  // Flag bits to set (BLOCK_OP_SET)
+  uint8_t flag_value;
+} CPUBlockOp;
+
+typedef struct {
+  uint8_t valid;  // Translated
+  uint8_t steps;  // Guest instructions (0: run the entry with cpu_step)
+  uint8_t count;  // Ops
+  uint8_t end_pc; // PC after the last instruction
+  CPUBlockOp op[CPU_BLOCK_MAX_OPS];
+} CPUBlock;
+
+typedef struct {
+  CPUBlock block[MAX_MEMORY_SIZE]; // By entry PC
+  uint32_t code_pages;             // Bit p: page p holds translated code
+  cpu_bitmap page_blocks[CPU_BLOCK_PAGES]; // Entry PCs of blocks on page p
+  uint64_t generation;    // Bumped whenever translations are dropped
+  uint64_t translations;  // Blocks translated
+  uint64_t hits;          // Lookups served by an existing translation
+  uint64_t folded;        // Instructions folded at translation
+  uint64_t dead_flags;    // Instructions with their flags elided
+  uint64_t invalidations; // Blocks dropped by stores into their code
+} CPUBlockCache;
+
+/* Drop every translation (counters are kept) */
+static inline void cpu_block_cache_flush(CPUBlockCache *cache) {
+  for (unsigned pc = 0; pc < MAX_MEMORY_SIZE; pc++)
+    cache->block[pc].valid = 0;
+  cache->code_pages = 0;
+  __builtin_memset(cache->page_blocks, 0, sizeof(cache->page_blocks));
+  cache->generation++;
+}
+
+static inline void cpu_block_cache_reset(CPUBlockCache *cache) {
+  cpu_block_cache_flush(cache);
+  cache->generation = 0;
+  cache->translations = 0;
+  cache->hits = 0;
+  cache->folded = 0;
+  cache->dead_flags = 0;
+  cache->invalidations = 0;
+}
+
+/* Bytes of guest code a block was translated from. A block of no
+   instructions still covers its entry, so patching it retranslates. */
+static inline unsigned block_bytes(const CPUBlock *block) {
+  return block->steps ? 3u * block->steps : 3u;
+}
+
+/* Add or remove a valid block in the page sets it covers */
+static inline void block_pages_link(CPUBlockCache *cache, uint8_t entry,
+                                    int link) {
+  unsigned first = entry >> CPU_BLOCK_PAGE_SHIFT;
+  unsigned last = (uint8_t)(entry + block_bytes(&cache->block[entry]) - 1) >>
+                  CPU_BLOCK_PAGE_SHIFT;
+
+  for (unsigned p = first;; p = (p + 1) % CPU_BLOCK_PAGES) {
+    cpu_bitmap *blocks = &cache->page_blocks[p];
+    if (link) {
+      bitmap_set(blocks, entry);
+      cache->code_pages |= 1u << p;
+    } else {
+      bitmap_clear(blocks, entry);
+      if (!(blocks->bits[0] | blocks->bits[1] | blocks->bits[2] |
+            blocks->bits[3]))
+        cache->code_pages &= ~(1u << p);
+    }
+    if (p == last)
+      break;
+  }
+}
+
+/* Drop the blocks of one code page that overlap [address, address + count) */
+static inline unsigned block_invalidate_page(CPUBlockCache *cache,
+                                             unsigned page, uint8_t address,
+                                             unsigned count) {
+  cpu_bitmap blocks = cache->page_blocks[page]; // Unlinking edits the set
+  unsigned dropped = 0;
+
+  for (unsigned w = 0; w < MAX_MEMORY_SIZE / 64; w++) {
+    for (uint64_t bits = blocks.bits[w]; bits; bits &= bits - 1) {
+      uint8_t entry = (uint8_t)(w * 64 + (unsigned)__builtin_ctzll(bits));
+      CPUBlock *block = &cache->block[entry];
+      if ((uint8_t)(entry - address) >= count &&
+          (uint8_t)(address - entry) >= block_bytes(block))
+        continue; // Same page, other bytes
+      block_pages_link(cache, entry, 0);
+      block->valid = 0;
+      dropped++;
+    }
+  }
+  return dropped;
+}
+
+/* Drop the translations whose code overlaps the count bytes from address
+   (wrapping at 256). Returns the number of blocks dropped. Costs one bit
+   test per page the range touches when none of them holds code. */
+static inline unsigned cpu_block_invalidate_range(CPUBlockCache *cache,
+                                                  uint8_t address,
+                                                  unsigned count) {
+  const unsigned page_size = 1u << CPU_BLOCK_PAGE_SHIFT;
+  unsigned page = address >> CPU_BLOCK_PAGE_SHIFT;
+  unsigned pages, dropped = 0;
+
+  if (count == 0)
+    return 0;
+  if (count > MAX_MEMORY_SIZE)
+    count = MAX_MEMORY_SIZE;
+  pages = ((address & (page_size - 1)) + count - 1) / page_size + 1;
+  if (pages > CPU_BLOCK_PAGES)
+    pages = CPU_BLOCK_PAGES;
+
+  for (; pages > 0; pages--, page = (page + 1) % CPU_BLOCK_PAGES)
+    if (UNLIKELY((cache->code_pages >> page) & 1))
+      dropped += block_invalidate_page(cache, page, address, count);
+  if (dropped) {
+    cache->invalidations += dropped;
+    cache->generation++;
+  }
+  return dropped;
+}
+
+/* Single-byte form, what a guest store goes through */
+static inline unsigned cpu_block_invalidate(CPUBlockCache *cache,
+                                            uint8_t address) {
+  if (LIKELY(!((cache->code_pages >> (address >> CPU_BLOCK_PAGE_SHIFT)) & 1)))
+    return 0;
+  return cpu_block_invalidate_range(cache, address, 1);
+}
+
+/* A cache is about 100 KiB: heap allocated, reset. NULL on failure. */
+static inline CPUBlockCache *cpu_block_cache_create(void) {
+  CPUBlockCache *cache = malloc(sizeof(CPUBlockCache));
+  if (cache)
+    cpu_block_cache_reset(cache);
+  return cache;
+}
+
+static inline void cpu_block_cache_destroy(CPUBlockCache *cache) {
+  free(cache);
+}
+
+// ============================================================================
+// TRANSLATION
+// ============================================================================
+
+/* Values known at translation time; dirty ones are not in the CPU yet */
+typedef struct {
+  uint8_t known, dirty; // BLOCK_REG_*
+  uint8_t a, x;
+  uint8_t flags_known, flags_dirty; // FLAG_ARITH bits
+  uint8_t flags;
+  uint8_t folded; // Folded instructions not retired by an op yet
+} block_state;
+
+static inline void block_set_reg(block_state *s, uint8_t reg, uint8_t value) {
+  if (reg == BLOCK_REG_A)
+    s->a = value;
+  else
+    s->x = value;
+  s->known |= reg;
+  s->dirty |= reg;
+}
+
+static inline void block_set_flags(block_state *s, uint8_t mask,
+                                   uint8_t flags) {
+  s->flags = (uint8_t)((s->flags & ~mask) | (flags & mask));
+  s->flags_known |= mask;
+  s->flags_dirty |= mask;
+}
+
+/* Fold an instruction into the state if its result is known. Returns 1 if
+   it was folded (no op needed). */
+static inline int block_fold(block_state *s, uint8_t opcode, uint8_t mode,
+                             uint8_t operand) {
+  const uint8_t zn = FLAG_ZERO | FLAG_NEGATIVE;
+  uint8_t r;
+
+  switch (opcode) {
+  case OPCODE_NOP:
+    return 1;
+  case OPCODE_LDA:
+  case OPCODE_LDX:
+    if (mode != MODE_IMMEDIAT)
+      return 0;
+    block_set_reg(s, opcode == OPCODE_LDA ? BLOCK_REG_A : BLOCK_REG_X,
+                  operand);
+    block_set_flags(s, zn, flags_zn(0, operand));
+    return 1;
+  case OPCODE_ADD:
+  case OPCODE_SUB:
+  case OPCODE_CMP:
+    if (mode != MODE_IMMEDIAT || !(s->known & BLOCK_REG_A))
+      return 0;
+    block_set_flags(s, FLAG_ARITH,
+                    opcode == OPCODE_ADD ? flags_add(0, s->a, operand, &r)
+                                         : flags_sub(0, s->a, operand, &r));
+    if (opcode != OPCODE_CMP)
+      block_set_reg(s, BLOCK_REG_A, r);
+    return 1;
+  case OPCODE_CPX:
+    if (mode != MODE_IMMEDIAT || !(s->known & BLOCK_REG_X))
+      return 0;
+    block_set_flags(s, FLAG_ARITH, flags_sub(0, s->x, operand, &r));
+    return 1;
+  case OPCODE_AND:
+  case OPCODE_OR:
+  case OPCODE_XOR:
+    if (mode != MODE_IMMEDIAT || !(s->known & BLOCK_REG_A))
+      return 0;
+    r = opcode == OPCODE_AND  ? (uint8_t)(s->a & operand)
+        : opcode == OPCODE_OR ? (uint8_t)(s->a | operand)
+                              : (uint8_t)(s->a ^ operand);
+    block_set_reg(s, BLOCK_REG_A, r);
+    block_set_flags(s, zn, flags_zn(0, r));
+    return 1;
+  case OPCODE_INX:
+  case OPCODE_DEX:
+    if (!(s->known & BLOCK_REG_X))
+      return 0;
+    r = (uint8_t)(opcode == OPCODE_INX ? s->x + 1 : s->x - 1);
+    block_set_reg(s, BLOCK_REG_X, r);
+    block_set_flags(s, zn, flags_zn(0, r));
+    return 1;
+  case OPCODE_ROR:
+  case OPCODE_ROL:
+  case OPCODE_SHR:
+  case OPCODE_SHL: {
+    if (mode == MODE_IMMEDIAT)
+      return 1; // No-op
+    int carry_in = opcode == OPCODE_ROR || opcode == OPCODE_ROL;
+    if (mode != MODE_REGISTER || !(s->known & BLOCK_REG_A) ||
+        (carry_in && !(s->flags_known & FLAG_CARRY)))
+      return 0;
+    uint8_t c = s->flags & FLAG_CARRY;
+    uint16_t v = opcode == OPCODE_ROR   ? rmw_ror(s->a, c)
+                 : opcode == OPCODE_ROL ? rmw_rol(s->a, c)
+                 : opcode == OPCODE_SHR ? rmw_shr(s->a, c)
+                                        : rmw_shl(s->a, c);
+    block_set_reg(s, BLOCK_REG_A, RMW_RESULT(v));
+    block_set_flags(s, FLAG_CARRY | zn,
+                    flags_znc(0, RMW_RESULT(v), RMW_CARRY(v)));
+    return 1;
+  }
+  }
+  return 0;
+}
+
+/* What an instruction that was not folded reads and writes. Returns 1 if
+   it can halt, store or transfer control (everything is materialized). */
+static inline int block_effects(uint8_t opcode, uint8_t mode, uint8_t operand,
+                                uint8_t *reads, uint8_t *flags_read,
+                                uint8_t *writes, uint8_t *flags_written) {
+  const uint8_t zn = FLAG_ZERO | FLAG_NEGATIVE;
+  uint8_t indexed =
+      mode == MODE_ABSOLUTE_X || mode == MODE_INDIRECT_X ? BLOCK_REG_X : 0;
+
+  *reads = indexed;
+  *flags_read = 0;
+  *writes = 0;
+  *flags_written = 0;
+  switch (opcode) {
+  case OPCODE_LDA:
+    *writes = BLOCK_REG_A;
+    *flags_written = zn;
+    return 0;
+  case OPCODE_LDX:
+    *writes = BLOCK_REG_X;
+    *flags_written = zn;
+    return 0;
+  case OPCODE_ADD:
+  case OPCODE_SUB:
+    *reads |= BLOCK_REG_A;
+    *writes = BLOCK_REG_A;
+    *flags_written = FLAG_ARITH;
+    return 0;
+  case OPCODE_AND:
+  case OPCODE_OR:
+  case OPCODE_XOR:
+    *reads |= BLOCK_REG_A;
+    *writes = BLOCK_REG_A;
+    *flags_written = zn;
+    return 0;
+  case OPCODE_CMP:
+    *reads |= BLOCK_REG_A;
+    *flags_written = FLAG_ARITH;
+    return 0;
+  case OPCODE_CPX:
+    *reads |= BLOCK_REG_X;
+    *flags_written = FLAG_ARITH;
+    return 0;
+  case OPCODE_INX:
+  case OPCODE_DEX:
+    *reads = BLOCK_REG_X;
+    *writes = BLOCK_REG_X;
+    *flags_written = zn;
+    return 0;
+  case OPCODE_ROR:
+  case OPCODE_ROL:
+  case OPCODE_SHR:
+  case OPCODE_SHL:
+    *flags_written = FLAG_CARRY | zn;
+    if (opcode == OPCODE_ROR || opcode == OPCODE_ROL)
+      *flags_read = FLAG_CARRY;
+    if (mode != MODE_REGISTER)
+      return 1; // Stores
+    *reads = BLOCK_REG_A;
+    *writes = BLOCK_REG_A;
+    return 0;
+  case OPCODE_POP:
+    if (!stack_masked(mode, operand)) {
+      *writes = BLOCK_REG_A;
+      *flags_written = zn;
+    } else {
+      *writes = (uint8_t)(((operand & STACK_REG_A) ? BLOCK_REG_A : 0) |
+                          ((operand & STACK_REG_X) ? BLOCK_REG_X : 0));
+      *flags_written = (operand & STACK_REG_FLAGS) ? FLAG_ARITH : 0;
+    }
+    return 1;
+  }
+  return 1; // STA, STX, PUSH, MOVE, FILL and control transfers
+}
+
+static inline uint8_t block_store_kind(uint8_t opcode, uint8_t mode) {
+  switch (opcode) {
+  case OPCODE_STA:
+  case OPCODE_STX:
+    return BLOCK_STORE_ADDRESS;
+  case OPCODE_ROR:
+  case OPCODE_ROL:
+  case OPCODE_SHR:
+  case OPCODE_SHL:
+    return mode == MODE_IMMEDIAT || mode == MODE_REGISTER ? BLOCK_STORE_NONE
+                                                          : BLOCK_STORE_ADDRESS;
+  case OPCODE_PUSH:
+  case OPCODE_JSR:
+    return BLOCK_STORE_STACK;
+  case OPCODE_MOVE:
+  case OPCODE_FILL:
+    return BLOCK_STORE_RANGE;
+  }
+  return BLOCK_STORE_NONE;
+}
+
+static inline int block_terminator(uint8_t opcode) {
+  return opcode == OPCODE_B || opcode == OPCODE_JSR || opcode == OPCODE_RTS ||
+         opcode == OPCODE_JMP || opcode == OPCODE_HALT;
+}
+
+/* Instruction defined by the mode table (what cpu_verify accepts) */
+static inline int block_valid(uint8_t opcode, uint8_t mode) {
+  if (opcode >= OPCODE_COUNT)
+    return 0;
+  if (opcode == OPCODE_B)
+    return mode < COND_COUNT;
+  return mode < MODE_COUNT && ((opcode_modes[opcode] >> mode) & 1);
+}
+
+/* Emit a SET for the dirty values among regs / flag_mask. Folded
+   instructions ride on the next op, so a SET with nothing to set is only
+   emitted when force is set (block exit). */
+static inline void block_emit_set(CPUBlock *block, block_state *s,
+                                  uint8_t regs, uint8_t flag_mask,
+                                  uint8_t pc, int force) {
+  regs &= s->dirty;
+  flag_mask &= s->flags_dirty;
+  if (!regs && !flag_mask && !(force && s->folded))
+    return;
+
+  CPUBlockOp *op = &block->op[block->count++];
+  __builtin_memset(op, 0, sizeof(*op));
+  op->kind = BLOCK_OP_SET;
+  op->retire = s->folded;
+  op->next_pc = pc;
+  op->regs = regs;
+  op->a = s->a;
+  op->x = s->x;
+  op->flag_mask = flag_mask;
+  op->flag_value = s->flags & flag_mask;
+  s->folded = 0;
+  s->dirty &= (uint8_t)~regs;
+  s->flags_dirty &= (uint8_t)~flag_mask;
+}
+
+/* Flag liveness, backward over the ops of a block. A flag is live if some
+   later op reads it before writing it; every flag is live at the block exit
+   and before an op that can halt, store or transfer control, since the run
+   can stop there. */
+static inline void block_flag_liveness(CPUBlockCache *cache, CPUBlock *block) {
+  uint8_t live = FLAG_ARITH;
+
+  for (unsigned i = block->count; i-- > 0;) {
+    CPUBlockOp *op = &block->op[i];
+    uint8_t reads, flags_read, writes, flags_written;
+
+    if (op->kind == BLOCK_OP_SET) {
+      op->flag_mask &= live;
+      op->flag_value &= live;
+      live &= (uint8_t)~op->flag_mask;
+      continue;
+    }
+    if (block_effects(op->opcode, op->mode, op->operand, &reads, &flags_read,
+                      &writes, &flags_written)) {
+      live = FLAG_ARITH;
+      continue;
+    }
+    if (!(flags_written & live)) {
+      if (op->opcode == OPCODE_CMP || op->opcode == OPCODE_CPX) {
+        // Nothing left to do: retire it through an empty SET
+        op->kind = BLOCK_OP_SET;
+        op->regs = 0;
+        op->flag_mask = 0;
+        op->flag_value = 0;
+      } else {
+        op->kind = BLOCK_OP_NOFLAGS;
+      }
+      cache->dead_flags++;
+    }
+    live = (uint8_t)((live & ~flags_written) | flags_read);
+  }
+}
+
+/* Translate the block at entry from the current guest memory */
+static inline CPUBlock *cpu_block_translate(CPUBlockCache *cache,
+                                            const CPU *cpu, uint8_t entry) {
+  const uint8_t *memory = cpu->memory;
+  CPUBlock *block = &cache->block[entry];
+  block_state s;
+  uint8_t pc = entry;
+  int terminated = 0;
+
+  __builtin_memset(&s, 0, sizeof(s));
+  if (block->valid)
+    block_pages_link(cache, entry, 0);
+  block->steps = 0;
+  block->count = 0;
+  while (block->steps < CPU_BLOCK_MAX_STEPS && !terminated) {
+    uint8_t opcode = memory[pc];
+    uint8_t mode = memory[(uint8_t)(pc + 1)];
+    uint8_t operand = memory[(uint8_t)(pc + 2)];
+    uint8_t next = (uint8_t)(pc + 3);
+
+    if (!block_valid(opcode, mode))
+      break;
+    block->steps++;
+
+    if (block_fold(&s, opcode, mode, operand)) {
+      s.folded++;
+      cache->folded++;
+      pc = next;
+      continue;
+    }
+
+    uint8_t reads, flags_read, writes, flags_written;
+    int exits = block_effects(opcode, mode, operand, &reads, &flags_read,
+                              &writes, &flags_written);
+    if (exits)
+      block_emit_set(block, &s, BLOCK_REGS_ALL, FLAG_ARITH, pc, 0);
+    else
+      block_emit_set(block, &s, reads, flags_read, pc, 0);
+
+    CPUBlockOp *op = &block->op[block->count++];
+    __builtin_memset(op, 0, sizeof(*op));
+    op->kind = BLOCK_OP_GUEST;
+    op->retire = (uint8_t)(s.folded + 1);
+    op->next_pc = next;
+    op->opcode = opcode;
+    op->mode = mode;
+    op->operand = operand;
+    op->store = block_store_kind(opcode, mode);
+    s.folded = 0;
+
+    // Results the op produces are no longer known (or pending)
+    s.known &= (uint8_t)~writes;
+    s.dirty &= (uint8_t)~writes;
+    s.flags_known &= (uint8_t)~flags_written;
+    s.flags_dirty &= (uint8_t)~flags_written;
+    terminated = block_terminator(opcode);
+    pc = next;
+  }
+  if (!terminated)
+    block_emit_set(block, &s, BLOCK_REGS_ALL, FLAG_ARITH, pc, 1);
+  block_flag_liveness(cache, block);
+
+  block->end_pc = pc;
+  block->valid = 1;
+  block_pages_link(cache, entry, 1);
+  cache->translations++;
+  return block;
+}
+
+// ============================================================================
+// EXECUTION
+// ============================================================================
+
+/* Invalidate the translations an instruction is about to store into (before
+   it runs: the address of an indirect store is read from memory) */
+static inline void block_store_invalidate(CPUBlockCache *cache,
+                                          const uint8_t *memory, uint8_t a,
+                                          uint8_t x, uint8_t sp, uint8_t store,
+                                          uint8_t opcode, uint8_t mode,
+                                          uint8_t operand) {
+  if (store == BLOCK_STORE_ADDRESS) {
+    cpu_block_invalidate(cache, effective_address_x(memory, x, mode, operand));
+    return;
+  }
+  if (store == BLOCK_STORE_RANGE) {
+    cpu_block_invalidate_range(cache, x, a);
+    return;
+  }
+  if (store == BLOCK_STORE_STACK) {
+    unsigned count = opcode == OPCODE_JSR ? 1 : stack_count(mode, operand);
+    for (unsigned i = 0; i < count; i++)
+      cpu_block_invalidate(cache, (uint8_t)(sp - i));
+  }
+}
+
+/* ALU instruction with dead flags: the result only (register modes for the
+   shifts, the others never halt or store) */
+static inline __attribute__((always_inline)) void
+block_noflags(const uint8_t *memory, uint8_t *a, uint8_t *x, uint8_t flags,
+              const CPUBlockOp *op) {
+  uint8_t mode = op->mode, operand = op->operand;
+  uint8_t c = flags & FLAG_CARRY;
+
+  switch (op->opcode) {
+  case OPCODE_LDA:
+    *a = operand_value_x(memory, *x, mode, operand);
+    break;
+  case OPCODE_LDX:
+    *x = operand_value_x(memory, *x, mode, operand);
+    break;
+  case OPCODE_ADD:
+    *a = (uint8_t)(*a + operand_value_x(memory, *x, mode, operand));
+    break;
+  case OPCODE_SUB:
+    *a = (uint8_t)(*a - operand_value_x(memory, *x, mode, operand));
+    break;
+  case OPCODE_AND:
+    *a &= operand_value_x(memory, *x, mode, operand);
+    break;
+  case OPCODE_OR:
+    *a |= operand_value_x(memory, *x, mode, operand);
+    break;
+  case OPCODE_XOR:
+    *a ^= operand_value_x(memory, *x, mode, operand);
+    break;
+  case OPCODE_INX:
+    (*x)++;
+    break;
+  case OPCODE_DEX:
+    (*x)--;
+    break;
+  case OPCODE_ROR:
+    *a = RMW_RESULT(rmw_ror(*a, c));
+    break;
+  case OPCODE_ROL:
+    *a = RMW_RESULT(rmw_rol(*a, c));
+    break;
+  case OPCODE_SHR:
+    *a = RMW_RESULT(rmw_shr(*a, c));
+    break;
+  case OPCODE_SHL:
+    *a = RMW_RESULT(rmw_shl(*a, c));
+    break;
+  }
+}
+
+/* Run the ops of a block; *n counts retired instructions. As in
+   cpu_run_fast, the instruction bodies are inlined and the registers live
+   in locals, written back when the block ends. Translation only emits
+   instructions from the mode table, so the stack bounds are the only
+   checks left. */
+static inline int block_execute(CPU *cpu, CPUBlockCache *cache,
+                                const CPUBlock *block, uint64_t *n) {
+  uint8_t *const memory = cpu->memory;
+  uint8_t a = cpu->A;
+  uint8_t x = cpu->X;
+  uint8_t pc = cpu->PC;
+  uint8_t sp = cpu->SP;
+  uint8_t flags = cpu->flags;
+  uint64_t retired = *n;
+  int status = CPU_OK;
+
+  const CPUBlockOp *op = block->op;
+  const CPUBlockOp *const end = op + block->count;
+
+  for (; op < end; op++) {
+    uint8_t mode = op->mode, operand = op->operand;
+    uint8_t compare; // CMP/CPX result, discarded
+
+    retired += op->retire;
+    // NOFLAGS ops never halt and never end a block: no PC update
+    if (op->kind == BLOCK_OP_NOFLAGS) {
+      block_noflags(memory, &a, &x, flags, op);
+      continue;
+    }
+    pc = op->next_pc;
+    if (op->kind == BLOCK_OP_SET) {
+      if (op->regs & BLOCK_REG_A)
+        a = op->a;
+      if (op->regs & BLOCK_REG_X)
+        x = op->x;
+      flags = (uint8_t)((flags & ~op->flag_mask) | op->flag_value);
+      continue;
+    }
+
+    uint64_t generation = cache->generation;
+    uint8_t store = op->store;
+    if (store != BLOCK_STORE_NONE)
+      block_store_invalidate(cache, memory, a, x, sp, store, op->opcode, mode,
+                             operand);
+    switch (op->opcode) {
+    case OPCODE_NOP:
+      break;
+    case OPCODE_LDA:
+      a = operand_value_x(memory, x, mode, operand);
+      flags = flags_zn(flags, a);
+      break;
+    case OPCODE_LDX:
+      x = operand_value_x(memory, x, mode, operand);
+      flags = flags_zn(flags, x);
+      break;
+    case OPCODE_STA:
+      memory[effective_address_x(memory, x, mode, operand)] = a;
+      break;
+    case OPCODE_STX:
+      memory[effective_address_x(memory, x, mode, operand)] = x;
+      break;
+    case OPCODE_ADD:
+      flags = flags_add(flags, a, operand_value_x(memory, x, mode, operand),
+                        &a);
+      break;
+    case OPCODE_SUB:
+      flags = flags_sub(flags, a, operand_value_x(memory, x, mode, operand),
+                        &a);
+      break;
+    case OPCODE_XOR:
+      a ^= operand_value_x(memory, x, mode, operand);
+      flags = flags_zn(flags, a);
+      break;
+    case OPCODE_AND:
+      a &= operand_value_x(memory, x, mode, operand);
+      flags = flags_zn(flags, a);
+      break;
+    case OPCODE_OR:
+      a |= operand_value_x(memory, x, mode, operand);
+      flags = flags_zn(flags, a);
+      break;
+    case OPCODE_B:
+      pc = branch_taken(flags, mode) ? operand : pc;
+      break;
+    case OPCODE_POP:
+      if (UNLIKELY(!stack_can_pop(sp, stack_count(mode, operand))))
+        FAST_HALT(); // Stack underflow
+      if (stack_masked(mode, operand)) {
+        STACK_POP_REGS(memory, sp, operand, a, x, flags);
+        break;
+      }
+      sp++;
+      a = memory[sp];
+      flags = flags_zn(flags, a);
+      break;
+    case OPCODE_PUSH:
+      if (UNLIKELY(!stack_can_push(sp, stack_count(mode, operand))))
+        FAST_HALT(); // Stack overflow
+      if (stack_masked(mode, operand)) {
+        STACK_PUSH_REGS(memory, sp, operand, a, x, flags);
+        break;
+      }
+      memory[sp] = a;
+      sp--;
+      break;
+    case OPCODE_JSR:
+      if (UNLIKELY(!stack_can_push(sp, 1)))
+        FAST_HALT(); // Stack overflow
+      memory[sp--] = pc;
+      pc = operand;
+      break;
+    case OPCODE_RTS:
+      if (UNLIKELY(!stack_can_pop(sp, 1)))
+        FAST_HALT(); // Stack underflow
+      pc = memory[++sp];
+      break;
+    case OPCODE_JMP:
+      pc = effective_address_x(memory, x, mode, operand);
+      break;
+    case OPCODE_MOVE:
+      memory_move(memory, x, effective_address_x(memory, x, mode, operand),
+                  a);
+      break;
+    case OPCODE_FILL:
+      memory_fill(memory, x, operand_value_x(memory, x, mode, operand), a);
+      break;
+    case OPCODE_CMP:
+      flags = flags_sub(flags, a, operand_value_x(memory, x, mode, operand),
+                        &compare);
+      break;
+    case OPCODE_CPX:
+      flags = flags_sub(flags, x, operand_value_x(memory, x, mode, operand),
+                        &compare);
+      break;
+    case OPCODE_ROR:
+      FAST_RMW(rmw_ror);
+      break;
+    case OPCODE_ROL:
+      FAST_RMW(rmw_rol);
+      break;
+    case OPCODE_SHR:
+      FAST_RMW(rmw_shr);
+      break;
+    case OPCODE_SHL:
+      FAST_RMW(rmw_shl);
+      break;
+    case OPCODE_INX:
+      x++;
+      flags = flags_zn(flags, x);
+      break;
+    case OPCODE_DEX:
+      x--;
+      flags = flags_zn(flags, x);
+      break;
+    case OPCODE_HALT:
+      FAST_HALT();
+    }
+    if (store != BLOCK_STORE_NONE && UNLIKELY(cache->generation != generation))
+      break; // The rest of this block may be stale
+  }
+  goto done;
+
+halted:
+  status = CPU_HALTED;
+done:
+  cpu->A = a;
+  cpu->X = x;
+  cpu->PC = pc;
+  cpu->SP = sp;
+  cpu->flags = flags;
+  *n = retired;
+  return status;
+}
+
+/* One instruction through cpu_step (undefined instructions, blocks larger
+   than the budget), with the same check for stores into translated code.
+   The stores are those cpu_step performs, not the verifier's: JSR pushes
+   in any mode. */
+static inline int block_step(CPU *cpu, CPUBlockCache *cache) {
+  const uint8_t *memory = cpu->memory;
+  uint8_t opcode = memory[cpu->PC];
+  uint8_t mode = memory[(uint8_t)(cpu->PC + 1)];
+  uint8_t operand = memory[(uint8_t)(cpu->PC + 2)];
+
+  if (opcode < OPCODE_COUNT && instruction_runs(opcode, mode))
+    block_store_invalidate(cache, memory, cpu->A, cpu->X, cpu->SP,
+                           block_store_kind(opcode, mode), opcode, mode,
+                           operand);
+  return cpu_step(cpu);
+}
+
+/* Run up to max_steps instructions through the block cache, same contract
+   as cpu_run_fast: CPU_HALTED if the guest halted, CPU_OK if the budget ran
+   out, *retired (if non-NULL) counts the halting instruction. */
+static inline int cpu_run_blocks(CPU *cpu, CPUBlockCache *cache,
+                                 uint64_t max_steps, uint64_t *retired) {
+  uint64_t n = 0;
+  int status = CPU_OK;
+
+  if (UNLIKELY(cpu->flags & FLAG_HALTED))
+    status = CPU_HALTED;
+  while (status == CPU_OK && n < max_steps) {
+    const CPUBlock *block = &cache->block[cpu->PC];
+    if (UNLIKELY(!block->valid))
+      block = cpu_block_translate(cache, cpu, cpu->PC);
+    else
+      cache->hits++;
+
+    if (UNLIKELY(block->steps == 0 || block->steps > max_steps - n)) {
+      status = block_step(cpu, cache);
+      n++;
+      continue;
+    }
+    status = block_execute(cpu, cache, block, &n);
+  }
+  if (retired)
+    *retired = n;
+  return status;
+}
+
+#endif // CPU_BLOCK_H
@@ -0,0 +1,247 @@
+#ifndef CPU_DEBUG_H
+#define CPU_DEBUG_H
+
+#include "cpu.h"
+
+/*
+ * Debug engine: PC breakpoints and read/write memory watchpoints.
+ *
+ * The production engine (cpu_step / cpu_step_packed) is not touched. The
+ * debug engine probes the memory accesses of the next instruction with
+ * watch-aware copies of get_effective_address / get_operand_value and only
+ * then hands the instruction to cpu_step. Selecting an engine is a matter of
+ * calling cpu_step_debug instead of cpu_step, so the normal path pays
+ * nothing for the debugger being available.
+ *
+ * A stop happens *before* the instruction executes: PC still points at the
+ * instruction and memory is not yet modified. Calling cpu_step_debug again
+ * executes the instruction (the pending stop is stepped over).
+ */
+
+/* Debug engine return code (in addition to CPU_OK / CPU_HALTED) */
+#define CPU_BREAK -2
+
+// Watchpoint kinds (may be combined)
+enum {
+  WATCH_READ = 1 << 0,  // Stop before a memory read
+  WATCH_WRITE = 1 << 1, // Stop before a memory write
+};
+
+// Stop reasons
+enum {
+  DEBUG_STOP_NONE = 0x00, // No stop pending
+  DEBUG_STOP_BREAKPOINT,  // PC breakpoint
+  DEBUG_STOP_READ,        // Read watchpoint
+  DEBUG_STOP_WRITE,       // Write watchpoint
+};
+
+// Debugger state (kept outside CPU so the production layout is unchanged)
+typedef struct {
+  cpu_bitmap breakpoints; // PC breakpoints
+  cpu_bitmap watch_read;  // Read watchpoints
+  cpu_bitmap watch_write; // Write watchpoints
+  uint8_t stop_reason;    // DEBUG_STOP_* of the last CPU_BREAK
+  uint8_t stop_pc;        // Instruction start of the last stop
+  uint8_t stop_addr;      // Address hit (watchpoints) or PC (breakpoints)
+  uint8_t resume;         // Step over the stop if still at stop_pc
+} CPUDebug;
+
+// ============================================================================
+// DEBUGGER API
+// ============================================================================
+
+static inline void cpu_debug_init(CPUDebug *dbg) {
+  __builtin_memset(dbg, 0, sizeof(CPUDebug));
+}
+
+static inline void cpu_debug_set_breakpoint(CPUDebug *dbg, uint8_t pc) {
+  bitmap_set(&dbg->breakpoints, pc);
+}
+
+static inline void cpu_debug_clear_breakpoint(CPUDebug *dbg, uint8_t pc) {
+  bitmap_clear(&dbg->breakpoints, pc);
+}
+
+static inline void cpu_debug_set_watch(CPUDebug *dbg, uint8_t address,
+                                       int kind) {
+  if (kind & WATCH_READ)
+    bitmap_set(&dbg->watch_read, address);
+  if (kind & WATCH_WRITE)
+    bitmap_set(&dbg->watch_write, address);
+}
+
+static inline void cpu_debug_clear_watch(CPUDebug *dbg, uint8_t address,
+                                         int kind) {
+  if (kind & WATCH_READ)
+    bitmap_clear(&dbg->watch_read, address);
+  if (kind & WATCH_WRITE)
+    bitmap_clear(&dbg->watch_write, address);
+}
+
+// ============================================================================
+// WATCH-AWARE ADDRESSING (debug engine only)
+// ============================================================================
+
+/* Record the first watchpoint hit of the instruction being probed */
+static inline void debug_check(CPUDebug *dbg, const cpu_bitmap *map,
+                               uint8_t address, uint8_t reason) {
+  if (UNLIKELY(bitmap_test(map, address)) &&
+      dbg->stop_reason == DEBUG_STOP_NONE) {
+    dbg->stop_reason = reason;
+    dbg->stop_addr = address;
+  }
+}
+
+/* Debug twin of get_effective_address: indirect pointer fetches are reads */
+static inline uint8_t get_effective_address_dbg(const CPU *cpu, CPUDebug *dbg,
+                                                uint8_t mode, uint8_t operand) {
+  uint8_t pointer;
+
+  switch (mode) {
+  case MODE_ABSOLUTE:
+    return operand;
+  case MODE_ABSOLUTE_X:
+    return (uint8_t)(operand + cpu->X);
+  case MODE_INDIRECT:
+    debug_check(dbg, &dbg->watch_read, operand, DEBUG_STOP_READ);
+    return cpu->memory[operand];
+  case MODE_INDIRECT_X:
+    pointer = (uint8_t)(operand + cpu->X);
+    debug_check(dbg, &dbg->watch_read, pointer, DEBUG_STOP_READ);
+    return cpu->memory[pointer];
+  }
+  return 0; // Immediate / register: no memory access
+}
+
+/* Debug twin of get_operand_value: checks every byte the value read touches */
+static inline uint8_t get_operand_value_dbg(const CPU *cpu, CPUDebug *dbg,
+                                            uint8_t mode, uint8_t operand) {
+  if (mode == MODE_IMMEDIAT)
+    return operand;
+  if (mode == MODE_REGISTER)
+    return cpu->A;
+
+  uint8_t address = get_effective_address_dbg(cpu, dbg, mode, operand);
+  debug_check(dbg, &dbg->watch_read, address, DEBUG_STOP_READ);
+  return cpu->memory[address];
+}
+
+/* Probe the memory accesses the decoded instruction is about to perform */
+static inline void debug_probe(const CPU *cpu, CPUDebug *dbg, uint8_t opcode,
+                               uint8_t mode, uint8_t operand) {
+  uint8_t address;
+  unsigned count;
+
+  switch (opcode) {
+  case OPCODE_LDA:
+  case OPCODE_LDX:
+  case OPCODE_ADD:
+  case OPCODE_SUB:
+  case OPCODE_XOR:
+  case OPCODE_AND:
+  case OPCODE_OR:
+  case OPCODE_CMP:
+  case OPCODE_CPX:
+    (void)get_operand_value_dbg(cpu, dbg, mode, operand);
+    break;
+  case OPCODE_STA:
+  case OPCODE_STX:
+    address = get_effective_address_dbg(cpu, dbg, mode, operand);
+    debug_check(dbg, &dbg->watch_write, address, DEBUG_STOP_WRITE);
+    break;
+  case OPCODE_JMP:
+    (void)get_effective_address_dbg(cpu, dbg, mode, operand); // Pointer read
+    break;
+  case OPCODE_MOVE:
+    address = get_effective_address_dbg(cpu, dbg, mode, operand);
+    for (unsigned i = 0; i < cpu->A; i++)
+      debug_check(dbg, &dbg->watch_read, (uint8_t)(address + i),
+                  DEBUG_STOP_READ);
+    for (unsigned i = 0; i < cpu->A; i++)
+      debug_check(dbg, &dbg->watch_write, (uint8_t)(cpu->X + i),
+                  DEBUG_STOP_WRITE);
+    break;
+  case OPCODE_FILL:
+    (void)get_operand_value_dbg(cpu, dbg, mode, operand);
+    for (unsigned i = 0; i < cpu->A; i++)
+      debug_check(dbg, &dbg->watch_write, (uint8_t)(cpu->X + i),
+                  DEBUG_STOP_WRITE);
+    break;
+  case OPCODE_ROR:
+  case OPCODE_ROL:
+  case OPCODE_SHR:
+  case OPCODE_SHL:
+    if (mode == MODE_IMMEDIAT || mode == MODE_REGISTER)
+      break;
+    address = get_effective_address_dbg(cpu, dbg, mode, operand);
+    debug_check(dbg, &dbg->watch_read, address, DEBUG_STOP_READ);
+    debug_check(dbg, &dbg->watch_write, address, DEBUG_STOP_WRITE);
+    break;
+  case OPCODE_PUSH:
+  case OPCODE_JSR:
+    count = opcode == OPCODE_JSR ? 1 : stack_count(mode, operand);
+    if (stack_can_push(cpu->SP, count))
+      for (unsigned i = 0; i < count; i++)
+        debug_check(dbg, &dbg->watch_write, (uint8_t)(cpu->SP - i),
+                    DEBUG_STOP_WRITE);
+    break;
+  case OPCODE_POP:
+  case OPCODE_RTS:
+    count = opcode == OPCODE_RTS ? 1 : stack_count(mode, operand);
+    if (stack_can_pop(cpu->SP, count))
+      for (unsigned i = 1; i <= count; i++)
+        debug_check(dbg, &dbg->watch_read, (uint8_t)(cpu->SP + i),
+                    DEBUG_STOP_READ);
+    break;
+  }
+}
+
+// ============================================================================
+// DEBUG ENGINE
+// ============================================================================
+
+/* cpu_step with breakpoints and watchpoints (3-byte instruction format).
+   Returns CPU_BREAK when stopped before an instruction, otherwise the
+   cpu_step result. */
+static inline int cpu_step_debug(CPU *cpu, CPUDebug *dbg) {
+  uint8_t pc = cpu->PC;
+
+  dbg->stop_reason = DEBUG_STOP_NONE;
+  if (dbg->resume) {
+    dbg->resume = 0;
+    if (pc == dbg->stop_pc)
+      return cpu_step(cpu);
+    // PC moved while stopped: the new instruction has not been checked
+  }
+
+  if (UNLIKELY(bitmap_test(&dbg->breakpoints, pc))) {
+    dbg->stop_reason = DEBUG_STOP_BREAKPOINT;
+    dbg->stop_addr = pc;
+  } else {
+    uint8_t opcode = cpu->memory[pc];
+    uint8_t mode = cpu->memory[(uint8_t)(pc + 1)];
+    uint8_t operand = cpu->memory[(uint8_t)(pc + 2)];
+
+    // Invalid instructions are left to cpu_step (they halt)
+    if (opcode < OPCODE_COUNT && instruction_runs(opcode, mode))
+      debug_probe(cpu, dbg, opcode, mode, operand);
+  }
+
+  if (dbg->stop_reason != DEBUG_STOP_NONE) {
+    dbg->stop_pc = pc;
+    dbg->resume = 1;
+    return CPU_BREAK;
+  }
+  return cpu_step(cpu);
+}
+
+/* Run until the CPU halts or the debugger stops it.
+   Returns CPU_HALTED or CPU_BREAK; call again to continue after a stop. */
+static inline int cpu_run_debug(CPU *cpu, CPUDebug *dbg) {
+  int result;
+  while ((result = cpu_step_debug(cpu, dbg)) == CPU_OK) {
+  }
+  return result;
+}
+
+#endif // CPU_DEBUG_H
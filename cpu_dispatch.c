@@ -0,0 +1,236 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu_dispatch.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define DISPATCH_X86 1
+#endif
+
+/* handlers[opcode](cpu, mode, operand) as direct calls. The table points
+   at copies compiled for the baseline; called directly, the handlers
+   (OPCODE_HANDLER) are inlined and compiled for the level of the caller. */
+static inline __attribute__((always_inline)) void
+dispatch_execute(CPU *cpu, uint8_t opcode, uint8_t mode, uint8_t operand) {
+  switch (opcode) {
+  case OPCODE_NOP:
+    op_nop(cpu, mode, operand);
+    break;
+  case OPCODE_LDA:
+    op_lda(cpu, mode, operand);
+    break;
+  case OPCODE_LDX:
+    op_ldx(cpu, mode, operand);
+    break;
+  case OPCODE_STA:
+    op_sta(cpu, mode, operand);
+    break;
+  case OPCODE_STX:
+    op_stx(cpu, mode, operand);
+    break;
+  case OPCODE_B:
+    op_branch(cpu, mode, operand);
+    break;
+  case OPCODE_ADD:
+    op_add(cpu, mode, operand);
+    break;
+  case OPCODE_SUB:
+    op_sub(cpu, mode, operand);
+    break;
+  case OPCODE_XOR:
+    op_xor(cpu, mode, operand);
+    break;
+  case OPCODE_AND:
+    op_and(cpu, mode, operand);
+    break;
+  case OPCODE_OR:
+    op_or(cpu, mode, operand);
+    break;
+  case OPCODE_POP:
+    op_pop(cpu, mode, operand);
+    break;
+  case OPCODE_PUSH:
+    op_push(cpu, mode, operand);
+    break;
+  case OPCODE_CMP:
+    op_cmp(cpu, mode, operand);
+    break;
+  case OPCODE_CPX:
+    op_cpx(cpu, mode, operand);
+    break;
+  case OPCODE_ROR:
+    op_ror(cpu, mode, operand);
+    break;
+  case OPCODE_ROL:
+    op_rol(cpu, mode, operand);
+    break;
+  case OPCODE_SHR:
+    op_shr(cpu, mode, operand);
+    break;
+  case OPCODE_SHL:
+    op_shl(cpu, mode, operand);
+    break;
+  case OPCODE_INX:
+    op_inx(cpu, mode, operand);
+    break;
+  case OPCODE_DEX:
+    op_dex(cpu, mode, operand);
+    break;
+  case OPCODE_HALT:
+    op_halt(cpu, mode, operand);
+    break;
+  case OPCODE_JSR:
+    op_jsr(cpu, mode, operand);
+    break;
+  case OPCODE_RTS:
+    op_rts(cpu, mode, operand);
+    break;
+  case OPCODE_JMP:
+    op_jmp(cpu, mode, operand);
+    break;
+  case OPCODE_MOVE:
+    op_move(cpu, mode, operand);
+    break;
+  case OPCODE_FILL:
+    op_fill(cpu, mode, operand);
+    break;
+  }
+}
+_Static_assert(OPCODE_COUNT == OPCODE_FILL + 1,
+               "dispatch_execute misses an opcode");
+
+// cpu_step through dispatch_execute (same decode and checks)
+static inline __attribute__((always_inline)) int dispatch_step(CPU *cpu) {
+  uint8_t opcode = cpu->memory[cpu->PC++];
+
+  if (UNLIKELY(opcode >= OPCODE_COUNT)) {
+    cpu->flags |= FLAG_HALTED;
+    return CPU_HALTED;
+  }
+  uint8_t mode = cpu->memory[cpu->PC++];
+  uint8_t operand = cpu->memory[cpu->PC++];
+
+  if (UNLIKELY(mode >= (opcode == OPCODE_B ? COND_COUNT : MODE_COUNT))) {
+    cpu->flags |= FLAG_HALTED;
+    return CPU_HALTED;
+  }
+  dispatch_execute(cpu, opcode, mode, operand);
+  return (cpu->flags & FLAG_HALTED) ? CPU_HALTED : CPU_OK;
+}
+
+// cpu_step_packed through dispatch_execute (same decode and checks)
+static inline __attribute__((always_inline)) int
+dispatch_step_packed(CPU *cpu) {
+  uint8_t packed = cpu->memory[cpu->PC++];
+  uint8_t opcode = UNPACK_OPCODE(packed);
+  uint8_t mode = UNPACK_MODE(packed);
+
+  if (UNLIKELY(opcode >= OPCODE_COUNT ||
+               mode >= (opcode == OPCODE_B ? COND_COUNT : MODE_COUNT))) {
+    cpu->flags |= FLAG_HALTED;
+    return CPU_HALTED;
+  }
+  uint8_t operand = cpu->memory[cpu->PC++];
+  dispatch_execute(cpu, opcode, mode, operand);
+  return (cpu->flags & FLAG_HALTED) ? CPU_HALTED : CPU_OK;
+}
+
+/* One set of run loops per ISA level. Everything they call is inlined
+   (flatten, for the helpers the handlers use) and compiled for the level of
+   the wrapper: dispatch_step and dispatch_step_packed with the instruction
+   bodies, and cpu_run_fast. */
+#define DISPATCH_VARIANT(suffix, attributes)                                   \
+  attributes __attribute__((flatten)) static int run_step_##suffix(            \
+      CPU *cpu, uint64_t max_steps, uint64_t *retired) {                       \
+    uint64_t n = 0;                                                            \
+    int status = CPU_OK;                                                       \
+    while (n < max_steps) {                                                    \
+      status = dispatch_step(cpu);                                             \
+      n++;                                                                     \
+      if (status != CPU_OK)                                                    \
+        break;                                                                 \
+    }                                                                          \
+    if (retired)                                                               \
+      *retired = n;                                                            \
+    return status;                                                             \
+  }                                                                            \
+  attributes __attribute__((flatten)) static int run_packed_##suffix(          \
+      CPU *cpu, uint64_t max_steps, uint64_t *retired) {                       \
+    uint64_t n = 0;                                                            \
+    int status = CPU_OK;                                                       \
+    while (n < max_steps) {                                                    \
+      status = dispatch_step_packed(cpu);                                      \
+      n++;                                                                     \
+      if (status != CPU_OK)                                                    \
+        break;                                                                 \
+    }                                                                          \
+    if (retired)                                                               \
+      *retired = n;                                                            \
+    return status;                                                             \
+  }                                                                            \
+  attributes static int run_fast_##suffix(CPU *cpu, uint64_t max_steps,        \
+                                          uint64_t *retired) {                 \
+    return cpu_run_fast(cpu, max_steps, retired);                              \
+  }
+
+DISPATCH_VARIANT(baseline, )
+#ifdef DISPATCH_X86
+DISPATCH_VARIANT(avx2, __attribute__((target("avx2,bmi,bmi2,popcnt"))))
+DISPATCH_VARIANT(avx512,
+                 __attribute__((target("avx512f,avx512bw,avx512vl,avx2,"
+                                       "bmi,bmi2,popcnt"))))
+#endif
+
+static const CPUEngines engines[CPU_ISA_COUNT] = {
+    {CPU_ISA_BASELINE, "baseline", run_step_baseline, run_packed_baseline,
+     run_fast_baseline},
+#ifdef DISPATCH_X86
+    {CPU_ISA_AVX2, "avx2", run_step_avx2, run_packed_avx2, run_fast_avx2},
+    {CPU_ISA_AVX512, "avx512", run_step_avx512, run_packed_avx512,
+     run_fast_avx512},
+#endif
+};
+
+int cpu_isa_supported(CPUIsa isa) {
+  switch (isa) {
+  case CPU_ISA_BASELINE:
+    return 1;
+#ifdef DISPATCH_X86
+  case CPU_ISA_AVX2:
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("bmi2");
+  case CPU_ISA_AVX512:
+    __builtin_cpu_init();
+    return cpu_isa_supported(CPU_ISA_AVX2) &&
+           __builtin_cpu_supports("avx512f") &&
+           __builtin_cpu_supports("avx512bw") &&
+           __builtin_cpu_supports("avx512vl");
+#endif
+  default:
+    return 0;
+  }
+}
+
+const CPUEngines *cpu_engines_isa(CPUIsa isa) {
+  if ((unsigned)isa >= CPU_ISA_COUNT || !engines[isa].run_step ||
+      !cpu_isa_supported(isa))
+    return NULL;
+  return &engines[isa];
+}
+
+const CPUEngines *cpu_engines(void) {
+  static const CPUEngines *selected;
+
+  if (selected)
+    return selected;
+
+  // Best supported level, capped by VM8_ISA
+  int cap = CPU_ISA_COUNT - 1;
+  const char *pin = getenv("VM8_ISA");
+  for (int isa = 0; pin && isa < CPU_ISA_COUNT; isa++)
+    if (engines[isa].name && strcmp(pin, engines[isa].name) == 0)
+      cap = isa;
+  for (int isa = cap; isa >= 0 && !selected; isa--)
+    selected = cpu_engines_isa((CPUIsa)isa);
+  return selected;
+}
@@ -0,0 +1,55 @@
+#ifndef CPU_DISPATCH_H
+#define CPU_DISPATCH_H
+
+#include "cpu.h"
+
+/*
+ * Engines compiled for several ISA levels, chosen at startup.
+ *
+ * cpu_dispatch.c builds the run loops of cpu_step, cpu_step_packed and
+ * cpu_run_fast once per level (baseline, AVX2, AVX-512) with target
+ * attributes, instruction bodies included (the step loops call the handlers
+ * from a switch, not through the baseline handlers[] table), so a binary
+ * built for the baseline (make ARCH=portable) still runs the wider variant
+ * on hosts that have it. cpu_engines() picks the best
+ * level the host supports (__builtin_cpu_supports) on first call; VM8_ISA in
+ * the environment (baseline, avx2, avx512) pins a lower one.
+ *
+ * Non-x86 hosts only have the baseline.
+ */
+
+typedef enum {
+  CPU_ISA_BASELINE = 0x00,
+  CPU_ISA_AVX2,
+  CPU_ISA_AVX512,
+  CPU_ISA_COUNT,
+} CPUIsa;
+
+/* Same contract as cpu_run_fast: run up to max_steps instructions
+   (UINT64_MAX = until halt), CPU_OK when the budget ran out, else the status
+   the engine stopped on. retired (may be NULL) counts the stopping one. */
+typedef int (*cpu_run_fn)(CPU *cpu, uint64_t max_steps, uint64_t *retired);
+
+typedef struct {
+  CPUIsa isa;
+  const char *name;      // "baseline", "avx2", "avx512"
+  cpu_run_fn run_step;   // cpu_step loop
+  cpu_run_fn run_packed; // cpu_step_packed loop (packed images)
+  cpu_run_fn run_fast;   // cpu_run_fast
+} CPUEngines;
+
+/* Whether the host can run the isa variant */
+int cpu_isa_supported(CPUIsa isa);
+
+/* Engines of one variant, NULL if the host cannot run it */
+const CPUEngines *cpu_engines_isa(CPUIsa isa);
+
+/* Best variant for the host (resolved once). This is not a speedup: the
+   engines are scalar byte code, and the ISA VARIANTS benchmark measures the
+   three variants within run-to-run noise of each other, in native and
+   ARCH=portable builds alike (run_fast 158-191 MIPS on an AVX-512 host,
+   with no consistent order). Picking the widest one costs nothing, and
+   the dispatch keeps a portable binary on par with a native build. */
+const CPUEngines *cpu_engines(void);
+
+#endif // CPU_DISPATCH_H
@@ -0,0 +1,268 @@
+#ifndef CPU_FLEET_H
+#define CPU_FLEET_H
+
+#include "cpu_verify.h"
+
+/*
+ * Fleet layout: dense storage for many guests running the same program.
+ *
+ * A CPU is sizeof(CPU) bytes: 5 register bytes + 256 bytes of memory, padded
+ * to a multiple of the 64-byte alignment (320 with this layout). A fleet
+ * splits it in three parts:
+ *   - regs: one 5-byte CPURegs per instance, contiguous, so a pass over all
+ *     registers (scheduling, halt scan) touches 5 bytes per guest;
+ *   - code: memory [0, split), a read-only CPUImage shared by every instance
+ *     (and by other fleets running the same program);
+ *   - data: memory [split, 256) per instance, packed back to back in a slab.
+ * With split = 0xF0 (the code area of the default memory map) an instance
+ * costs 5 + 16 bytes instead of sizeof(CPU). split = 0 shares nothing.
+ *
+ * Guests do not run in place: cpu_fleet_load materialises an instance into a
+ * scratch CPU, any engine runs on it, and cpu_fleet_store writes it back.
+ * A guest that wrote into its code region gets a private copy of the image
+ * on store (copy-on-write); the other instances keep the shared one.
+ */
+
+/* Store/run return code: copy-on-write could not allocate the private image
+   (CPU_OK, CPU_HALTED and CPU_BREAK are -2..0) */
+#define CPU_FLEET_NOMEM -3
+
+// ============================================================================
+// SHARED CODE IMAGE
+// ============================================================================
+
+/* Read-only code region with the analysis shared by all its users. The
+   verification (step engine choice) is computed once, on first use. */
+typedef struct {
+  unsigned refs;        // Fleets and instances referencing the image
+  unsigned split;       // Size of the code region
+  int verified;         // verify holds a result
+  uint8_t entry_sp;     // SP of the verified guest
+  CPUVerifyInfo verify; // Cached cpu_verify result
+  cpu_step_fn step;     // Engine selected from verify
+  uint8_t code[];       // split bytes
+} CPUImage;
+
+/* Create an image from the first split bytes of code (refs = 1) */
+static inline CPUImage *cpu_image_create(const uint8_t *code, unsigned split) {
+  if (split > MAX_MEMORY_SIZE)
+    return NULL;
+
+  CPUImage *image = calloc(1, sizeof(CPUImage) + split);
+  if (!image)
+    return NULL;
+  image->refs = 1;
+  image->split = split;
+  if (code)
+    __builtin_memcpy(image->code, code, split);
+  return image;
+}
+
+static inline CPUImage *cpu_image_retain(CPUImage *image) {
+  image->refs++;
+  return image;
+}
+
+static inline void cpu_image_release(CPUImage *image) {
+  if (image && --image->refs == 0)
+    free(image);
+}
+
+/* Step engine for a guest on this image. The cached verification only
+   depends on the code when every reachable instruction and every JMP [$a]
+   pointer lies in the image and the guest starts where the verified one
+   did; other guests get the checked cpu_step. */
+static inline cpu_step_fn cpu_image_step(CPUImage *image, const CPU *cpu) {
+  if (!image->verified) {
+    cpu_verify(cpu, &image->verify);
+    image->entry_sp = cpu->SP;
+    image->step = cpu_select_step(&image->verify);
+    for (unsigned i = image->split; i < MAX_MEMORY_SIZE; i++)
+      if (bitmap_test(&image->verify.code, (uint8_t)i) ||
+          bitmap_test(&image->verify.pointers, (uint8_t)i))
+        image->step = cpu_step; // Code or jump targets per instance
+    image->verified = 1;
+  }
+  if (cpu->PC != image->verify.entry || cpu->SP != image->entry_sp)
+    return cpu_step;
+  return image->step;
+}
+
+// ============================================================================
+// FLEET API
+// ============================================================================
+
+// Guest registers, without memory
+typedef struct {
+  uint8_t A;     // Accumulator
+  uint8_t X;     // Index register
+  uint8_t PC;    // Program Counter
+  uint8_t SP;    // Stack Pointer
+  uint8_t flags; // Status flags
+} CPURegs;
+_Static_assert(sizeof(CPURegs) == 5, "CPURegs must stay packed");
+
+typedef struct {
+  size_t count;      // Number of instances
+  unsigned split;    // Memory [0, split) is shared, [split, 256) per instance
+  unsigned stride;   // Per-instance data bytes (MAX_MEMORY_SIZE - split)
+  CPURegs *regs;     // count register blocks
+  CPUImage *image;   // Shared code image
+  CPUImage **cow;    // Private images after copy-on-write (NULL until the
+                     // first one, then count entries, NULL = shared)
+  uint8_t *data;     // count * stride bytes
+} CPUFleet;
+
+static inline void cpu_fleet_free(CPUFleet *fleet) {
+  if (fleet->cow) {
+    for (size_t i = 0; i < fleet->count; i++)
+      cpu_image_release(fleet->cow[i]);
+    free(fleet->cow);
+  }
+  cpu_image_release(fleet->image);
+  free(fleet->regs);
+  free(fleet->data);
+  __builtin_memset(fleet, 0, sizeof(CPUFleet));
+}
+
+/* Allocate count instances sharing image (retained), all reset (initCPU
+   state, zeroed data). Returns 0, or -1 on allocation failure. */
+static inline int cpu_fleet_init_shared(CPUFleet *fleet, size_t count,
+                                        CPUImage *image) {
+  __builtin_memset(fleet, 0, sizeof(CPUFleet));
+  fleet->count = count;
+  fleet->split = image->split;
+  fleet->stride = MAX_MEMORY_SIZE - image->split;
+  fleet->image = cpu_image_retain(image);
+  fleet->regs = calloc(count ? count : 1, sizeof(CPURegs));
+  fleet->data = calloc(count && fleet->stride ? count : 1,
+                       fleet->stride ? fleet->stride : 1);
+  if (!fleet->regs || !fleet->data) {
+    cpu_fleet_free(fleet);
+    return -1;
+  }
+
+  for (size_t i = 0; i < count; i++)
+    fleet->regs[i].SP = STACK_BASE;
+  return 0;
+}
+
+/* Same with a new, zeroed image of split bytes (see cpu_fleet_set_code).
+   Returns 0, or -1 on a bad split or allocation failure. */
+static inline int cpu_fleet_init(CPUFleet *fleet, size_t count,
+                                 unsigned split) {
+  CPUImage *image = cpu_image_create(NULL, split);
+  if (!image) {
+    __builtin_memset(fleet, 0, sizeof(CPUFleet));
+    return -1;
+  }
+  int result = cpu_fleet_init_shared(fleet, count, image);
+  cpu_image_release(image);
+  return result;
+}
+
+static inline CPURegs *cpu_fleet_regs(CPUFleet *fleet, size_t index) {
+  return &fleet->regs[index];
+}
+
+/* Private memory of an instance: guest address split + i is data[i] */
+static inline uint8_t *cpu_fleet_data(CPUFleet *fleet, size_t index) {
+  return fleet->data + index * fleet->stride;
+}
+
+/* Code image an instance runs: its private copy, or the shared one */
+static inline CPUImage *cpu_fleet_image(CPUFleet *fleet, size_t index) {
+  if (UNLIKELY(fleet->cow != NULL) && fleet->cow[index])
+    return fleet->cow[index];
+  return fleet->image;
+}
+
+/* Bytes of fleet storage per instance (shared code not counted) */
+static inline size_t cpu_fleet_bytes_per_instance(const CPUFleet *fleet) {
+  return sizeof(CPURegs) + fleet->stride;
+}
+
+/* Set the shared code image from the first split bytes of image. Only
+   before the fleet runs, and it changes every fleet sharing the image; the
+   cached verification is dropped. */
+static inline void cpu_fleet_set_code(CPUFleet *fleet, const uint8_t *image) {
+  __builtin_memcpy(fleet->image->code, image, fleet->split);
+  fleet->image->verified = 0;
+}
+
+/* Materialise instance index into a scratch CPU */
+static inline void cpu_fleet_load(CPUFleet *fleet, size_t index, CPU *cpu) {
+  const CPURegs *regs = &fleet->regs[index];
+
+  cpu->A = regs->A;
+  cpu->X = regs->X;
+  cpu->PC = regs->PC;
+  cpu->SP = regs->SP;
+  cpu->flags = regs->flags;
+  __builtin_memcpy(cpu->memory, cpu_fleet_image(fleet, index)->code,
+                   fleet->split);
+  __builtin_memcpy(cpu->memory + fleet->split, cpu_fleet_data(fleet, index),
+                   fleet->stride);
+}
+
+/* Give instance index a private copy of code (copy-on-write) */
+static inline int cpu_fleet_unshare(CPUFleet *fleet, size_t index,
+                                    const uint8_t *code) {
+  if (!fleet->cow) {
+    fleet->cow = calloc(fleet->count, sizeof(CPUImage *));
+    if (!fleet->cow)
+      return CPU_FLEET_NOMEM;
+  }
+
+  CPUImage *image = fleet->cow[index];
+  if (image && image->refs == 1) {
+    __builtin_memcpy(image->code, code, fleet->split); // Already private
+    image->verified = 0;
+    return CPU_OK;
+  }
+
+  image = cpu_image_create(code, fleet->split);
+  if (!image)
+    return CPU_FLEET_NOMEM;
+  cpu_image_release(fleet->cow[index]);
+  fleet->cow[index] = image;
+  return CPU_OK;
+}
+
+/* Write a CPU back into instance index. A code region that differs from the
+   instance's image is copied into a private image for this instance only.
+   Returns CPU_OK, or CPU_FLEET_NOMEM (and stores nothing). */
+static inline int cpu_fleet_store(CPUFleet *fleet, size_t index,
+                                  const CPU *cpu) {
+  const CPUImage *image = cpu_fleet_image(fleet, index);
+  if (UNLIKELY(__builtin_memcmp(cpu->memory, image->code, fleet->split) != 0)) {
+    if (cpu_fleet_unshare(fleet, index, cpu->memory) != CPU_OK)
+      return CPU_FLEET_NOMEM;
+  }
+
+  CPURegs *regs = &fleet->regs[index];
+  regs->A = cpu->A;
+  regs->X = cpu->X;
+  regs->PC = cpu->PC;
+  regs->SP = cpu->SP;
+  regs->flags = cpu->flags;
+  __builtin_memcpy(cpu_fleet_data(fleet, index), cpu->memory + fleet->split,
+                   fleet->stride);
+  return CPU_OK;
+}
+
+/* Run instance index for up to max_steps instructions with cpu_run_fast,
+   using scratch as working storage. Verified guests run on it too: the
+   register-cached loop beats a cpu_step_unchecked loop even without the
+   stack checks. Returns the cpu_run_fast result, or CPU_FLEET_NOMEM
+   (instance left unchanged). */
+static inline int cpu_fleet_run(CPUFleet *fleet, size_t index, CPU *scratch,
+                                uint64_t max_steps, uint64_t *retired) {
+  cpu_fleet_load(fleet, index, scratch);
+  int result = cpu_run_fast(scratch, max_steps, retired);
+  if (cpu_fleet_store(fleet, index, scratch) != CPU_OK)
+    return CPU_FLEET_NOMEM;
+  return result;
+}
+
+#endif // CPU_FLEET_H
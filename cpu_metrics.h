@@ -0,0 +1,269 @@
+#ifndef CPU_METRICS_H
+#define CPU_METRICS_H
+
+#include "cpu_block.h"
+
+/*
+ * Runtime metrics in the Prometheus text format.
+ *
+ * Each thread running guests owns one CPUMetrics block and is its only
+ * writer; there are no locks and no shared cache lines between writers.
+ * Nothing is counted inside the engines: the thread records a run after it
+ * returns (cpu_metrics_run: retired instructions, and the halt reason when
+ * it halted) and moves the counters the block cache already keeps
+ * (CPUBlockCache) into its block now and then with
+ * cpu_metrics_drain_blocks. Fields are written with relaxed atomic
+ * stores, which compile to plain stores, so a reader never sees a torn
+ * value.
+ *
+ * Blocks are registered in a CPUMetricsRegistry. cpu_metrics_aggregate sums
+ * them on demand, from any thread; cpu_metrics_write prints the sum, and
+ * cpu_metrics_export replaces a file with it atomically (write then
+ * rename), e.g. for the node_exporter textfile collector.
+ *
+ * Halt reasons are recovered from the halted CPU. The engines running the
+ * 3-byte format (cpu_step, cpu_run_fast, the tail-call, block and debug
+ * engines) leave PC one byte past an undefined opcode and three bytes past
+ * any other halting instruction (state unchanged otherwise): a HALT, a
+ * condition out of range or a mode the opcode is not defined for, or a
+ * stack operation that does not fit SP. Engines skipping the checks
+ * (verified images) only halt on HALT. The instruction three bytes back
+ * wins, so a jump onto an undefined byte that ends a HALT or an invalid
+ * instruction is reported as that one. The packed formats are not
+ * covered: an instruction is 2 bytes there (1 or 2 in packed v2), so PC
+ * does not say where the halting one started, and cpu_metrics_run is for
+ * the 3-byte engines only.
+ */
+
+#ifndef VM8_METRICS_THREADS
+#define VM8_METRICS_THREADS 64
+#endif
+
+// Halt reasons
+enum {
+  CPU_HALT_INSTRUCTION = 0x00, // HALT executed
+  CPU_HALT_ILLEGAL_OPCODE,     // Undefined opcode
+  CPU_HALT_ILLEGAL_MODE,       // Addressing mode or branch condition
+  CPU_HALT_STACK_OVERFLOW,     // PUSH or JSR on a full stack
+  CPU_HALT_STACK_UNDERFLOW,    // POP or RTS on an empty stack
+  CPU_HALT_OTHER,              // FLAG_HALTED set by the embedder
+
+  CPU_HALT_REASONS // Number of halt reasons (DON'T REMOVE)
+};
+
+// Caches with counters
+enum {
+  CPU_CACHE_BLOCK = 0x00, // Translated blocks (a miss is a translation)
+
+  CPU_CACHE_COUNT // Number of caches (DON'T REMOVE)
+};
+
+typedef struct __attribute__((aligned(64))) {
+  uint64_t retired;                  // Instructions retired
+  uint64_t runs;                     // Engine calls recorded
+  uint64_t halts[CPU_HALT_REASONS];  // Halts by reason
+  uint64_t hits[CPU_CACHE_COUNT];    // Cache hits
+  uint64_t misses[CPU_CACHE_COUNT];  // Cache misses
+  uint64_t invalidations[CPU_CACHE_COUNT]; // Entries dropped
+} CPUMetrics;
+
+typedef struct {
+  CPUMetrics *thread[VM8_METRICS_THREADS]; // Registered blocks
+  uint32_t count;                          // Slots taken
+} CPUMetricsRegistry;
+
+// ============================================================================
+// HALT REASONS
+// ============================================================================
+
+/* Reason a halted CPU stopped, 3-byte format only (see the header comment
+   for the PC rules) */
+static inline int cpu_halt_reason(const CPU *cpu) {
+  const uint8_t *memory = cpu->memory;
+  uint8_t start = (uint8_t)(cpu->PC - 3);
+  uint8_t opcode = memory[start];
+  uint8_t mode = memory[(uint8_t)(start + 1)];
+  uint8_t operand = memory[(uint8_t)(start + 2)];
+
+  if (!(cpu->flags & FLAG_HALTED))
+    return CPU_HALT_OTHER;
+  if (opcode < OPCODE_COUNT) {
+    if (!instruction_runs(opcode, mode))
+      return CPU_HALT_ILLEGAL_MODE;
+    switch (opcode) {
+    case OPCODE_HALT:
+      return CPU_HALT_INSTRUCTION;
+    case OPCODE_PUSH:
+      if (!stack_can_push(cpu->SP, stack_count(mode, operand)))
+        return CPU_HALT_STACK_OVERFLOW;
+      break;
+    case OPCODE_JSR:
+      if (!stack_can_push(cpu->SP, 1))
+        return CPU_HALT_STACK_OVERFLOW;
+      break;
+    case OPCODE_POP:
+      if (!stack_can_pop(cpu->SP, stack_count(mode, operand)))
+        return CPU_HALT_STACK_UNDERFLOW;
+      break;
+    case OPCODE_RTS:
+      if (!stack_can_pop(cpu->SP, 1))
+        return CPU_HALT_STACK_UNDERFLOW;
+      break;
+    }
+  }
+  // Not a halt three bytes back: an undefined opcode right before PC
+  if (memory[(uint8_t)(cpu->PC - 1)] >= OPCODE_COUNT)
+    return CPU_HALT_ILLEGAL_OPCODE;
+  return CPU_HALT_OTHER;
+}
+
+// ============================================================================
+// WRITER SIDE (owning thread)
+// ============================================================================
+
+#define METRIC_ADD(field, n)                                                   \
+  __atomic_store_n(&(field), (field) + (n), __ATOMIC_RELAXED)
+
+static inline void cpu_metrics_reset(CPUMetrics *metrics) {
+  __builtin_memset(metrics, 0, sizeof(CPUMetrics));
+}
+
+/* Account one call of a 3-byte engine that returned `status` after
+   `retired` steps */
+static inline void cpu_metrics_run(CPUMetrics *metrics, const CPU *cpu,
+                                   int status, uint64_t retired) {
+  METRIC_ADD(metrics->retired, retired);
+  METRIC_ADD(metrics->runs, 1);
+  if (UNLIKELY(status == CPU_HALTED && retired))
+    METRIC_ADD(metrics->halts[cpu_halt_reason(cpu)], 1);
+}
+
+static inline void cpu_metrics_add_cache(CPUMetrics *metrics, int cache,
+                                         uint64_t hits, uint64_t misses,
+                                         uint64_t invalidations) {
+  METRIC_ADD(metrics->hits[cache], hits);
+  METRIC_ADD(metrics->misses[cache], misses);
+  METRIC_ADD(metrics->invalidations[cache], invalidations);
+}
+
+// Move the engine-side counters into the block (they restart from zero)
+static inline void cpu_metrics_drain_blocks(CPUMetrics *metrics,
+                                            CPUBlockCache *cache) {
+  cpu_metrics_add_cache(metrics, CPU_CACHE_BLOCK, cache->hits,
+                        cache->translations, cache->invalidations);
+  cache->hits = cache->translations = cache->invalidations = 0;
+}
+
+// ============================================================================
+// READER SIDE (any thread)
+// ============================================================================
+
+static inline void cpu_metrics_registry_init(CPUMetricsRegistry *registry) {
+  __builtin_memset(registry, 0, sizeof(CPUMetricsRegistry));
+}
+
+/* Publish a thread's block. Returns its slot, -1 when the registry is full.
+   The block must outlive the registry's readers. */
+static inline int cpu_metrics_register(CPUMetricsRegistry *registry,
+                                       CPUMetrics *metrics) {
+  uint32_t slot = __atomic_fetch_add(&registry->count, 1, __ATOMIC_RELAXED);
+  if (slot >= VM8_METRICS_THREADS) {
+    __atomic_fetch_sub(&registry->count, 1, __ATOMIC_RELAXED);
+    return -1;
+  }
+  __atomic_store_n(&registry->thread[slot], metrics, __ATOMIC_RELEASE);
+  return (int)slot;
+}
+
+// Sum of all registered blocks (each field read once, no locking)
+static inline void cpu_metrics_aggregate(CPUMetricsRegistry *registry,
+                                         CPUMetrics *total) {
+  cpu_metrics_reset(total);
+  for (uint32_t t = 0; t < VM8_METRICS_THREADS; t++) {
+    CPUMetrics *metrics =
+        __atomic_load_n(&registry->thread[t], __ATOMIC_ACQUIRE);
+    if (!metrics)
+      continue;
+    const uint64_t *src = (const uint64_t *)metrics;
+    uint64_t *dst = (uint64_t *)total;
+    for (size_t i = 0; i < sizeof(CPUMetrics) / sizeof(uint64_t); i++)
+      dst[i] += __atomic_load_n(&src[i], __ATOMIC_RELAXED);
+  }
+}
+
+static const char *const halt_reason_names[CPU_HALT_REASONS] = {
+    [CPU_HALT_INSTRUCTION] = "halt",
+    [CPU_HALT_ILLEGAL_OPCODE] = "illegal_opcode",
+    [CPU_HALT_ILLEGAL_MODE] = "illegal_mode",
+    [CPU_HALT_STACK_OVERFLOW] = "stack_overflow",
+    [CPU_HALT_STACK_UNDERFLOW] = "stack_underflow",
+    [CPU_HALT_OTHER] = "other",
+};
+
+static const char *const cache_names[CPU_CACHE_COUNT] = {
+    [CPU_CACHE_BLOCK] = "block",
+};
+
+static inline int metrics_counter(FILE *out, const char *name,
+                                  const char *help) {
+  return fprintf(out, "# HELP %s %s\n# TYPE %s counter\n", name, help, name);
+}
+
+/* Text exposition format of `total`. Returns 0, -1 on a write error. */
+static inline int cpu_metrics_write(const CPUMetrics *total, FILE *out) {
+  int err = 0;
+  err |= metrics_counter(out, "vm8_instructions_retired_total",
+                         "Guest instructions retired.") < 0;
+  err |= fprintf(out, "vm8_instructions_retired_total %llu\n",
+                 (unsigned long long)total->retired) < 0;
+  err |= metrics_counter(out, "vm8_runs_total", "Engine calls recorded.") < 0;
+  err |= fprintf(out, "vm8_runs_total %llu\n",
+                 (unsigned long long)total->runs) < 0;
+
+  err |= metrics_counter(out, "vm8_halts_total", "Guest halts by reason.") < 0;
+  for (int r = 0; r < CPU_HALT_REASONS; r++)
+    err |= fprintf(out, "vm8_halts_total{reason=\"%s\"} %llu\n",
+                   halt_reason_names[r],
+                   (unsigned long long)total->halts[r]) < 0;
+
+  static const char *const series[3][2] = {
+      {"vm8_cache_hits_total", "Cache hits."},
+      {"vm8_cache_misses_total", "Cache misses."},
+      {"vm8_cache_invalidations_total", "Cache entries invalidated."},
+  };
+  const uint64_t *values[3] = {total->hits, total->misses,
+                               total->invalidations};
+  for (int s = 0; s < 3; s++) {
+    err |= metrics_counter(out, series[s][0], series[s][1]) < 0;
+    for (int c = 0; c < CPU_CACHE_COUNT; c++)
+      err |= fprintf(out, "%s{cache=\"%s\"} %llu\n", series[s][0],
+                     cache_names[c], (unsigned long long)values[s][c]) < 0;
+  }
+  return err ? -1 : 0;
+}
+
+/* Aggregate and replace `path` with the result: written to `path`.tmp then
+   renamed, so a scraper never reads a partial file. Returns 0, -1 on error
+   (errno set). */
+static inline int cpu_metrics_export(CPUMetricsRegistry *registry,
+                                     const char *path) {
+  CPUMetrics total;
+  char tmp[4096];
+
+  if (snprintf(tmp, sizeof(tmp), "%s.tmp", path) >= (int)sizeof(tmp))
+    return -1;
+  cpu_metrics_aggregate(registry, &total);
+  FILE *out = fopen(tmp, "w");
+  if (!out)
+    return -1;
+  int err = cpu_metrics_write(&total, out);
+  if (fclose(out) != 0)
+    err = -1;
+  if (err || rename(tmp, path) != 0) {
+    remove(tmp);
+    return -1;
+  }
+  return 0;
+}
+
+#endif // CPU_METRICS_H
@@ -0,0 +1,95 @@
+#ifndef CPU_PACK_H
+#define CPU_PACK_H
+
+#include "cpu.h"
+
+/*
+ * Code converters to the packed v2 encoding (cpu_step_packed_v2).
+ *
+ * Instructions keep their order; only their sizes change, so every code
+ * address is relocated: B and JSR targets and JMP absolute targets that
+ * fall inside the converted range must be instruction starts and are mapped
+ * to their new address. Targets outside the range are kept as they are.
+ * Computed jumps (JMP $a,X / [$a] / [$a,X]) go through tables the
+ * converter cannot see, so code using them is rejected, as is code that
+ * does not decode (trailing partial instruction, opcode or mode outside
+ * the packed byte).
+ */
+
+typedef enum {
+  CPU_FORMAT_WIDE = 0x00, // opcode, mode, operand (cpu_step)
+  CPU_FORMAT_PACKED,      // packed byte, operand (cpu_step_packed)
+  CPU_FORMAT_PACKED_V2,   // packed byte [, operand] (cpu_step_packed_v2)
+} CPUFormat;
+
+/* Instruction at src[pc] in format, length returned (0 if it does not fit
+   in len bytes or cannot be packed) */
+static inline unsigned cpu_pack_decode(const uint8_t *src, unsigned len,
+                                       unsigned pc, CPUFormat format,
+                                       uint8_t *opcode, uint8_t *mode,
+                                       uint8_t *operand) {
+  unsigned size;
+
+  if (format == CPU_FORMAT_WIDE) {
+    if (pc + 3 > len || src[pc] >= OPCODE_COUNT || src[pc + 1] > 7)
+      return 0;
+    *opcode = src[pc];
+    *mode = src[pc + 1];
+    *operand = src[pc + 2];
+    return 3;
+  }
+
+  *opcode = UNPACK_OPCODE(src[pc]);
+  *mode = UNPACK_MODE(src[pc]);
+  size = format == CPU_FORMAT_PACKED ? 2 : packed_v2_length(src[pc]);
+  if (pc + size > len || *opcode >= OPCODE_COUNT)
+    return 0;
+  *operand = size == 2 ? src[pc + 1] : 0;
+  return size;
+}
+
+/* Convert len bytes of code in format from src to packed v2 in dst (cap
+   bytes; dst must not overlap src). Returns the v2 size, or -1 if the code
+   cannot be converted or does not fit. */
+static inline int cpu_pack_v2(const uint8_t *src, unsigned len,
+                              CPUFormat format, uint8_t *dst, unsigned cap) {
+  uint8_t address[MAX_MEMORY_SIZE]; // New address of each instruction start
+  uint8_t start[MAX_MEMORY_SIZE] = {0};
+  uint8_t opcode, mode, operand;
+  unsigned size = 0;
+
+  if (len > MAX_MEMORY_SIZE)
+    return -1;
+
+  // Pass 1: layout
+  for (unsigned pc = 0, n; pc < len; pc += n) {
+    n = cpu_pack_decode(src, len, pc, format, &opcode, &mode, &operand);
+    if (n == 0 || (opcode == OPCODE_JMP && mode != MODE_ABSOLUTE))
+      return -1;
+    start[pc] = 1;
+    address[pc] = (uint8_t)size;
+    size += packed_v2_length(PACK_INST_BYTE(opcode, mode));
+  }
+  if (size > cap)
+    return -1;
+
+  // Pass 2: emit, relocating code addresses
+  unsigned out = 0;
+  for (unsigned pc = 0, n; pc < len; pc += n) {
+    n = cpu_pack_decode(src, len, pc, format, &opcode, &mode, &operand);
+    uint8_t packed = PACK_INST_BYTE(opcode, mode);
+
+    if ((opcode == OPCODE_B || opcode == OPCODE_JSR || opcode == OPCODE_JMP) &&
+        operand < len) {
+      if (!start[operand])
+        return -1; // Target inside an instruction
+      operand = address[operand];
+    }
+    dst[out++] = packed;
+    if (packed_v2_length(packed) == 2)
+      dst[out++] = operand;
+  }
+  return (int)out;
+}
+
+#endif // CPU_PACK_H
@@ -0,0 +1,210 @@
+#ifndef CPU_PROFILE_H
+#define CPU_PROFILE_H
+
+#include "cpu.h"
+
+/*
+ * Sampling profiler (3-byte format).
+ *
+ * cpu_run_profiled runs cpu_run_fast in slices of about `period` retired
+ * instructions and takes one sample at the end of each: the guest PC and a
+ * shallow call stack. The guest runs at full cpu_run_fast speed between
+ * samples, so the cost is one slice boundary plus one sample per period
+ * (well under 1% from a period of a few thousand instructions). Periods are
+ * jittered by up to +/-50% around `period` so a loop whose length divides
+ * the period is not always caught at the same instruction; the jitter comes
+ * from a fixed-seed generator, so runs are reproducible.
+ *
+ * The call stack is recovered from guest memory, without tracking calls:
+ * every stack byte between SP and STACK_BASE that is the return address of
+ * a JSR (the byte 3 before it is OPCODE_JSR) is a frame, named after that
+ * JSR's target. Bytes pushed by PUSH are skipped unless they happen to look
+ * like a return address, the usual limit of frame-pointer-less unwinding.
+ * At most CPU_PROFILE_DEPTH frames are kept, the innermost ones.
+ *
+ * Samples are counted per distinct stack in a fixed open-addressed table
+ * (samples that find it full are counted in `dropped`) and per PC in
+ * `hits`. cpu_profile_write_folded exports the stacks in the folded format
+ * of flamegraph.pl: `main;sub_40;sub_60;pc_64 1234`, outermost frame first,
+ * leaf PC last; stacks cut at CPU_PROFILE_DEPTH start with `[truncated]`.
+ *
+ * Guests run by other engines (the scheduler, cpu_run_blocks...) can be
+ * sampled at their own slice ends with cpu_profile_sample.
+ */
+
+#ifndef CPU_PROFILE_DEPTH
+#define CPU_PROFILE_DEPTH 8
+#endif
+_Static_assert(CPU_PROFILE_DEPTH >= 1 && CPU_PROFILE_DEPTH <= STACK_SIZE,
+               "bad profile depth");
+
+#ifndef CPU_PROFILE_SLOTS
+#define CPU_PROFILE_SLOTS 1024
+#endif
+_Static_assert((CPU_PROFILE_SLOTS & (CPU_PROFILE_SLOTS - 1)) == 0,
+               "CPU_PROFILE_SLOTS must be a power of two");
+
+// Default sampling period (retired instructions)
+#define CPU_PROFILE_PERIOD 10007
+
+// One distinct sampled stack; count == 0 marks a free slot
+typedef struct {
+  uint64_t count;                   // Samples of this stack
+  uint8_t pc;                       // Leaf: instruction about to run
+  uint8_t depth;                    // Frames used
+  uint8_t truncated;                // Outer frames were cut
+  uint8_t frame[CPU_PROFILE_DEPTH]; // Subroutine entries, innermost first
+} CPUProfileStack;
+
+// Bytes identifying a stack: pc through frame[], padding excluded
+#define PROFILE_KEY_SIZE                                                       \
+  (__builtin_offsetof(CPUProfileStack, frame) + CPU_PROFILE_DEPTH -            \
+   __builtin_offsetof(CPUProfileStack, pc))
+
+typedef struct {
+  uint64_t period;    // Mean instructions between samples
+  uint64_t countdown; // Instructions left before the next sample
+  uint32_t seed;      // Period jitter state
+  uint32_t stacks;    // Slots in use
+  uint64_t samples;   // Samples taken
+  uint64_t dropped;   // Samples lost to a full stack table
+  uint64_t hits[MAX_MEMORY_SIZE];            // Samples per PC
+  CPUProfileStack stack[CPU_PROFILE_SLOTS]; // Distinct stacks
+} CPUProfile;
+
+// ============================================================================
+// PROFILE API
+// ============================================================================
+
+// Next slice length: uniform in [period/2, period*3/2]
+static inline uint64_t profile_next_period(CPUProfile *prof) {
+  uint32_t s = prof->seed;
+  s ^= s << 13;
+  s ^= s >> 17;
+  s ^= s << 5;
+  prof->seed = s;
+  uint64_t half = prof->period / 2;
+  return prof->period - half + (half ? s % (2 * half + 1) : 0);
+}
+
+static inline void cpu_profile_reset(CPUProfile *prof, uint64_t period) {
+  __builtin_memset(prof, 0, sizeof(CPUProfile));
+  prof->period = period ? period : 1;
+  prof->seed = 0x9E3779B9u;
+  prof->countdown = profile_next_period(prof);
+}
+
+static inline CPUProfile *cpu_profile_create(uint64_t period) {
+  CPUProfile *prof = malloc(sizeof(CPUProfile));
+  if (prof)
+    cpu_profile_reset(prof, period);
+  return prof;
+}
+
+static inline void cpu_profile_destroy(CPUProfile *prof) {
+  free(prof);
+}
+
+// Walk the guest stack: JSR return addresses, innermost first
+static inline void profile_unwind(const CPU *cpu, CPUProfileStack *key) {
+  for (unsigned sp = (unsigned)cpu->SP + 1; sp <= STACK_BASE; sp++) {
+    uint8_t ret = cpu->memory[sp];
+    if (cpu->memory[(uint8_t)(ret - 3)] != OPCODE_JSR)
+      continue;
+    if (key->depth == CPU_PROFILE_DEPTH) {
+      key->truncated = 1;
+      break;
+    }
+    key->frame[key->depth++] = cpu->memory[(uint8_t)(ret - 1)];
+  }
+}
+
+static inline uint32_t profile_hash(const CPUProfileStack *key) {
+  uint32_t h = 2166136261u;
+  const uint8_t *bytes = &key->pc;
+  for (size_t i = 0; i < PROFILE_KEY_SIZE; i++)
+    h = (h ^ bytes[i]) * 16777619u;
+  return h;
+}
+
+// Record the current PC and call stack as one sample
+static inline void cpu_profile_sample(CPUProfile *prof, const CPU *cpu) {
+  CPUProfileStack key;
+  __builtin_memset(&key, 0, sizeof(key));
+  key.pc = cpu->PC;
+  profile_unwind(cpu, &key);
+
+  prof->samples++;
+  prof->hits[key.pc]++;
+  uint32_t slot = profile_hash(&key) & (CPU_PROFILE_SLOTS - 1);
+  for (uint32_t probe = 0; probe < CPU_PROFILE_SLOTS; probe++) {
+    CPUProfileStack *entry = &prof->stack[slot];
+    if (!entry->count) {
+      key.count = 1;
+      *entry = key;
+      prof->stacks++;
+      return;
+    }
+    if (!__builtin_memcmp(&entry->pc, &key.pc, PROFILE_KEY_SIZE)) {
+      entry->count++;
+      return;
+    }
+    slot = (slot + 1) & (CPU_PROFILE_SLOTS - 1);
+  }
+  prof->dropped++;
+}
+
+/* cpu_run_fast with a sample every ~period retired instructions. Same
+   contract as cpu_run_fast; the countdown carries over between calls, so
+   a guest run in short slices is sampled at the same rate. */
+static inline int cpu_run_profiled(CPU *cpu, CPUProfile *prof,
+                                   uint64_t max_steps, uint64_t *retired) {
+  uint64_t total = 0, done;
+  int status = CPU_OK;
+
+  if (UNLIKELY(cpu->flags & FLAG_HALTED)) {
+    if (retired)
+      *retired = 0;
+    return CPU_HALTED;
+  }
+  while (total < max_steps) {
+    uint64_t slice = prof->countdown;
+    if (slice > max_steps - total)
+      slice = max_steps - total;
+    status = cpu_run_fast(cpu, slice, &done);
+    total += done;
+    prof->countdown -= done;
+    if (prof->countdown == 0) {
+      cpu_profile_sample(prof, cpu);
+      prof->countdown = profile_next_period(prof);
+    }
+    if (status != CPU_OK)
+      break;
+  }
+  if (retired)
+    *retired = total;
+  return status;
+}
+
+/* Folded stacks for flamegraph.pl, one line per distinct stack.
+   Returns the number of lines written, -1 on a write error. */
+static inline int cpu_profile_write_folded(const CPUProfile *prof,
+                                           FILE *out) {
+  int lines = 0;
+  for (uint32_t i = 0; i < CPU_PROFILE_SLOTS; i++) {
+    const CPUProfileStack *entry = &prof->stack[i];
+    if (!entry->count)
+      continue;
+    if (fputs(entry->truncated ? "[truncated]" : "main", out) == EOF)
+      return -1;
+    for (unsigned f = entry->depth; f-- > 0;)
+      fprintf(out, ";sub_%02X", entry->frame[f]);
+    if (fprintf(out, ";pc_%02X %llu\n", entry->pc,
+                (unsigned long long)entry->count) < 0)
+      return -1;
+    lines++;
+  }
+  return lines;
+}
+
+#endif // CPU_PROFILE_H
@@ -0,0 +1,229 @@
+#ifndef CPU_SCHED_H
+#define CPU_SCHED_H
+
+#include "cpu.h"
+
+/*
+ * Cooperative scheduler: many guests on one thread.
+ *
+ * Each guest runs for a time slice of `slice` retired instructions on
+ * cpu_run_fast, then goes back to the tail of its ready queue. Queues are
+ * bucketed by priority (0 = highest) and served strictly in priority order,
+ * FIFO within a bucket. Switches are batched: up to VM8_SCHED_BATCH guests
+ * are taken off a queue at once, run back to back, and the survivors are
+ * appended in one go.
+ *
+ * A guest leaves the ready queues when it:
+ *   - halts (CPU_HALTED, for good);
+ *   - is parked by the embedder (vm8_sched_park), e.g. while the device
+ *     behind an MMIO address it reads has no data; vm8_sched_wake resumes it
+ *     once the embedder has stored the value in guest memory;
+ *   - idles: its slice ends on `B AL` to itself, which can only be left by
+ *     a change the embedder makes, so it waits for vm8_sched_wake too.
+ *
+ * The scheduler never copies CPU state: guests stay where the embedder keeps
+ * them (an arena, a fleet scratch CPU...).
+ *
+ * Overhead: the SCHEDULER section of the benchmark (10000 guests, slices of
+ * 1000 instructions) measures vm8_sched_run at -6% to +2% of a bare
+ * cpu_run_fast loop over the same guests. That is run-to-run noise on the
+ * test machine, so the 1% target is not shown to be met or missed; with
+ * shorter slices the per-switch cost weighs more.
+ */
+
+#ifndef VM8_SCHED_PRIORITIES
+#define VM8_SCHED_PRIORITIES 4
+#endif
+
+#ifndef VM8_SCHED_BATCH
+#define VM8_SCHED_BATCH 32
+#endif
+
+/* Largest capacity: its queue size still fits the 32-bit free-running
+   queue indices (a full queue must not look empty) */
+#define VM8_SCHED_MAX_GUESTS (UINT32_C(1) << 31)
+
+// Guest states
+enum {
+  VM8_GUEST_READY = 0x00, // Runnable (queued)
+  VM8_GUEST_PARKED,       // Parked by the embedder
+  VM8_GUEST_IDLE,         // Spinning on a self-branch
+  VM8_GUEST_HALTED,       // Halted, never scheduled again
+};
+
+typedef struct {
+  CPU *cpu;         // Guest state (owned by the embedder)
+  uint64_t retired; // Instructions retired under the scheduler
+  uint8_t priority; // Ready queue, 0 = highest
+  uint8_t state;    // VM8_GUEST_*
+  uint8_t queued;   // In a ready queue (parked guests leave it lazily)
+} CPUGuest;
+
+// FIFO of guest ids, capacity is a power of two >= number of guests
+typedef struct {
+  uint32_t *ids;
+  uint32_t head, tail; // Free-running, masked on access
+} vm8_queue;
+
+typedef struct {
+  CPUGuest *guests;
+  uint32_t count, capacity;
+  uint32_t mask; // Queue capacity - 1
+  vm8_queue ready[VM8_SCHED_PRIORITIES];
+  uint64_t slice;    // Instructions per time slice
+  uint64_t slices;   // Slices run
+  uint64_t retired;  // Instructions retired by all guests
+} CPUSched;
+
+static inline uint32_t vm8_queue_size(const vm8_queue *q) {
+  return q->tail - q->head;
+}
+
+// ============================================================================
+// SCHEDULER API
+// ============================================================================
+
+static inline void vm8_sched_free(CPUSched *sched) {
+  free(sched->guests);
+  for (int p = 0; p < VM8_SCHED_PRIORITIES; p++)
+    free(sched->ready[p].ids);
+  __builtin_memset(sched, 0, sizeof(CPUSched));
+}
+
+/* Room for capacity guests (at most VM8_SCHED_MAX_GUESTS), slice
+   instructions per time slice. Returns 0, or -1 on allocation failure or a
+   capacity too large. */
+static inline int vm8_sched_init(CPUSched *sched, uint32_t capacity,
+                                 uint64_t slice) {
+  uint32_t size = 1;
+
+  __builtin_memset(sched, 0, sizeof(CPUSched));
+  if (capacity > VM8_SCHED_MAX_GUESTS)
+    return -1;
+  while (size < capacity)
+    size <<= 1;
+  sched->capacity = capacity;
+  sched->mask = size - 1;
+  sched->slice = slice ? slice : 1;
+  sched->guests = calloc(capacity ? capacity : 1, sizeof(CPUGuest));
+  for (int p = 0; p < VM8_SCHED_PRIORITIES; p++)
+    sched->ready[p].ids = malloc(size * sizeof(uint32_t));
+
+  int ok = sched->guests != NULL;
+  for (int p = 0; p < VM8_SCHED_PRIORITIES; p++)
+    ok = ok && sched->ready[p].ids != NULL;
+  if (!ok) {
+    vm8_sched_free(sched);
+    return -1;
+  }
+  return 0;
+}
+
+static inline void vm8_sched_enqueue(CPUSched *sched, uint32_t id) {
+  CPUGuest *guest = &sched->guests[id];
+  vm8_queue *q = &sched->ready[guest->priority];
+
+  q->ids[q->tail++ & sched->mask] = id;
+  guest->queued = 1;
+}
+
+/* Add a ready guest. Returns its id, or -1 when full. */
+static inline int64_t vm8_sched_add(CPUSched *sched, CPU *cpu,
+                                    unsigned priority) {
+  if (sched->count == sched->capacity)
+    return -1;
+
+  uint32_t id = sched->count++;
+  CPUGuest *guest = &sched->guests[id];
+  guest->cpu = cpu;
+  guest->priority = (uint8_t)(priority < VM8_SCHED_PRIORITIES
+                                  ? priority
+                                  : VM8_SCHED_PRIORITIES - 1);
+  guest->state = (cpu->flags & FLAG_HALTED) ? VM8_GUEST_HALTED
+                                            : VM8_GUEST_READY;
+  if (guest->state == VM8_GUEST_READY)
+    vm8_sched_enqueue(sched, id);
+  return id;
+}
+
+/* Take a guest off the CPU until vm8_sched_wake (no-op if halted) */
+static inline void vm8_sched_park(CPUSched *sched, uint32_t id) {
+  if (sched->guests[id].state != VM8_GUEST_HALTED)
+    sched->guests[id].state = VM8_GUEST_PARKED;
+}
+
+/* Make a parked or idle guest ready again */
+static inline void vm8_sched_wake(CPUSched *sched, uint32_t id) {
+  CPUGuest *guest = &sched->guests[id];
+
+  if (guest->state == VM8_GUEST_HALTED)
+    return;
+  guest->state = VM8_GUEST_READY;
+  if (!guest->queued)
+    vm8_sched_enqueue(sched, id);
+}
+
+/* Slice ended spinning on `B AL <itself>`: nothing in the guest can end it */
+static inline int vm8_guest_idle(const CPU *cpu) {
+  return cpu->memory[cpu->PC] == OPCODE_B &&
+         cpu->memory[(uint8_t)(cpu->PC + 1)] == COND_AL &&
+         cpu->memory[(uint8_t)(cpu->PC + 2)] == cpu->PC;
+}
+
+/* Run up to max_slices time slices (0 = until no guest is ready).
+   Returns the number of slices run. */
+static inline uint64_t vm8_sched_run(CPUSched *sched, uint64_t max_slices) {
+  uint32_t batch[VM8_SCHED_BATCH];
+  uint64_t run = 0;
+
+  for (;;) {
+    // Highest priority non-empty bucket
+    int p = 0;
+    while (p < VM8_SCHED_PRIORITIES && vm8_queue_size(&sched->ready[p]) == 0)
+      p++;
+    if (p == VM8_SCHED_PRIORITIES)
+      break;
+
+    // Take a batch off the queue
+    vm8_queue *q = &sched->ready[p];
+    uint32_t n = vm8_queue_size(q);
+    if (n > VM8_SCHED_BATCH)
+      n = VM8_SCHED_BATCH;
+    if (max_slices && n > max_slices - run)
+      n = (uint32_t)(max_slices - run);
+    for (uint32_t i = 0; i < n; i++)
+      batch[i] = q->ids[q->head++ & sched->mask];
+
+    // Run it back to back, then requeue the survivors together
+    uint64_t retired_batch = 0;
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < n; i++) {
+      CPUGuest *guest = &sched->guests[batch[i]];
+      uint64_t retired = 0;
+
+      guest->queued = 0;
+      if (guest->state != VM8_GUEST_READY)
+        continue; // Parked while queued
+
+      if (cpu_run_fast(guest->cpu, sched->slice, &retired) == CPU_HALTED)
+        guest->state = VM8_GUEST_HALTED;
+      else if (vm8_guest_idle(guest->cpu))
+        guest->state = VM8_GUEST_IDLE;
+      else
+        batch[kept++] = batch[i];
+      guest->retired += retired;
+      retired_batch += retired;
+      run++;
+    }
+    for (uint32_t i = 0; i < kept; i++)
+      vm8_sched_enqueue(sched, batch[i]);
+    sched->retired += retired_batch;
+
+    if (max_slices && run >= max_slices)
+      break;
+  }
+  sched->slices += run;
+  return run;
+}
+
+#endif // CPU_SCHED_H
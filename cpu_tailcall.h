@@ -0,0 +1,368 @@
+#ifndef CPU_TAILCALL_H
+#define CPU_TAILCALL_H
+
+#include "cpu.h"
+
+/*
+ * Tail-call engine (3-byte instruction format).
+ *
+ * Every handler receives the guest state as arguments (cpu, pc, a, x, flags)
+ * and ends by jumping straight into the handler of the next instruction, so
+ * PC/A/X/flags stay in host registers for the whole run and are written back
+ * to the CPU struct only when the guest halts. SP and memory are still
+ * accessed through the CPU pointer.
+ *
+ * Build flag:
+ *   CPU_TAILCALL=1  tail calls, guaranteed by __attribute__((musttail))
+ *                   where the compiler has it (clang, GCC 15)
+ *   CPU_TAILCALL=0  portable fallback (GCC): handlers return the packed state
+ *                   to a dispatch loop instead of tail-calling
+ * When not set, it is enabled automatically if the compiler has musttail.
+ *
+ * Results are identical to looping over cpu_step until it returns CPU_HALTED.
+ */
+
+#if defined(__has_attribute)
+#if __has_attribute(musttail)
+#define TC_MUSTTAIL __attribute__((musttail))
+#endif
+#endif
+
+#ifndef CPU_TAILCALL
+#ifdef TC_MUSTTAIL
+#define CPU_TAILCALL 1
+#else
+#define CPU_TAILCALL 0
+#endif
+#endif
+
+/* Dispatch actually compiled, for reports */
+#if !CPU_TAILCALL
+#define CPU_TAILCALL_DISPATCH "loop fallback"
+#elif defined(TC_MUSTTAIL)
+#define CPU_TAILCALL_DISPATCH "musttail"
+#else
+#define CPU_TAILCALL_DISPATCH "sibling calls, not guaranteed"
+#endif
+
+/* CPU_TAILCALL=1 without musttail relies on sibling-call optimisation (-O2) */
+#ifndef TC_MUSTTAIL
+#define TC_MUSTTAIL
+#endif
+
+/* Packed guest state: PC | A << 8 | X << 16 | flags << 24 */
+typedef uint32_t tc_state;
+
+#define TC_PACK(pc, a, x, flags)                                               \
+  ((tc_state)(pc) | ((tc_state)(a) << 8) | ((tc_state)(x) << 16) |             \
+   ((tc_state)(flags) << 24))
+#define TC_PC(s) ((uint8_t)(s))
+#define TC_A(s) ((uint8_t)((s) >> 8))
+#define TC_X(s) ((uint8_t)((s) >> 16))
+#define TC_FLAGS(s) ((uint8_t)((s) >> 24))
+
+typedef tc_state (*tc_handler)(CPU *cpu, uint8_t pc, uint8_t a, uint8_t x,
+                               uint8_t flags);
+
+#define TC_HANDLER(name)                                                       \
+  static tc_state name(CPU *cpu, uint8_t pc, uint8_t a, uint8_t x,             \
+                       uint8_t flags)
+
+/* Indexed by the raw opcode byte: invalid opcodes map to tc_op_illegal, so
+   dispatch needs no range check */
+static const tc_handler tc_table[MAX_MEMORY_SIZE];
+
+#if CPU_TAILCALL
+#define TC_DISPATCH()                                                          \
+  TC_MUSTTAIL return tc_table[cpu->memory[pc]](cpu, pc, a, x, flags)
+#else
+#define TC_DISPATCH() return TC_PACK(pc, a, x, flags)
+#endif
+
+/* Stop the run: state is written back by cpu_run_tailcall */
+#define TC_EXIT() return TC_PACK(pc, a, x, flags | FLAG_HALTED)
+
+/* Fetch mode/operand, advance PC, validate mode (as cpu_step does) */
+#define TC_DECODE()                                                            \
+  uint8_t mode = cpu->memory[(uint8_t)(pc + 1)];                               \
+  uint8_t operand = cpu->memory[(uint8_t)(pc + 2)];                            \
+  pc = (uint8_t)(pc + 3);                                                      \
+  if (UNLIKELY(mode >= MODE_COUNT))                                            \
+  TC_EXIT()
+
+// TC_DECODE, halting as well on modes outside `modes` (HALT_UNLESS_MODE)
+#define TC_DECODE_MODES(modes)                                                 \
+  TC_DECODE();                                                                 \
+  if (UNLIKELY(!(((modes) >> mode) & 1)))                                      \
+  TC_EXIT()
+
+// ============================================================================
+// TAIL-CALL HANDLERS
+// ============================================================================
+
+TC_HANDLER(tc_op_illegal) {
+  (void)cpu;
+  pc = (uint8_t)(pc + 1); // cpu_step only consumed the opcode byte
+  TC_EXIT();
+}
+
+TC_HANDLER(tc_op_nop) {
+  TC_DECODE();
+  (void)operand;
+  TC_DISPATCH();
+}
+
+TC_HANDLER(tc_op_lda) {
+  TC_DECODE_MODES(MODES_VALUE);
+  a = operand_value_x(cpu->memory, x, mode, operand);
+  flags = flags_zn(flags, a);
+  TC_DISPATCH();
+}
+
+TC_HANDLER(tc_op_ldx) {
+  TC_DECODE_MODES(MODES_VALUE);
+  x = operand_value_x(cpu->memory, x, mode, operand);
+  flags = flags_zn(flags, x);
+  TC_DISPATCH();
+}
+
+TC_HANDLER(tc_op_sta) {
+  TC_DECODE_MODES(MODES_STORE);
+  cpu->memory[effective_address_x(cpu->memory, x, mode, operand)] = a;
+  TC_DISPATCH();
+}
+
+TC_HANDLER(tc_op_stx) {
+  TC_DECODE_MODES(MODES_STORE);
+  cpu->memory[effective_address_x(cpu->memory, x, mode, operand)] = x;
+  TC_DISPATCH();
+}
+
+TC_HANDLER(tc_op_branch) {
+  uint8_t condition = cpu->memory[(uint8_t)(pc + 1)];
+  uint8_t address = cpu->memory[(uint8_t)(pc + 2)];
+  pc = (uint8_t)(pc + 3);
+  if (UNLIKELY(condition >= COND_COUNT))
+    TC_EXIT();
+  pc = branch_taken(flags, condition) ? address : pc;
+  TC_DISPATCH();
+}
+
+TC_HANDLER(tc_op_add) {
+  TC_DECODE_MODES(MODES_VALUE);
+  flags = flags_add(flags, a, operand_value_x(cpu->memory, x, mode, operand),
+                    &a);
+  TC_DISPATCH();
+}
+
+TC_HANDLER(tc_op_sub) {
+  TC_DECODE_MODES(MODES_VALUE);
+  flags = flags_sub(flags, a, operand_value_x(cpu->memory, x, mode, operand),
+                    &a);
+  TC_DISPATCH();
+}
+
+TC_HANDLER(tc_op_xor) {
+  TC_DECODE_MODES(MODES_VALUE);
+  a ^= operand_value_x(cpu->memory, x, mode, operand);
+  flags = flags_zn(flags, a);
+  TC_DISPATCH();
+}
+
+TC_HANDLER(tc_op_and) {
+  TC_DECODE_MODES(MODES_VALUE);
+  a &= operand_value_x(cpu->memory, x, mode, operand);
+  flags = flags_zn(flags, a);
+  TC_DISPATCH();
+}
+
+TC_HANDLER(tc_op_or) {
+  TC_DECODE_MODES(MODES_VALUE);
+  a |= operand_value_x(cpu->memory, x, mode, operand);
+  flags = flags_zn(flags, a);
+  TC_DISPATCH();
+}
+
+TC_HANDLER(tc_op_pop) {
+  TC_DECODE();
+  if (UNLIKELY(!stack_can_pop(cpu->SP, stack_count(mode, operand))))
+    TC_EXIT(); // Stack underflow
+  if (stack_masked(mode, operand)) {
+    STACK_POP_REGS(cpu->memory, cpu->SP, operand, a, x, flags);
+    TC_DISPATCH();
+  }
+  cpu->SP++;
+  a = cpu->memory[cpu->SP];
+  flags = flags_zn(flags, a);
+  TC_DISPATCH();
+}
+
+TC_HANDLER(tc_op_push) {
+  TC_DECODE();
+  if (UNLIKELY(!stack_can_push(cpu->SP, stack_count(mode, operand))))
+    TC_EXIT(); // Stack overflow
+  if (stack_masked(mode, operand)) {
+    STACK_PUSH_REGS(cpu->memory, cpu->SP, operand, a, x, flags);
+    TC_DISPATCH();
+  }
+  cpu->memory[cpu->SP] = a;
+  cpu->SP--;
+  TC_DISPATCH();
+}
+
+TC_HANDLER(tc_op_cmp) {
+  uint8_t result;
+  TC_DECODE_MODES(MODES_VALUE);
+  flags = flags_sub(flags, a, operand_value_x(cpu->memory, x, mode, operand),
+                    &result);
+  TC_DISPATCH();
+}
+
+TC_HANDLER(tc_op_cpx) {
+  uint8_t result;
+  TC_DECODE_MODES(MODES_VALUE);
+  flags = flags_sub(flags, x, operand_value_x(cpu->memory, x, mode, operand),
+                    &result);
+  TC_DISPATCH();
+}
+
+/* Read-modify-write on A (MODE_REGISTER) or memory, with the shared rmw_*
+   kernels. MODE_IMMEDIAT is a no-op like in op_ror & co. */
+#define TC_RMW_HANDLER(name, kernel)                                           \
+  TC_HANDLER(name) {                                                           \
+    uint8_t address = 0;                                                       \
+    uint8_t value;                                                             \
+    uint16_t r;                                                                \
+    TC_DECODE();                                                               \
+    if (mode == MODE_IMMEDIAT)                                                 \
+      TC_DISPATCH();                                                           \
+    if (mode == MODE_REGISTER) {                                               \
+      value = a;                                                               \
+    } else {                                                                   \
+      address = effective_address_x(cpu->memory, x, mode, operand);            \
+      value = cpu->memory[address];                                            \
+    }                                                                          \
+    r = kernel(value, flags & FLAG_CARRY);                                     \
+    flags = flags_znc(flags, RMW_RESULT(r), RMW_CARRY(r));                     \
+    if (mode == MODE_REGISTER)                                                 \
+      a = RMW_RESULT(r);                                                       \
+    else                                                                       \
+      cpu->memory[address] = RMW_RESULT(r);                                    \
+    TC_DISPATCH();                                                             \
+  }
+
+TC_RMW_HANDLER(tc_op_ror, rmw_ror)
+TC_RMW_HANDLER(tc_op_rol, rmw_rol)
+TC_RMW_HANDLER(tc_op_shr, rmw_shr)
+TC_RMW_HANDLER(tc_op_shl, rmw_shl)
+
+TC_HANDLER(tc_op_inx) {
+  TC_DECODE();
+  (void)operand;
+  x++;
+  flags = flags_zn(flags, x);
+  TC_DISPATCH();
+}
+
+TC_HANDLER(tc_op_dex) {
+  TC_DECODE();
+  (void)operand;
+  x--;
+  flags = flags_zn(flags, x);
+  TC_DISPATCH();
+}
+
+TC_HANDLER(tc_op_halt) {
+  TC_DECODE();
+  (void)operand;
+  TC_EXIT();
+}
+
+TC_HANDLER(tc_op_jsr) {
+  TC_DECODE();
+  if (UNLIKELY(!stack_can_push(cpu->SP, 1)))
+    TC_EXIT(); // Stack overflow
+  cpu->memory[cpu->SP--] = pc;
+  pc = operand;
+  TC_DISPATCH();
+}
+
+TC_HANDLER(tc_op_rts) {
+  TC_DECODE();
+  (void)operand;
+  if (UNLIKELY(!stack_can_pop(cpu->SP, 1)))
+    TC_EXIT(); // Stack underflow
+  pc = cpu->memory[++cpu->SP];
+  TC_DISPATCH();
+}
+
+TC_HANDLER(tc_op_jmp) {
+  TC_DECODE_MODES(MODES_STORE);
+  pc = effective_address_x(cpu->memory, x, mode, operand);
+  TC_DISPATCH();
+}
+
+TC_HANDLER(tc_op_move) {
+  TC_DECODE_MODES(MODES_STORE);
+  uint8_t src = effective_address_x(cpu->memory, x, mode, operand);
+  memory_move(cpu->memory, x, src, a);
+  TC_DISPATCH();
+}
+
+TC_HANDLER(tc_op_fill) {
+  TC_DECODE_MODES(MODES_VALUE);
+  memory_fill(cpu->memory, x, operand_value_x(cpu->memory, x, mode, operand),
+              a);
+  TC_DISPATCH();
+}
+
+__extension__ static const tc_handler tc_table[MAX_MEMORY_SIZE] = {
+    [OPCODE_NOP] = tc_op_nop,   [OPCODE_LDA] = tc_op_lda,
+    [OPCODE_LDX] = tc_op_ldx,   [OPCODE_STA] = tc_op_sta,
+    [OPCODE_STX] = tc_op_stx,   [OPCODE_B] = tc_op_branch,
+    [OPCODE_ADD] = tc_op_add,   [OPCODE_SUB] = tc_op_sub,
+    [OPCODE_XOR] = tc_op_xor,   [OPCODE_AND] = tc_op_and,
+    [OPCODE_OR] = tc_op_or,     [OPCODE_POP] = tc_op_pop,
+    [OPCODE_PUSH] = tc_op_push, [OPCODE_CMP] = tc_op_cmp,
+    [OPCODE_CPX] = tc_op_cpx,   [OPCODE_ROR] = tc_op_ror,
+    [OPCODE_ROL] = tc_op_rol,   [OPCODE_SHR] = tc_op_shr,
+    [OPCODE_SHL] = tc_op_shl,   [OPCODE_INX] = tc_op_inx,
+    [OPCODE_DEX] = tc_op_dex,   [OPCODE_HALT] = tc_op_halt,
+    [OPCODE_JSR] = tc_op_jsr,   [OPCODE_RTS] = tc_op_rts,
+    [OPCODE_JMP] = tc_op_jmp,   [OPCODE_MOVE] = tc_op_move,
+    [OPCODE_FILL] = tc_op_fill,
+    [OPCODE_COUNT ... MAX_MEMORY_SIZE - 1] = tc_op_illegal,
+};
+
+_Static_assert(OPCODE_COUNT == OPCODE_FILL + 1,
+               "new opcode: add it to tc_table");
+
+/* Run until the guest halts. Returns CPU_HALTED; the halting instruction and
+   PC are the same as with cpu_step. */
+static inline int cpu_run_tailcall(CPU *cpu) {
+  if (UNLIKELY(cpu->flags & FLAG_HALTED))
+    return CPU_HALTED;
+
+  tc_state state;
+#if CPU_TAILCALL
+  state = tc_table[cpu->memory[cpu->PC]](cpu, cpu->PC, cpu->A, cpu->X,
+                                         cpu->flags);
+#else
+  uint8_t pc = cpu->PC;
+  state = TC_PACK(cpu->PC, cpu->A, cpu->X, cpu->flags);
+  do {
+    state = tc_table[cpu->memory[pc]](cpu, pc, TC_A(state), TC_X(state),
+                                      TC_FLAGS(state));
+    pc = TC_PC(state);
+  } while (!(TC_FLAGS(state) & FLAG_HALTED));
+#endif
+
+  // Write back the guest registers only once, at exit
+  cpu->PC = TC_PC(state);
+  cpu->A = TC_A(state);
+  cpu->X = TC_X(state);
+  cpu->flags = TC_FLAGS(state);
+  return CPU_HALTED;
+}
+
+#endif // CPU_TAILCALL_H
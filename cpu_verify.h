@@ -0,0 +1,245 @@
+#ifndef CPU_VERIFY_H
+#define CPU_VERIFY_H
+
+#include "cpu.h"
+
+/*
+ * Load-time verifier for 3-byte format images.
+ *
+ * Walks every instruction reachable from the entry point (cpu->PC), following
+ * both edges of conditional branches, and proves that:
+ *   - every reachable opcode, addressing mode and branch condition is valid
+ *     (modes checked per opcode against opcode_modes);
+ *   - no store can hit a reachable instruction byte (no self-modifying code),
+ *     so what was verified is what will run (MOVE/FILL write at X, which
+ *     counts as a computed store);
+ *   - the stack depth at each reachable instruction is a single known value
+ *     and never underflows or exceeds STACK_SIZE (starting from cpu->SP);
+ *   - every RTS returns through the address its JSR pushed: it is reached at
+ *     the depth the subroutine was entered with, nothing pops below that
+ *     return address, and no absolute store can overwrite a stack slot.
+ *     A JSR continues at its callee and, once the callee returns, at the
+ *     next instruction, both with known depths;
+ *   - every JMP has a single known target: JMP $a, or JMP [$a] through a
+ *     pointer no reachable store can write. Indexed jumps ($a,X and
+ *     [$a,X]) have data-dependent targets and are not followed.
+ *
+ * Images that pass may run on cpu_step_unchecked; anything else (invalid
+ * code, computed stores into code, data-dependent stack depth) stays on the
+ * checked cpu_step. The result is only valid for the memory that was
+ * verified: reloading or patching the image needs a new verification.
+ */
+
+// Verification result
+typedef struct {
+  int valid;           // All reachable instructions decode to valid forms
+  int self_modifying;  // A store may hit a reachable instruction byte
+  int stack_proven;    // Stack depth stays within [0, STACK_SIZE] everywhere
+  int computed_jump;   // A reachable JMP target depends on run-time data
+  uint8_t entry;       // Entry point (cpu->PC at verification time)
+  uint8_t bad_pc;      // First invalid instruction found (when !valid)
+  int max_depth;       // Deepest stack depth reached (when stack_proven)
+  cpu_bitmap code;     // Bytes of reachable instructions
+  cpu_bitmap written;  // Bytes reachable stores may write
+  cpu_bitmap pointers; // Jump table slots reachable JMP [$a] read
+} CPUVerifyInfo;
+
+static inline int verify_depth_at(const CPU *cpu) {
+  return STACK_BASE - cpu->SP;
+}
+
+/* Returns 1 when the image can run on the unchecked engine */
+static inline int cpu_verify(const CPU *cpu, CPUVerifyInfo *info) {
+  int16_t depth[MAX_MEMORY_SIZE]; // -1 = not visited yet
+  int16_t frame[MAX_MEMORY_SIZE]; // Depth holding the return address, 0 = none
+  uint8_t worklist[MAX_MEMORY_SIZE];
+  int pending = 0;
+  int write_anywhere = 0;
+  int calls = 0;
+  cpu_bitmap stored = {{0}}; // Absolute stores (PUSH/JSR excluded)
+
+  __builtin_memset(info, 0, sizeof(CPUVerifyInfo));
+  info->valid = 1;
+  info->stack_proven = 1;
+  info->entry = cpu->PC;
+  for (int i = 0; i < MAX_MEMORY_SIZE; i++)
+    depth[i] = -1;
+
+  depth[cpu->PC] = (int16_t)verify_depth_at(cpu);
+  frame[cpu->PC] = 0;
+  worklist[pending++] = cpu->PC;
+
+  while (pending > 0) {
+    uint8_t pc = worklist[--pending];
+    int d = depth[pc];
+    int f = frame[pc];
+    uint8_t opcode = cpu->memory[pc];
+    uint8_t mode = cpu->memory[(uint8_t)(pc + 1)];
+    uint8_t operand = cpu->memory[(uint8_t)(pc + 2)];
+    uint8_t next = (uint8_t)(pc + 3);
+    uint8_t successors[2];
+    int16_t successor_depth[2] = {0, 0};
+    int16_t successor_frame[2] = {0, 0};
+    int count = 0;
+    int next_depth = d;
+    int pushed = 0; // Bytes pushed (PUSH, JSR)
+
+    for (int i = 0; i < 3; i++)
+      bitmap_set(&info->code, (uint8_t)(pc + i));
+
+    if (opcode >= OPCODE_COUNT ||
+        (opcode == OPCODE_B ? mode >= COND_COUNT
+                            : mode >= MODE_COUNT ||
+                                  !((opcode_modes[opcode] >> mode) & 1))) {
+      if (info->valid) {
+        info->valid = 0;
+        info->bad_pc = pc;
+      }
+      continue;
+    }
+
+    switch (opcode) {
+    case OPCODE_HALT:
+      break;
+    case OPCODE_B:
+      successors[count++] = operand;
+      if (mode != COND_AL)
+        successors[count++] = next;
+      break;
+    case OPCODE_PUSH:
+      if (d > STACK_SIZE)
+        info->stack_proven = 0; // SP outside the stack, even for no register
+      pushed = (int)stack_count(mode, operand);
+      next_depth = d + pushed;
+      successors[count++] = next;
+      break;
+    case OPCODE_POP:
+      // Popping the return address of the current subroutine breaks RTS
+      if (d - (int)stack_count(mode, operand) < f || d > STACK_SIZE)
+        info->stack_proven = 0;
+      next_depth = d - (int)stack_count(mode, operand);
+      successors[count++] = next;
+      break;
+    case OPCODE_JSR:
+      calls = 1;
+      pushed = 1;
+      // The callee runs one deeper, in a new frame
+      successor_depth[count] = (int16_t)(d + 1);
+      successor_frame[count] = (int16_t)(d + 1);
+      successors[count++] = operand;
+      break;
+    case OPCODE_JMP:
+      if (mode == MODE_ABSOLUTE) {
+        successors[count++] = operand;
+      } else if (mode == MODE_INDIRECT) {
+        // Constant if nothing writes it
+        bitmap_set(&info->pointers, operand);
+        successors[count++] = cpu->memory[operand];
+      } else {
+        info->computed_jump = 1;
+      }
+      break;
+    case OPCODE_RTS:
+      if (f < 1 || d != f)
+        info->stack_proven = 0; // Return address unknown
+      break;
+    case OPCODE_STA:
+    case OPCODE_STX:
+    case OPCODE_ROR:
+    case OPCODE_ROL:
+    case OPCODE_SHR:
+    case OPCODE_SHL:
+      if (mode == MODE_ABSOLUTE) {
+        bitmap_set(&info->written, operand);
+        bitmap_set(&stored, operand);
+      } else if (mode != MODE_IMMEDIAT && mode != MODE_REGISTER)
+        write_anywhere = 1; // Computed address
+      successors[count++] = next;
+      break;
+    case OPCODE_MOVE:
+    case OPCODE_FILL:
+      write_anywhere = 1; // Destination and length are X and A
+      successors[count++] = next;
+      break;
+    default:
+      successors[count++] = next;
+      break;
+    }
+
+    if (pushed) {
+      if (d < 0 || d + pushed > STACK_SIZE)
+        info->stack_proven = 0;
+      if (d >= 0 && d + pushed <= STACK_SIZE) {
+        for (int i = 0; i < pushed; i++)
+          bitmap_set(&info->written, (uint8_t)(STACK_BASE - d - i));
+      } else {
+        // Unknown slot: the checked engine may write anywhere in the stack
+        for (int i = 0; i < STACK_SIZE; i++)
+          bitmap_set(&info->written, (uint8_t)(STACK_BASE - i));
+      }
+    }
+    if (opcode == OPCODE_JSR) {
+      // Where the callee returns to, once it has popped the address
+      successor_depth[count] = (int16_t)d;
+      successor_frame[count] = (int16_t)f;
+      successors[count++] = next;
+      if (d >= info->max_depth)
+        info->max_depth = d + 1;
+    } else {
+      for (int i = 0; i < count; i++) {
+        successor_depth[i] = (int16_t)next_depth;
+        successor_frame[i] = (int16_t)f;
+      }
+    }
+
+    if (next_depth > info->max_depth)
+      info->max_depth = next_depth;
+
+    for (int i = 0; i < count; i++) {
+      uint8_t target = successors[i];
+      if (depth[target] == -1) {
+        // A failed proof keeps walking for validity with a poisoned depth
+        depth[target] = info->stack_proven ? successor_depth[i] : -2;
+        frame[target] = successor_frame[i];
+        worklist[pending++] = target;
+      } else if (depth[target] != successor_depth[i] ||
+                 frame[target] != successor_frame[i]) {
+        info->stack_proven = 0; // Depth depends on the path taken
+      }
+    }
+  }
+
+  // Return addresses live in the stack: absolute stores there could
+  // redirect an RTS
+  if (calls)
+    for (int i = 0; i < STACK_SIZE; i++)
+      if (bitmap_test(&stored, (uint8_t)(STACK_BASE - i)))
+        info->stack_proven = 0;
+
+  for (int i = 0; i < MAX_MEMORY_SIZE / 64; i++)
+    if (info->pointers.bits[i] & info->written.bits[i])
+      info->computed_jump = 1; // Jump table patched at run time
+
+  if (write_anywhere) {
+    info->self_modifying = 1;
+  } else {
+    for (int i = 0; i < MAX_MEMORY_SIZE / 64; i++)
+      if (info->code.bits[i] & info->written.bits[i])
+        info->self_modifying = 1;
+  }
+  if (!info->stack_proven)
+    info->max_depth = 0;
+
+  return info->valid && !info->self_modifying && info->stack_proven &&
+         !info->computed_jump;
+}
+
+/* Pick the step engine for a verified (or rejected) image */
+static inline cpu_step_fn cpu_select_step(const CPUVerifyInfo *info) {
+  if (info->valid && !info->self_modifying && info->stack_proven &&
+      !info->computed_jump)
+    return cpu_step_unchecked;
+  return cpu_step;
+}
+
+#endif // CPU_VERIFY_H
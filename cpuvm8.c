@@ -1,5 +1,8 @@
+#define _DEFAULT_SOURCE // clock_gettime, usleep
 #include "cpuvm8.h"
 #include "cpu.h"
+#include "cpu_dispatch.h"
+#include "cpu_metrics.h"
 
 int main(int argc, char *argv[]) {
 
@@ -7,6 +10,10 @@ int main(int argc, char *argv[]) {
   double freq_mhz = 4.0;
   int status = 0;
   int benchmark = 0;
+  uint64_t executed = 0;
+  const CPUEngines *engines = cpu_engines(); // Best ISA variant of the host
+  CPUMetrics metrics;
+  CPUMetricsRegistry registry;
 
   if (argc > 1) {
     freq_mhz = atof(argv[1]);
@@ -17,6 +24,9 @@ int main(int argc, char *argv[]) {
 
   CPU cpu;
   initCPU(&cpu);
+  cpu_metrics_reset(&metrics);
+  cpu_metrics_registry_init(&registry);
+  cpu_metrics_register(&registry, &metrics);
 
   // Programme de test (boucle simple)
   uint8_t program[] = {
@@ -30,18 +40,25 @@ int main(int argc, char *argv[]) {
   struct timespec start, now;
   clock_gettime(CLOCK_MONOTONIC, &start);
 
-  for (int i = 0; i < INSTR_COUNT; i++) {
+  // Tranches de THROTTLE_SLICE instructions en mode benchmark (cadencé),
+  // tout d'un coup sinon
+  while (executed < INSTR_COUNT) {
+    uint64_t slice = INSTR_COUNT - executed;
+    uint64_t retired;
+    if (benchmark && slice > THROTTLE_SLICE)
+      slice = THROTTLE_SLICE;
 
-    status = cpu_step(&cpu);
+    status = engines->run_step(&cpu, slice, &retired);
+    executed += retired;
     if (status == CPU_HALTED) {
       printf("CPU ERROR at PC=0x%02X\n", cpu.PC - 3);
       dump_cpu(&cpu);
       break;
     }
 
-    // Calcul du temps cible pour ce cycle
+    // Calcul du temps cible pour cette tranche
     if (benchmark) {
-      double target_time = (double)(i + 1) / (freq_mhz * 1e6);
+      double target_time = (double)executed / (freq_mhz * 1e6);
       clock_gettime(CLOCK_MONOTONIC, &now);
       double elapsed =
           (now.tv_sec - start.tv_sec) + (now.tv_nsec - start.tv_nsec) / 1e9;
@@ -61,6 +78,12 @@ int main(int argc, char *argv[]) {
       (now.tv_sec - start.tv_sec) + (now.tv_nsec - start.tv_nsec) / 1e9;
   double mips = (double)INSTR_COUNT / (total_elapsed * 1e6);
 
+  // Text-format metrics for a scraper (VM8_METRICS_FILE=path)
+  cpu_metrics_run(&metrics, &cpu, status, executed);
+  const char *metrics_file = getenv("VM8_METRICS_FILE");
+  if (metrics_file && cpu_metrics_export(&registry, metrics_file) != 0)
+    printf("Cannot write metrics to %s\n", metrics_file);
+
   if (status != CPU_HALTED) {
     if (benchmark) {
       printf("Benchmark: %d instructions...\n", INSTR_COUNT);
@@ -71,6 +94,7 @@ int main(int argc, char *argv[]) {
            total_elapsed);
     printf("Estimated performance: %.2f MIPS (Millions of Instructions Per Second)\n",
            mips);
+    printf("Engine: cpu_step, %s variant\n", engines->name);
     printf("--------------------------------------------------\n");
   }
 }
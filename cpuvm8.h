@@ -7,6 +7,7 @@
 #include <unistd.h>     // usleep...
 
 #define INSTR_COUNT 10000000
+#define THROTTLE_SLICE 1000 // Instructions between two throttling checks
 
 void dump_cpu(const CPU *cpu);
 #endif
@@ -0,0 +1,60 @@
+#include "unity/unity.h"
+#include "../cpu_tailcall.h"
+
+void FILL_test(void) {
+    CPU cpu;
+
+    // FILL #$5A over A bytes from X, wrapping past $FF
+    const uint8_t cases[][2] = {
+        // dst (X), count (A)
+        {0xC0, 16}, {0xFA, 10}, {0x80, 0}, {0x01, 255},
+    };
+    for (unsigned i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        initCPU(&cpu);
+        cpu.memory[0] = OPCODE_FILL;
+        cpu.memory[1] = MODE_IMMEDIAT;
+        cpu.memory[2] = 0x5A;
+        cpu.X = cases[i][0];
+        cpu.A = cases[i][1];
+        cpu.flags = FLAG_ZERO;
+        CPU fast = cpu;
+
+        TEST_ASSERT_EQUAL_INT(CPU_OK, cpu_step(&cpu));
+        for (unsigned b = 0; b < MAX_MEMORY_SIZE; b++) {
+            int filled = (uint8_t)(b - cases[i][0]) < cases[i][1];
+            uint8_t expected = filled ? 0x5A
+                               : b == 0 ? OPCODE_FILL
+                               : b == 1 ? MODE_IMMEDIAT
+                               : b == 2 ? 0x5A : 0;
+            TEST_ASSERT_EQUAL_UINT8(expected, cpu.memory[b]);
+        }
+        TEST_ASSERT_EQUAL_UINT8(cases[i][0], cpu.X);
+        TEST_ASSERT_EQUAL_UINT8(cases[i][1], cpu.A);
+        TEST_ASSERT_EQUAL_UINT8(FLAG_ZERO, cpu.flags);
+
+        TEST_ASSERT_EQUAL_INT(CPU_OK, cpu_run_fast(&fast, 1, NULL));
+        TEST_ASSERT_EQUAL_UINT8_ARRAY(cpu.memory, fast.memory,
+                                      MAX_MEMORY_SIZE);
+    }
+
+    // Value from memory (FILL $E0), then clear a table and halt
+    initCPU(&cpu);
+    cpu.memory[0xE0] = 0x33;
+    uint8_t program[] = {
+        OPCODE_LDA, MODE_IMMEDIAT, 8,
+        OPCODE_LDX, MODE_IMMEDIAT, 0xC0,
+        OPCODE_FILL, MODE_ABSOLUTE, 0xE0,
+        OPCODE_LDX, MODE_IMMEDIAT, 0xC4,
+        OPCODE_FILL, MODE_IMMEDIAT, 0,
+        OPCODE_HALT, 0, 0,
+    };
+    memcpy(cpu.memory, program, sizeof(program));
+    CPU tail = cpu;
+    while (cpu_step(&cpu) == CPU_OK) {
+    }
+    const uint8_t table[] = {0x33, 0x33, 0x33, 0x33, 0, 0, 0, 0, 0, 0, 0, 0};
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(table, &cpu.memory[0xC0], sizeof(table));
+
+    cpu_run_tailcall(&tail);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(cpu.memory, tail.memory, MAX_MEMORY_SIZE);
+}
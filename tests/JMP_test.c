@@ -0,0 +1,92 @@
+#include "unity/unity.h"
+#include "../cpu_verify.h"
+#include "../cpu_tailcall.h"
+
+void JMP_test(void) {
+    CPU cpu;
+    CPUVerifyInfo info;
+
+    // JMP $40 / [$E0] / $40,X / [$E0,X]
+    uint8_t modes[] = {MODE_ABSOLUTE, MODE_INDIRECT, MODE_ABSOLUTE_X,
+                       MODE_INDIRECT_X};
+    uint8_t operands[] = {0x40, 0xE0, 0x40, 0xE0};
+    uint8_t targets[] = {0x40, 0x30, 0x42, 0x60};
+    for (int i = 0; i < 4; i++) {
+        initCPU(&cpu);
+        cpu.X = 2;
+        cpu.memory[0xE0] = 0x30;
+        cpu.memory[0xE2] = 0x60;
+        cpu.memory[0] = OPCODE_JMP;
+        cpu.memory[1] = modes[i];
+        cpu.memory[2] = operands[i];
+        TEST_ASSERT_EQUAL_INT(CPU_OK, cpu_step(&cpu));
+        TEST_ASSERT_EQUAL_UINT8(targets[i], cpu.PC);
+    }
+
+    // Guest dispatch loop: JMP [$E0,X] over a 2-entry handler table
+    CPU fast;
+    initCPU(&cpu);
+    cpu.memory[0xE0] = 9;
+    cpu.memory[0xE1] = 15;
+    uint8_t dispatch[] = {
+        OPCODE_JMP, MODE_INDIRECT_X, 0xE0,  // 0: dispatch on X
+        OPCODE_HALT, 0, 0,
+        OPCODE_HALT, 0, 0,
+        OPCODE_LDX, MODE_IMMEDIAT, 1,       // 9: handler 0 -> handler 1
+        OPCODE_JMP, MODE_ABSOLUTE, 0,       //    (direct jump)
+        OPCODE_LDX, MODE_IMMEDIAT, 0,       // 15: handler 1 -> handler 0
+        OPCODE_JMP, MODE_ABSOLUTE, 0,
+    };
+    memcpy(cpu.memory, dispatch, sizeof(dispatch));
+    TEST_ASSERT_EQUAL_INT(0, cpu_verify(&cpu, &info));
+    TEST_ASSERT_TRUE(info.computed_jump);
+
+    // 10 indirect jumps alternating 9, 15
+    fast = cpu;
+    for (int i = 0; i < 30; i++)
+        TEST_ASSERT_EQUAL_INT(CPU_OK, cpu_step(&cpu));
+    TEST_ASSERT_EQUAL_INT(CPU_OK, cpu_run_fast(&fast, 30, NULL));
+    TEST_ASSERT_EQUAL_MEMORY(&cpu, &fast, sizeof(CPU));
+    TEST_ASSERT_EQUAL_UINT8(0, fast.PC);
+
+    // JMP [$a] through a constant pointer is followed by the verifier
+    initCPU(&cpu);
+    cpu.memory[0xE0] = 6;
+    uint8_t table[] = {
+        OPCODE_JMP, MODE_INDIRECT, 0xE0,
+        OPCODE_HALT, 0, 0,
+        OPCODE_HALT, 0, 0,                  // 6: only reachable target
+    };
+    memcpy(cpu.memory, table, sizeof(table));
+    TEST_ASSERT_EQUAL_INT(1, cpu_verify(&cpu, &info));
+    TEST_ASSERT_TRUE(bitmap_test(&info.code, 6));
+    TEST_ASSERT_FALSE(bitmap_test(&info.code, 3));
+
+    cpu.memory[3] = OPCODE_STA;             // Patched pointer: not constant
+    cpu.memory[4] = MODE_ABSOLUTE;
+    cpu.memory[5] = 0xE0;
+    cpu.memory[6] = OPCODE_JMP;
+    cpu.memory[7] = MODE_ABSOLUTE;
+    cpu.memory[8] = 0;
+    cpu.memory[0xE0] = 3;
+    TEST_ASSERT_EQUAL_INT(0, cpu_verify(&cpu, &info));
+    TEST_ASSERT_TRUE(info.computed_jump);
+
+    // JMP #$40 / JMP A have no target: every engine halts past them
+    uint8_t bad_modes[] = {MODE_IMMEDIAT, MODE_REGISTER};
+    for (int i = 0; i < 2; i++) {
+        CPU tail;
+        initCPU(&cpu);
+        cpu.memory[0] = OPCODE_JMP;
+        cpu.memory[1] = bad_modes[i];
+        cpu.memory[2] = 0x40;
+        fast = tail = cpu;
+        TEST_ASSERT_EQUAL_INT(CPU_HALTED, cpu_step(&cpu));
+        TEST_ASSERT_EQUAL_UINT8(3, cpu.PC);
+        TEST_ASSERT_EQUAL_INT(CPU_HALTED, cpu_run_fast(&fast, 1, NULL));
+        TEST_ASSERT_EQUAL_MEMORY(&cpu, &fast, sizeof(CPU));
+        cpu_run_tailcall(&tail);
+        TEST_ASSERT_EQUAL_MEMORY(&cpu, &tail, sizeof(CPU));
+        TEST_ASSERT_EQUAL_INT(0, cpu_verify(&tail, &info));
+    }
+}
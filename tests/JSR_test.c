@@ -0,0 +1,26 @@
+#include "unity/unity.h"
+#include "../cpu.h"
+
+void JSR_test(void) {
+    CPU cpu;
+    initCPU(&cpu);
+    cpu.PC = 0x10;
+    // JSR $40 ; memory[$FF] = $13 (return address), SP = $FE, PC = $40
+    cpu.memory[0x10] = OPCODE_JSR;
+    cpu.memory[0x11] = MODE_ABSOLUTE;
+    cpu.memory[0x12] = 0x40;
+    TEST_ASSERT_EQUAL_INT(CPU_OK, cpu_step(&cpu));
+    TEST_ASSERT_EQUAL_UINT8(0x13, cpu.memory[STACK_BASE]);
+    TEST_ASSERT_EQUAL_UINT8(STACK_BASE - 1, cpu.SP);
+    TEST_ASSERT_EQUAL_UINT8(0x40, cpu.PC);
+
+    // Full stack: halts without pushing or jumping
+    initCPU(&cpu);
+    cpu.SP = STACK_LIMIT - 1;
+    cpu.memory[0] = OPCODE_JSR;
+    cpu.memory[1] = MODE_ABSOLUTE;
+    cpu.memory[2] = 0x40;
+    TEST_ASSERT_EQUAL_INT(CPU_HALTED, cpu_step(&cpu));
+    TEST_ASSERT_EQUAL_UINT8(STACK_LIMIT - 1, cpu.SP);
+    TEST_ASSERT_EQUAL_UINT8(3, cpu.PC);
+}
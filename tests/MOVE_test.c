@@ -0,0 +1,138 @@
+#include "unity/unity.h"
+#include "../cpu_block.h"
+#include "../cpu_tailcall.h"
+#include "../cpu_verify.h"
+
+/* Byte-at-a-time model: every source byte read before any is written */
+static void move_model(uint8_t *memory, uint8_t dst, uint8_t src,
+                       uint8_t count) {
+    uint8_t buffer[MAX_MEMORY_SIZE];
+    for (unsigned i = 0; i < count; i++)
+        buffer[i] = memory[(uint8_t)(src + i)];
+    for (unsigned i = 0; i < count; i++)
+        memory[(uint8_t)(dst + i)] = buffer[i];
+}
+
+void MOVE_test(void) {
+    CPU cpu, ref;
+    CPUVerifyInfo info;
+
+    // Plain, overlapping both ways, wrapping source and destination, empty
+    const uint8_t cases[][3] = {
+        // src, dst (X), count (A)
+        {0xC0, 0xD0, 4},  {0xC0, 0xC2, 8},   {0xC4, 0xC0, 8},
+        {0xFC, 0x80, 8},  {0x80, 0xFE, 6},   {0xFA, 0xFD, 10},
+        {0xC0, 0xD0, 0},  {0xC0, 0xC0, 16},  {0x10, 0x90, 255},
+    };
+    for (unsigned i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        initCPU(&cpu);
+        for (unsigned b = 3; b < MAX_MEMORY_SIZE; b++)
+            cpu.memory[b] = (uint8_t)(b * 7 + 1);
+        cpu.memory[0] = OPCODE_MOVE;
+        cpu.memory[1] = MODE_ABSOLUTE;
+        cpu.memory[2] = cases[i][0];
+        cpu.X = cases[i][1];
+        cpu.A = cases[i][2];
+        cpu.flags = FLAG_CARRY | FLAG_NEGATIVE;
+        ref = cpu;
+        move_model(ref.memory, cases[i][1], cases[i][0], cases[i][2]);
+        ref.PC = 3;
+
+        CPU step = cpu;
+        TEST_ASSERT_EQUAL_INT(CPU_OK, cpu_step(&step));
+        TEST_ASSERT_EQUAL_UINT8_ARRAY(ref.memory, step.memory, MAX_MEMORY_SIZE);
+        TEST_ASSERT_EQUAL_UINT8(ref.A, step.A);
+        TEST_ASSERT_EQUAL_UINT8(ref.X, step.X);
+        TEST_ASSERT_EQUAL_UINT8(ref.flags, step.flags);
+        TEST_ASSERT_EQUAL_UINT8(3, step.PC);
+
+        CPU fast = cpu;
+        TEST_ASSERT_EQUAL_INT(CPU_OK, cpu_run_fast(&fast, 1, NULL));
+        TEST_ASSERT_EQUAL_UINT8_ARRAY(step.memory, fast.memory,
+                                      MAX_MEMORY_SIZE);
+    }
+
+    // Source through a pointer: MOVE [$E0]
+    initCPU(&cpu);
+    cpu.memory[0xE0] = 0xC8;
+    cpu.memory[0xC8] = 0x11;
+    cpu.memory[0xC9] = 0x22;
+    cpu.memory[0] = OPCODE_MOVE;
+    cpu.memory[1] = MODE_INDIRECT;
+    cpu.memory[2] = 0xE0;
+    cpu.A = 2;
+    cpu.X = 0xD0;
+    TEST_ASSERT_EQUAL_INT(CPU_OK, cpu_step(&cpu));
+    TEST_ASSERT_EQUAL_UINT8(0x11, cpu.memory[0xD0]);
+    TEST_ASSERT_EQUAL_UINT8(0x22, cpu.memory[0xD1]);
+
+    // A program that copies its own code over itself: every engine agrees,
+    // and the block cache drops the overwritten blocks
+    initCPU(&cpu);
+    uint8_t program[] = {
+        OPCODE_LDA, MODE_IMMEDIAT, 3,
+        OPCODE_LDX, MODE_IMMEDIAT, 12,
+        OPCODE_MOVE, MODE_ABSOLUTE, 0xC0,   // Overwrites the NOP at 12
+        OPCODE_HALT, 0, 0,
+        OPCODE_NOP, 0, 0,                   // 12: becomes INX
+        OPCODE_HALT, 0, 0,
+    };
+    memcpy(cpu.memory, program, sizeof(program));
+    cpu.memory[0xC0] = OPCODE_INX;
+    cpu.PC = 0;
+    ref = cpu;
+    while (cpu_step(&ref) == CPU_OK) {
+    }
+    TEST_ASSERT_EQUAL_UINT8(12, ref.X);
+    TEST_ASSERT_EQUAL_UINT8(OPCODE_INX, ref.memory[12]);
+
+    CPU tail = cpu;
+    cpu_run_tailcall(&tail);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(ref.memory, tail.memory, MAX_MEMORY_SIZE);
+
+    // Jump back into the patched code: the block translated before the MOVE
+    // must not run stale
+    CPUBlockCache *cache = cpu_block_cache_create();
+    TEST_ASSERT_NOT_NULL(cache);
+    cpu.memory[9] = OPCODE_JMP;
+    cpu.memory[10] = MODE_ABSOLUTE;
+    cpu.memory[11] = 12;
+    ref = cpu;
+    while (cpu_step(&ref) == CPU_OK) {
+    }
+    TEST_ASSERT_EQUAL_UINT8(13, ref.X);
+    CPU blocks = cpu;
+    TEST_ASSERT_EQUAL_UINT(2, cpu_block_translate(cache, &blocks, 12)->steps);
+    TEST_ASSERT_EQUAL_INT(CPU_HALTED,
+                          cpu_run_blocks(&blocks, cache, UINT64_MAX, NULL));
+    TEST_ASSERT_EQUAL_UINT8(ref.X, blocks.X);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(ref.memory, blocks.memory, MAX_MEMORY_SIZE);
+    TEST_ASSERT_TRUE(cache->invalidations >= 1);
+    cpu_block_cache_destroy(cache);
+
+    // The destination is X: a computed store for the verifier
+    TEST_ASSERT_EQUAL_INT(0, cpu_verify(&cpu, &info));
+    TEST_ASSERT_TRUE(info.valid);
+    TEST_ASSERT_TRUE(info.self_modifying);
+
+    // MOVE #$C0 / MOVE A have no source address: halt, nothing copied
+    uint8_t bad_modes[] = {MODE_IMMEDIAT, MODE_REGISTER};
+    for (int i = 0; i < 2; i++) {
+        initCPU(&cpu);
+        cpu.memory[0] = OPCODE_MOVE;
+        cpu.memory[1] = bad_modes[i];
+        cpu.memory[2] = 0xC0;
+        cpu.memory[0xC0] = 0x55;
+        cpu.A = 4;
+        cpu.X = 0xD0;
+        CPU fast = cpu;
+        tail = cpu;
+        TEST_ASSERT_EQUAL_INT(CPU_HALTED, cpu_step(&cpu));
+        TEST_ASSERT_EQUAL_UINT8(3, cpu.PC);
+        TEST_ASSERT_EQUAL_UINT8(0, cpu.memory[0xD0]);
+        TEST_ASSERT_EQUAL_INT(CPU_HALTED, cpu_run_fast(&fast, 1, NULL));
+        TEST_ASSERT_EQUAL_MEMORY(&cpu, &fast, sizeof(CPU));
+        cpu_run_tailcall(&tail);
+        TEST_ASSERT_EQUAL_MEMORY(&cpu, &tail, sizeof(CPU));
+    }
+}
@@ -0,0 +1,21 @@
+#include "unity/unity.h"
+#include "../cpu.h"
+
+void RTS_test(void) {
+    CPU cpu;
+    initCPU(&cpu);
+    cpu.SP = STACK_BASE - 1;
+    cpu.memory[STACK_BASE] = 0x13;
+    cpu.PC = 0x40;
+    // RTS ; PC = memory[$FF] = $13, SP = $FF
+    cpu.memory[0x40] = OPCODE_RTS;
+    TEST_ASSERT_EQUAL_INT(CPU_OK, cpu_step(&cpu));
+    TEST_ASSERT_EQUAL_UINT8(0x13, cpu.PC);
+    TEST_ASSERT_EQUAL_UINT8(STACK_BASE, cpu.SP);
+
+    // Empty stack: halts
+    initCPU(&cpu);
+    cpu.memory[0] = OPCODE_RTS;
+    TEST_ASSERT_EQUAL_INT(CPU_HALTED, cpu_step(&cpu));
+    TEST_ASSERT_EQUAL_UINT8(STACK_BASE, cpu.SP);
+}
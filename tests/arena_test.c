@@ -0,0 +1,56 @@
+#include "unity/unity.h"
+#include "../cpu_arena.h"
+
+void arena_test(void) {
+    // Test 1: Create, aligned slab, full free list
+    CPUArena *arena = vm8_arena_create(1000, -1);
+    TEST_ASSERT_NOT_NULL(arena);
+    TEST_ASSERT_EQUAL_UINT(1000, arena->free_count);
+    TEST_ASSERT_EQUAL_INT(-1, arena->numa_node);
+    TEST_ASSERT_EQUAL_UINT(0, (uintptr_t)arena->slab % 64);
+
+    // Test 2: Bulk init gives the initCPU state
+    CPU expected;
+    initCPU(&expected);
+    memset(arena->slab, 0xA5, 10 * sizeof(CPU));
+    vm8_arena_init(arena, 0, arena->count);
+    TEST_ASSERT_EQUAL_MEMORY(&expected, vm8_arena_at(arena, 0), sizeof(CPU));
+    TEST_ASSERT_EQUAL_MEMORY(&expected, vm8_arena_at(arena, 9), sizeof(CPU));
+    TEST_ASSERT_EQUAL_MEMORY(&expected, vm8_arena_at(arena, 999), sizeof(CPU));
+
+    // Test 3: Acquire in address order until exhausted
+    CPU *first = vm8_arena_acquire(arena);
+    TEST_ASSERT_TRUE(first == vm8_arena_at(arena, 0));
+    TEST_ASSERT_TRUE(vm8_arena_acquire(arena) == vm8_arena_at(arena, 1));
+    for (int i = 2; i < 1000; i++)
+        TEST_ASSERT_NOT_NULL(vm8_arena_acquire(arena));
+    TEST_ASSERT_NULL(vm8_arena_acquire(arena));
+    TEST_ASSERT_EQUAL_UINT(0, arena->free_count);
+
+    // Test 4: Release is LIFO, released instances are reused first
+    vm8_arena_release(arena, vm8_arena_at(arena, 500));
+    vm8_arena_release(arena, first);
+    TEST_ASSERT_EQUAL_UINT(2, arena->free_count);
+    TEST_ASSERT_TRUE(vm8_arena_acquire(arena) == first);
+    TEST_ASSERT_TRUE(vm8_arena_acquire(arena) == vm8_arena_at(arena, 500));
+    TEST_ASSERT_NULL(vm8_arena_acquire(arena));
+
+    // Test 5: Acquired instances run as usual
+    CPU *cpu = vm8_arena_at(arena, 42);
+    initCPU(cpu);
+    cpu->memory[0] = OPCODE_LDA;
+    cpu->memory[1] = MODE_IMMEDIAT;
+    cpu->memory[2] = 0x33;
+    cpu->memory[3] = OPCODE_HALT;
+    while (cpu_step(cpu) == CPU_OK) {
+    }
+    TEST_ASSERT_EQUAL_UINT8(0x33, cpu->A);
+    vm8_arena_destroy(arena);
+
+    // Test 6: NUMA binding is best effort, bad sizes are rejected
+    arena = vm8_arena_create(16, 0);
+    TEST_ASSERT_NOT_NULL(arena);
+    TEST_ASSERT_TRUE(arena->numa_node == 0 || arena->numa_node == -1);
+    vm8_arena_destroy(arena);
+    TEST_ASSERT_NULL(vm8_arena_create(0, -1));
+}
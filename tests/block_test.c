@@ -0,0 +1,233 @@
+#include "unity/unity.h"
+#include "../cpu_block.h"
+
+static void assert_same_state(const CPU *ref, const CPU *cpu) {
+    TEST_ASSERT_EQUAL_UINT8(ref->A, cpu->A);
+    TEST_ASSERT_EQUAL_UINT8(ref->X, cpu->X);
+    TEST_ASSERT_EQUAL_UINT8(ref->PC, cpu->PC);
+    TEST_ASSERT_EQUAL_UINT8(ref->SP, cpu->SP);
+    TEST_ASSERT_EQUAL_UINT8(ref->flags, cpu->flags);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(ref->memory, cpu->memory, MAX_MEMORY_SIZE);
+}
+
+void block_test(void) {
+    CPU tmpl, cpu, ref;
+    uint64_t retired = 0, expected = 0;
+    CPUBlockCache *cache = cpu_block_cache_create();
+    TEST_ASSERT_NOT_NULL(cache);
+
+    // Immediate chains fold away; the loop body mixes folded and real ops
+    initCPU(&tmpl);
+    tmpl.memory[0xF0] = 10;
+    uint8_t program[] = {
+        OPCODE_LDA, MODE_IMMEDIAT, 1,
+        OPCODE_ADD, MODE_IMMEDIAT, 7,
+        OPCODE_SUB, MODE_IMMEDIAT, 3,
+        OPCODE_SHL, MODE_REGISTER, 0,
+        OPCODE_ROL, MODE_REGISTER, 0,
+        OPCODE_STA, MODE_ABSOLUTE, 0xF1,
+        OPCODE_LDX, MODE_ABSOLUTE, 0xF0,   // 18: loop
+        OPCODE_DEX, 0, 0,
+        OPCODE_STX, MODE_ABSOLUTE, 0xF0,
+        OPCODE_ADD, MODE_ABSOLUTE, 0xF1,
+        OPCODE_CPX, MODE_IMMEDIAT, 0,
+        OPCODE_B, COND_NE, 18,
+        OPCODE_HALT, 0, 0,
+    };
+    memcpy(tmpl.memory, program, sizeof(program));
+    ref = tmpl;
+    do {
+        expected++;
+    } while (cpu_step(&ref) == CPU_OK);
+
+    cpu = tmpl;
+    TEST_ASSERT_EQUAL_INT(CPU_HALTED,
+                          cpu_run_blocks(&cpu, cache, UINT64_MAX, &retired));
+    TEST_ASSERT_EQUAL_UINT64(expected, retired);
+    assert_same_state(&ref, &cpu);
+    TEST_ASSERT_EQUAL_UINT64(5, cache->folded); // LDA, ADD, SUB, SHL, ROL
+
+    // The first block sets A and the flags once, before the STA
+    const CPUBlock *block = &cache->block[0];
+    TEST_ASSERT_TRUE(block->valid);
+    TEST_ASSERT_EQUAL_UINT(12, block->steps);
+    TEST_ASSERT_EQUAL_INT(BLOCK_OP_SET, block->op[0].kind);
+    TEST_ASSERT_EQUAL_UINT8(5, block->op[0].retire);
+    TEST_ASSERT_EQUAL_UINT8(BLOCK_REG_A, block->op[0].regs);
+    TEST_ASSERT_EQUAL_UINT8(ref.memory[0xF1], block->op[0].a);
+    TEST_ASSERT_EQUAL_INT(BLOCK_OP_GUEST, block->op[1].kind);
+    TEST_ASSERT_EQUAL_UINT8(OPCODE_STA, block->op[1].opcode);
+
+    // Already halted: nothing runs
+    TEST_ASSERT_EQUAL_INT(CPU_HALTED, cpu_run_blocks(&cpu, cache, 10, &retired));
+    TEST_ASSERT_EQUAL_UINT64(0, retired);
+
+    // Any budget stops after exactly that many instructions, same state
+    for (uint64_t budget = 1; budget < expected; budget += 3) {
+        CPU step = tmpl;
+        for (uint64_t i = 0; i < budget; i++)
+            cpu_step(&step);
+        cpu = tmpl;
+        TEST_ASSERT_EQUAL_INT(CPU_OK,
+                              cpu_run_blocks(&cpu, cache, budget, &retired));
+        TEST_ASSERT_EQUAL_UINT64(budget, retired);
+        assert_same_state(&step, &cpu);
+    }
+
+    // Halt inside a block (stack overflow on PUSH) keeps folded values
+    cpu_block_cache_reset(cache);
+    initCPU(&cpu);
+    uint8_t overflow[] = {
+        OPCODE_LDX, MODE_IMMEDIAT, 4,
+        OPCODE_INX, 0, 0,
+        OPCODE_PUSH, MODE_REGISTER, STACK_REGS_ALL,
+        OPCODE_NOP, 0, 0,
+    };
+    memcpy(cpu.memory, overflow, sizeof(overflow));
+    cpu.SP = STACK_LIMIT + 1; // Room for two bytes
+    ref = cpu;
+    expected = 0;
+    do {
+        expected++;
+    } while (cpu_step(&ref) == CPU_OK);
+    TEST_ASSERT_EQUAL_INT(CPU_HALTED,
+                          cpu_run_blocks(&cpu, cache, UINT64_MAX, &retired));
+    TEST_ASSERT_EQUAL_UINT64(3, retired);
+    TEST_ASSERT_EQUAL_UINT64(expected, retired);
+    assert_same_state(&ref, &cpu);
+
+    // A store into translated code drops that block and runs the new code
+    cpu_block_cache_reset(cache);
+    initCPU(&cpu);
+    uint8_t patch[] = {
+        OPCODE_LDA, MODE_IMMEDIAT, 42,
+        OPCODE_STA, MODE_ABSOLUTE, 11,      // Patches the LDA operand below
+        OPCODE_LDA, MODE_IMMEDIAT, 0,       // 6
+        OPCODE_LDA, MODE_IMMEDIAT, 9,       // 9: becomes LDA #42
+        OPCODE_HALT, 0, 0,
+    };
+    memcpy(cpu.memory, patch, sizeof(patch));
+    ref = cpu;
+    while (cpu_step(&ref) == CPU_OK) {
+    }
+    TEST_ASSERT_EQUAL_INT(CPU_HALTED,
+                          cpu_run_blocks(&cpu, cache, UINT64_MAX, &retired));
+    TEST_ASSERT_EQUAL_UINT64(5, retired);
+    TEST_ASSERT_EQUAL_UINT8(42, cpu.A);
+    TEST_ASSERT_EQUAL_UINT64(1, cache->invalidations);
+    assert_same_state(&ref, &cpu);
+
+    // Only the blocks covering the written byte go, not the page's others
+    cpu_block_cache_reset(cache);
+    initCPU(&cpu);
+    uint8_t pages[] = {
+        OPCODE_LDA, MODE_IMMEDIAT, 7,      // 0: operand patched below
+        OPCODE_JMP, MODE_ABSOLUTE, 0x30,
+    };
+    uint8_t patcher[] = {
+        OPCODE_STA, MODE_ABSOLUTE, 0x3E,   // 0x30: page 3, no code there
+        OPCODE_STA, MODE_ABSOLUTE, 0x02,   // Into the block at 0
+        OPCODE_JMP, MODE_ABSOLUTE, 0x40,
+    };
+    uint8_t tail[] = {
+        OPCODE_LDX, MODE_ABSOLUTE, 0x02,   // 0x40
+        OPCODE_HALT, 0, 0,
+    };
+    memcpy(cpu.memory, pages, sizeof(pages));
+    memcpy(cpu.memory + 0x30, patcher, sizeof(patcher));
+    memcpy(cpu.memory + 0x40, tail, sizeof(tail));
+    ref = cpu;
+    while (cpu_step(&ref) == CPU_OK) {
+    }
+    TEST_ASSERT_EQUAL_INT(CPU_HALTED,
+                          cpu_run_blocks(&cpu, cache, UINT64_MAX, &retired));
+    assert_same_state(&ref, &cpu);
+    TEST_ASSERT_EQUAL_UINT8(7, cpu.X);
+    TEST_ASSERT_EQUAL_UINT64(1, cache->invalidations);
+    TEST_ASSERT_EQUAL_UINT64(1, cache->generation);
+    TEST_ASSERT_FALSE(cache->block[0].valid);
+    TEST_ASSERT_TRUE(cache->block[0x30].valid);
+    TEST_ASSERT_TRUE(cache->block[0x40].valid);
+    TEST_ASSERT_EQUAL_HEX32((1u << 3) | (1u << 4), cache->code_pages);
+
+    // The embedder patches code through cpu_block_invalidate
+    TEST_ASSERT_EQUAL_UINT(0, cpu_block_invalidate(cache, 0x3E));
+    TEST_ASSERT_EQUAL_UINT(1, cpu_block_invalidate(cache, 0x43));
+    TEST_ASSERT_FALSE(cache->block[0x40].valid);
+    TEST_ASSERT_EQUAL_HEX32(1u << 3, cache->code_pages);
+
+    // Flags overwritten before any read are not computed; live ones are
+    cpu_block_cache_reset(cache);
+    initCPU(&cpu);
+    cpu.memory[0xF0] = 0x90;
+    cpu.memory[0xF1] = 0x81;
+    cpu.memory[0xF2] = 0x20;
+    cpu.memory[0xF3] = 0x11;
+    cpu.memory[0xF4] = 0x80;
+    cpu.memory[0xF5] = 0x7F;
+    uint8_t dead[] = {
+        OPCODE_LDX, MODE_ABSOLUTE, 0xF4,   // Dead: LDA overwrites Z, N
+        OPCODE_LDA, MODE_ABSOLUTE, 0xF0,   // Dead
+        OPCODE_ADD, MODE_ABSOLUTE, 0xF1,   // Dead: SUB overwrites all
+        OPCODE_SUB, MODE_ABSOLUTE, 0xF2,   // Live: ROL reads C
+        OPCODE_ROL, MODE_REGISTER, 0,      // Dead
+        OPCODE_CMP, MODE_ABSOLUTE, 0xF3,   // Dead: CPX overwrites all
+        OPCODE_CPX, MODE_ABSOLUTE, 0xF5,   // Live at the STA
+        OPCODE_STA, MODE_ABSOLUTE, 0xF6,
+        OPCODE_HALT, 0, 0,
+    };
+    memcpy(cpu.memory, dead, sizeof(dead));
+    ref = cpu;
+    while (cpu_step(&ref) == CPU_OK) {
+    }
+    TEST_ASSERT_EQUAL_INT(CPU_HALTED,
+                          cpu_run_blocks(&cpu, cache, UINT64_MAX, &retired));
+    TEST_ASSERT_EQUAL_UINT64(9, retired);
+    assert_same_state(&ref, &cpu);
+    TEST_ASSERT_EQUAL_UINT64(5, cache->dead_flags);
+    block = &cache->block[0];
+    const uint8_t kinds[] = {
+        BLOCK_OP_NOFLAGS, BLOCK_OP_NOFLAGS, BLOCK_OP_NOFLAGS, BLOCK_OP_GUEST,
+        BLOCK_OP_NOFLAGS, BLOCK_OP_SET,     BLOCK_OP_GUEST,   BLOCK_OP_GUEST,
+        BLOCK_OP_GUEST,
+    };
+    TEST_ASSERT_EQUAL_UINT(sizeof(kinds), block->count);
+    for (unsigned i = 0; i < sizeof(kinds); i++)
+        TEST_ASSERT_EQUAL_UINT8(kinds[i], block->op[i].kind);
+
+    // Undefined instructions go through cpu_step and halt like it
+    cpu_block_cache_reset(cache);
+    initCPU(&cpu);
+    cpu.memory[0] = OPCODE_COUNT;
+    ref = cpu;
+    cpu_step(&ref);
+    TEST_ASSERT_EQUAL_INT(CPU_HALTED,
+                          cpu_run_blocks(&cpu, cache, UINT64_MAX, &retired));
+    TEST_ASSERT_EQUAL_UINT64(1, retired);
+    TEST_ASSERT_EQUAL_UINT(0, cache->block[0].steps);
+    assert_same_state(&ref, &cpu);
+
+    // JSR #$FD is not in the mode table but cpu_step runs it: its push
+    // (at SP = 0xFF) overwrites the branch block at 0xFD
+    cpu_block_cache_reset(cache);
+    initCPU(&cpu);
+    cpu.memory[0xFD] = OPCODE_B;
+    cpu.memory[0xFE] = COND_AL;
+    cpu.memory[0xFF] = 0x10;
+    cpu.memory[0x10] = OPCODE_JSR;
+    cpu.memory[0x11] = MODE_IMMEDIAT;
+    cpu.memory[0x12] = 0xFD;
+    cpu.memory[0x13] = OPCODE_HALT;
+    cpu.PC = 0xFD;
+    ref = cpu;
+    expected = 0;
+    while (cpu_step(&ref) == CPU_OK)
+        expected++;
+    TEST_ASSERT_EQUAL_UINT64(3, expected); // B, JSR, B $13 (patched by JSR)
+    TEST_ASSERT_EQUAL_INT(CPU_HALTED,
+                          cpu_run_blocks(&cpu, cache, 100, &retired));
+    TEST_ASSERT_EQUAL_UINT64(expected + 1, retired);
+    assert_same_state(&ref, &cpu);
+
+    cpu_block_cache_destroy(cache);
+}
@@ -26,6 +26,25 @@ extern void SHL_test(void);
 extern void INX_test(void);
 extern void DEX_test(void);
 extern void edge_cases_test(void);
+extern void debug_test(void);
+extern void tailcall_test(void);
+extern void run_fast_test(void);
+extern void verify_test(void);
+extern void fleet_test(void);
+extern void arena_test(void);
+extern void reset_test(void);
+extern void sched_test(void);
+extern void JSR_test(void);
+extern void RTS_test(void);
+extern void stack_test(void);
+extern void JMP_test(void);
+extern void dispatch_test(void);
+extern void packed_v2_test(void);
+extern void block_test(void);
+extern void MOVE_test(void);
+extern void FILL_test(void);
+extern void profile_test(void);
+extern void metrics_test(void);
 
 int main(void) {
     printf("\nStart tests...\n\n");
@@ -54,5 +73,24 @@ int main(void) {
     RUN_TEST(INX_test);
     RUN_TEST(DEX_test);
     RUN_TEST(edge_cases_test);
+    RUN_TEST(debug_test);
+    RUN_TEST(tailcall_test);
+    RUN_TEST(run_fast_test);
+    RUN_TEST(verify_test);
+    RUN_TEST(fleet_test);
+    RUN_TEST(arena_test);
+    RUN_TEST(reset_test);
+    RUN_TEST(sched_test);
+    RUN_TEST(JSR_test);
+    RUN_TEST(RTS_test);
+    RUN_TEST(stack_test);
+    RUN_TEST(JMP_test);
+    RUN_TEST(dispatch_test);
+    RUN_TEST(packed_v2_test);
+    RUN_TEST(block_test);
+    RUN_TEST(MOVE_test);
+    RUN_TEST(FILL_test);
+    RUN_TEST(profile_test);
+    RUN_TEST(metrics_test);
     return UNITY_END();
 }
@@ -0,0 +1,124 @@
+#include "unity/unity.h"
+#include "../cpu_debug.h"
+
+void debug_test(void) {
+    CPU cpu;
+    CPUDebug dbg;
+
+    // Test 1: PC breakpoint stops before the instruction executes
+    initCPU(&cpu);
+    cpu_debug_init(&dbg);
+    cpu.PC = 0;
+    cpu.memory[0] = OPCODE_LDA;
+    cpu.memory[1] = MODE_IMMEDIAT;
+    cpu.memory[2] = 0x42;
+    cpu.memory[3] = OPCODE_HALT;
+    cpu_debug_set_breakpoint(&dbg, 0x00);
+    TEST_ASSERT_EQUAL_INT(CPU_BREAK, cpu_step_debug(&cpu, &dbg));
+    TEST_ASSERT_EQUAL_UINT8(DEBUG_STOP_BREAKPOINT, dbg.stop_reason);
+    TEST_ASSERT_EQUAL_UINT8(0x00, dbg.stop_pc);
+    TEST_ASSERT_EQUAL_UINT8(0x00, cpu.PC);   // Not executed yet
+    TEST_ASSERT_EQUAL_UINT8(0x00, cpu.A);
+
+    // Stepping again resumes past the breakpoint
+    TEST_ASSERT_EQUAL_INT(CPU_OK, cpu_step_debug(&cpu, &dbg));
+    TEST_ASSERT_EQUAL_UINT8(0x42, cpu.A);
+    TEST_ASSERT_EQUAL_UINT8(0x03, cpu.PC);
+
+    // Test 2: Write watchpoint catches the STA that corrupts a byte
+    initCPU(&cpu);
+    cpu_debug_init(&dbg);
+    cpu.PC = 0;
+    cpu.memory[0] = OPCODE_LDA;  // LDA #$99
+    cpu.memory[1] = MODE_IMMEDIAT;
+    cpu.memory[2] = 0x99;
+    cpu.memory[3] = OPCODE_STA;  // STA $80 (not watched)
+    cpu.memory[4] = MODE_ABSOLUTE;
+    cpu.memory[5] = 0x80;
+    cpu.memory[6] = OPCODE_STA;  // STA $80,X with X = 4 -> $84 (watched)
+    cpu.memory[7] = MODE_ABSOLUTE_X;
+    cpu.memory[8] = 0x80;
+    cpu.memory[9] = OPCODE_HALT;
+    cpu.X = 4;
+    cpu_debug_set_watch(&dbg, 0x84, WATCH_WRITE);
+    TEST_ASSERT_EQUAL_INT(CPU_BREAK, cpu_run_debug(&cpu, &dbg));
+    TEST_ASSERT_EQUAL_UINT8(DEBUG_STOP_WRITE, dbg.stop_reason);
+    TEST_ASSERT_EQUAL_UINT8(0x84, dbg.stop_addr);
+    TEST_ASSERT_EQUAL_UINT8(0x06, dbg.stop_pc);
+    TEST_ASSERT_EQUAL_UINT8(0x99, cpu.memory[0x80]);
+    TEST_ASSERT_EQUAL_UINT8(0x00, cpu.memory[0x84]);  // Not yet written
+    TEST_ASSERT_EQUAL_INT(CPU_HALTED, cpu_run_debug(&cpu, &dbg));
+    TEST_ASSERT_EQUAL_UINT8(0x99, cpu.memory[0x84]);
+
+    // Test 3: Read watchpoint on the pointer byte of an indirect load
+    initCPU(&cpu);
+    cpu_debug_init(&dbg);
+    cpu.PC = 0;
+    cpu.memory[0] = OPCODE_LDA;  // LDA ($40)
+    cpu.memory[1] = MODE_INDIRECT;
+    cpu.memory[2] = 0x40;
+    cpu.memory[0x40] = 0x50;
+    cpu.memory[0x50] = 0x77;
+    cpu_debug_set_watch(&dbg, 0x40, WATCH_READ);
+    TEST_ASSERT_EQUAL_INT(CPU_BREAK, cpu_step_debug(&cpu, &dbg));
+    TEST_ASSERT_EQUAL_UINT8(DEBUG_STOP_READ, dbg.stop_reason);
+    TEST_ASSERT_EQUAL_UINT8(0x40, dbg.stop_addr);
+
+    // Clearing the watchpoint lets the load through
+    cpu_debug_clear_watch(&dbg, 0x40, WATCH_READ);
+    dbg.resume = 0;
+    TEST_ASSERT_EQUAL_INT(CPU_OK, cpu_step_debug(&cpu, &dbg));
+    TEST_ASSERT_EQUAL_UINT8(0x77, cpu.A);
+
+    // Test 4: Read-modify-write triggers a read watchpoint first
+    initCPU(&cpu);
+    cpu_debug_init(&dbg);
+    cpu.PC = 0;
+    cpu.memory[0] = OPCODE_ROL;
+    cpu.memory[1] = MODE_ABSOLUTE;
+    cpu.memory[2] = 0x60;
+    cpu_debug_set_watch(&dbg, 0x60, WATCH_READ | WATCH_WRITE);
+    TEST_ASSERT_EQUAL_INT(CPU_BREAK, cpu_step_debug(&cpu, &dbg));
+    TEST_ASSERT_EQUAL_UINT8(DEBUG_STOP_READ, dbg.stop_reason);
+
+    // Test 5: PUSH is a write to the stack slot
+    initCPU(&cpu);
+    cpu_debug_init(&dbg);
+    cpu.PC = 0;
+    cpu.A = 0x11;
+    cpu.memory[0] = OPCODE_PUSH;
+    cpu_debug_set_watch(&dbg, STACK_BASE, WATCH_WRITE);
+    TEST_ASSERT_EQUAL_INT(CPU_BREAK, cpu_step_debug(&cpu, &dbg));
+    TEST_ASSERT_EQUAL_UINT8(DEBUG_STOP_WRITE, dbg.stop_reason);
+    TEST_ASSERT_EQUAL_UINT8(STACK_BASE, dbg.stop_addr);
+    TEST_ASSERT_EQUAL_INT(CPU_OK, cpu_step_debug(&cpu, &dbg));
+    TEST_ASSERT_EQUAL_UINT8(0x11, cpu.memory[STACK_BASE]);
+
+    // Test 6: Without traps the debug engine behaves like cpu_step
+    initCPU(&cpu);
+    cpu_debug_init(&dbg);
+    cpu.PC = 0;
+    cpu.memory[0] = OPCODE_LDA;
+    cpu.memory[1] = 0xFF;  // Invalid mode
+    TEST_ASSERT_EQUAL_INT(CPU_HALTED, cpu_step_debug(&cpu, &dbg));
+    TEST_ASSERT_TRUE(cpu.flags & FLAG_HALTED);
+
+    // Test 7: The debugger moves PC while stopped: a breakpoint at the new
+    // PC still stops, it is not stepped over with the old stop
+    initCPU(&cpu);
+    cpu_debug_init(&dbg);
+    cpu.PC = 0;
+    cpu.memory[0] = OPCODE_HALT;
+    cpu.memory[3] = OPCODE_LDA;
+    cpu.memory[4] = MODE_IMMEDIAT;
+    cpu.memory[5] = 0x42;
+    cpu_debug_set_breakpoint(&dbg, 0x00);
+    cpu_debug_set_breakpoint(&dbg, 0x03);
+    TEST_ASSERT_EQUAL_INT(CPU_BREAK, cpu_step_debug(&cpu, &dbg));
+    cpu.PC = 0x03;
+    TEST_ASSERT_EQUAL_INT(CPU_BREAK, cpu_step_debug(&cpu, &dbg));
+    TEST_ASSERT_EQUAL_UINT8(0x03, dbg.stop_pc);
+    TEST_ASSERT_EQUAL_UINT8(0x00, cpu.A);
+    TEST_ASSERT_EQUAL_INT(CPU_OK, cpu_step_debug(&cpu, &dbg));
+    TEST_ASSERT_EQUAL_UINT8(0x42, cpu.A);
+}
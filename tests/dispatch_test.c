@@ -0,0 +1,71 @@
+#include "unity/unity.h"
+#include "../cpu_dispatch.h"
+
+void dispatch_test(void) {
+    CPU tmpl, cpu, ref;
+    uint64_t retired = 0, expected = 0;
+
+    // Count X down from 20, accumulating into A
+    initCPU(&tmpl);
+    uint8_t program[] = {
+        OPCODE_LDX, MODE_IMMEDIAT, 20,
+        OPCODE_ADD, MODE_IMMEDIAT, 3,       // 3: loop
+        OPCODE_DEX, 0, 0,
+        OPCODE_CPX, MODE_IMMEDIAT, 0,
+        OPCODE_B, COND_NE, 3,
+        OPCODE_HALT, 0, 0,
+    };
+    memcpy(tmpl.memory, program, sizeof(program));
+    ref = tmpl;
+    do {
+        expected++;
+    } while (cpu_step(&ref) == CPU_OK);
+
+    // The baseline always exists; the selected variant is one the host runs
+    TEST_ASSERT_TRUE(cpu_isa_supported(CPU_ISA_BASELINE));
+    TEST_ASSERT_NOT_NULL(cpu_engines_isa(CPU_ISA_BASELINE));
+    TEST_ASSERT_NULL(cpu_engines_isa(CPU_ISA_COUNT));
+    const CPUEngines *best = cpu_engines();
+    TEST_ASSERT_NOT_NULL(best);
+    TEST_ASSERT_TRUE(cpu_isa_supported(best->isa));
+    TEST_ASSERT_EQUAL_PTR(best, cpu_engines());
+
+    // Every supported variant runs the program like cpu_step
+    for (int isa = 0; isa < CPU_ISA_COUNT; isa++) {
+        const CPUEngines *engines = cpu_engines_isa((CPUIsa)isa);
+        if (!engines)
+            continue;
+        TEST_ASSERT_EQUAL_INT(isa, engines->isa);
+
+        const cpu_run_fn runs[2] = {engines->run_step, engines->run_fast};
+        for (int r = 0; r < 2; r++) {
+            cpu = tmpl;
+            TEST_ASSERT_EQUAL_INT(CPU_HALTED, runs[r](&cpu, UINT64_MAX, &retired));
+            TEST_ASSERT_EQUAL_UINT64(expected, retired);
+            TEST_ASSERT_EQUAL_UINT8(ref.A, cpu.A);
+            TEST_ASSERT_EQUAL_UINT8(ref.X, cpu.X);
+            TEST_ASSERT_EQUAL_UINT8(ref.PC, cpu.PC);
+            TEST_ASSERT_EQUAL_UINT8(ref.flags, cpu.flags);
+
+            // Budget runs out before the HALT
+            cpu = tmpl;
+            TEST_ASSERT_EQUAL_INT(CPU_OK, runs[r](&cpu, 5, &retired));
+            TEST_ASSERT_EQUAL_UINT64(5, retired);
+        }
+
+        // Packed image: LDA #7, INX, HALT
+        cpu = tmpl;
+        uint8_t packed[] = {
+            PACK_INST_BYTE(OPCODE_LDA, MODE_IMMEDIAT), 7,
+            PACK_INST_BYTE(OPCODE_INX, 0), 0,
+            PACK_INST_BYTE(OPCODE_HALT, 0), 0,
+        };
+        memcpy(cpu.memory, packed, sizeof(packed));
+        cpu.X = 0;
+        TEST_ASSERT_EQUAL_INT(CPU_HALTED,
+                              engines->run_packed(&cpu, UINT64_MAX, &retired));
+        TEST_ASSERT_EQUAL_UINT64(3, retired);
+        TEST_ASSERT_EQUAL_UINT8(7, cpu.A);
+        TEST_ASSERT_EQUAL_UINT8(1, cpu.X);
+    }
+}
@@ -34,17 +34,24 @@ void edge_cases_test(void) {
     TEST_ASSERT_EQUAL_INT(CPU_HALTED, cpu_step(&cpu));
     TEST_ASSERT_TRUE(cpu.flags & FLAG_HALTED);
 
-    // Test 3: Invalid branch conditions should not crash (currently no validation)
+    // Test 3: Invalid branch conditions are rejected at decode time
     initCPU(&cpu);
     cpu.PC = 0;
     cpu.memory[0] = OPCODE_B;
     cpu.memory[1] = 0xFF;  // Invalid condition (only 0-6 are valid)
     cpu.memory[2] = 0x10;
-    // This should either handle gracefully or set error flag
     int result3 = cpu_step(&cpu);
-    // Current implementation doesn't validate, so it won't branch (default case)
-    TEST_ASSERT_EQUAL_INT(CPU_OK, result3);
-    TEST_ASSERT_EQUAL_UINT8(3, cpu.PC);  // Should advance normally
+    TEST_ASSERT_EQUAL_INT(CPU_HALTED, result3);
+    TEST_ASSERT_TRUE(cpu.flags & FLAG_HALTED);
+    TEST_ASSERT_EQUAL_UINT8(3, cpu.PC);  // Instruction consumed, no branch
+
+    // First invalid condition (COND_COUNT) halts the packed decoder as well
+    initCPU(&cpu);
+    cpu.PC = 0;
+    cpu.memory[0] = PACK_INST_BYTE(OPCODE_B, COND_COUNT);
+    cpu.memory[1] = 0x10;
+    TEST_ASSERT_EQUAL_INT(CPU_HALTED, cpu_step_packed(&cpu));
+    TEST_ASSERT_EQUAL_UINT8(1, cpu.PC);  // Operand not fetched, as for modes
 
     // Test 4: Memory wraparound in indexed addressing
     initCPU(&cpu);
@@ -0,0 +1,136 @@
+#include "unity/unity.h"
+#include "../cpu_fleet.h"
+
+void fleet_test(void) {
+    CPUFleet fleet;
+    CPU image, scratch, ref;
+    uint64_t retired;
+
+    // Countdown from memory[0xF0], result (counter * 3) stored in 0xF1
+    initCPU(&image);
+    uint8_t program[] = {
+        OPCODE_LDX, MODE_ABSOLUTE, 0xF0,
+        OPCODE_LDA, MODE_IMMEDIAT, 0,
+        OPCODE_ADD, MODE_IMMEDIAT, 3,      // Loop
+        OPCODE_DEX, 0, 0,
+        OPCODE_CPX, MODE_IMMEDIAT, 0,
+        OPCODE_B, COND_NE, 6,
+        OPCODE_STA, MODE_ABSOLUTE, 0xF1,
+        OPCODE_PUSH, 0, 0,
+        OPCODE_HALT, 0, 0,
+    };
+    memcpy(image.memory, program, sizeof(program));
+
+    // Test 1: Layout and reset state
+    TEST_ASSERT_EQUAL_INT(0, cpu_fleet_init(&fleet, 4, 0xF0));
+    TEST_ASSERT_EQUAL_UINT(16, fleet.stride);
+    TEST_ASSERT_EQUAL_UINT(21, cpu_fleet_bytes_per_instance(&fleet));
+    TEST_ASSERT_EQUAL_UINT8(STACK_BASE, cpu_fleet_regs(&fleet, 3)->SP);
+    cpu_fleet_set_code(&fleet, image.memory);
+
+    // Test 2: Every instance runs with its own data, same as a plain CPU
+    for (size_t i = 0; i < fleet.count; i++)
+        cpu_fleet_data(&fleet, i)[0] = (uint8_t)(i + 2); // Guest 0xF0
+    for (size_t i = 0; i < fleet.count; i++) {
+        TEST_ASSERT_EQUAL_INT(CPU_HALTED,
+                              cpu_fleet_run(&fleet, i, &scratch, 1000, NULL));
+    }
+    for (size_t i = 0; i < fleet.count; i++) {
+        ref = image;
+        ref.memory[0xF0] = (uint8_t)(i + 2);
+        while (cpu_step(&ref) == CPU_OK) {
+        }
+        cpu_fleet_load(&fleet, i, &scratch);
+        TEST_ASSERT_EQUAL_UINT8(ref.A, scratch.A);
+        TEST_ASSERT_EQUAL_UINT8(ref.PC, scratch.PC);
+        TEST_ASSERT_EQUAL_UINT8(ref.SP, scratch.SP);
+        TEST_ASSERT_EQUAL_UINT8(ref.flags, scratch.flags);
+        TEST_ASSERT_EQUAL_UINT8_ARRAY(ref.memory, scratch.memory,
+                                      MAX_MEMORY_SIZE);
+        TEST_ASSERT_EQUAL_UINT8((i + 2) * 3, cpu_fleet_data(&fleet, i)[1]);
+    }
+
+    // Test 3: Budgeted run resumes from the stored registers
+    cpu_fleet_regs(&fleet, 0)->PC = 0;
+    cpu_fleet_regs(&fleet, 0)->flags = 0;
+    cpu_fleet_regs(&fleet, 0)->SP = STACK_BASE;
+    TEST_ASSERT_EQUAL_INT(CPU_OK, cpu_fleet_run(&fleet, 0, &scratch, 2,
+                                                &retired));
+    TEST_ASSERT_EQUAL_UINT64(2, retired);
+    TEST_ASSERT_EQUAL_UINT8(6, cpu_fleet_regs(&fleet, 0)->PC);
+    TEST_ASSERT_EQUAL_INT(CPU_HALTED, cpu_fleet_run(&fleet, 0, &scratch, 1000,
+                                                    NULL));
+
+    // Test 4: A write into the code region copies the image for that
+    // instance only (copy-on-write)
+    cpu_fleet_load(&fleet, 1, &scratch);
+    scratch.memory[8] = 5; // ADD #5 instead of ADD #3
+    scratch.PC = 0;
+    scratch.flags = 0;
+    scratch.SP = STACK_BASE;
+    TEST_ASSERT_EQUAL_INT(CPU_OK, cpu_fleet_store(&fleet, 1, &scratch));
+    TEST_ASSERT_TRUE(cpu_fleet_image(&fleet, 1) != fleet.image);
+    TEST_ASSERT_TRUE(cpu_fleet_image(&fleet, 2) == fleet.image);
+    TEST_ASSERT_EQUAL_UINT8(3, fleet.image->code[8]);
+    TEST_ASSERT_EQUAL_INT(CPU_HALTED,
+                          cpu_fleet_run(&fleet, 1, &scratch, 1000, NULL));
+    TEST_ASSERT_EQUAL_UINT8(3 * 5, cpu_fleet_data(&fleet, 1)[1]);
+    cpu_fleet_load(&fleet, 2, &scratch);
+    TEST_ASSERT_EQUAL_UINT8(3, scratch.memory[8]);
+
+    // Test 5: Fleets share one image and its cached verification
+    CPUImage *image_ref = cpu_fleet_image(&fleet, 0);
+    CPUFleet other;
+    TEST_ASSERT_EQUAL_INT(0, cpu_fleet_init_shared(&other, 2, image_ref));
+    TEST_ASSERT_EQUAL_UINT(2, image_ref->refs);
+    cpu_fleet_load(&other, 0, &scratch);
+    TEST_ASSERT_TRUE(cpu_image_step(image_ref, &scratch) ==
+                     cpu_step_unchecked);
+    TEST_ASSERT_TRUE(image_ref->verified);
+    scratch.PC = 3; // Not the verified entry point
+    TEST_ASSERT_TRUE(cpu_image_step(image_ref, &scratch) == cpu_step);
+    cpu_fleet_free(&fleet);
+    TEST_ASSERT_EQUAL_UINT(1, image_ref->refs);
+    cpu_fleet_free(&other);
+
+    // Test 6: split = 0 shares nothing, code may be modified per instance
+    TEST_ASSERT_EQUAL_INT(0, cpu_fleet_init(&fleet, 2, 0));
+    TEST_ASSERT_EQUAL_UINT(5 + MAX_MEMORY_SIZE,
+                           cpu_fleet_bytes_per_instance(&fleet));
+    memcpy(cpu_fleet_data(&fleet, 1), image.memory, MAX_MEMORY_SIZE);
+    cpu_fleet_data(&fleet, 1)[0xF0] = 1;
+    TEST_ASSERT_EQUAL_INT(CPU_HALTED,
+                          cpu_fleet_run(&fleet, 1, &scratch, 1000, NULL));
+    TEST_ASSERT_EQUAL_UINT8(3, cpu_fleet_data(&fleet, 1)[0xF1]);
+    TEST_ASSERT_EQUAL_UINT8(0, cpu_fleet_data(&fleet, 0)[0xF1]);
+    cpu_fleet_free(&fleet);
+
+    // Test 7: A JMP [$a] pointer in per-instance data is not covered by
+    // the shared verification: each instance may jump somewhere else
+    uint8_t jump[] = {
+        OPCODE_JMP, MODE_INDIRECT, 0xF5,
+        OPCODE_NOP, 0, 0,
+        OPCODE_HALT, 0, 0,                 // 6
+    };
+    TEST_ASSERT_EQUAL_INT(0, cpu_fleet_init(&fleet, 2, 0xF0));
+    memset(image.memory, 0, MAX_MEMORY_SIZE);
+    memcpy(image.memory, jump, sizeof(jump));
+    image.memory[0x30] = OPCODE_COUNT; // Undefined, reached by instance 1
+    cpu_fleet_set_code(&fleet, image.memory);
+    cpu_fleet_data(&fleet, 0)[5] = 6;
+    cpu_fleet_data(&fleet, 1)[5] = 0x30;
+    CPUVerifyInfo info;
+    for (size_t i = 0; i < 2; i++) {
+        cpu_fleet_load(&fleet, i, &scratch);
+        TEST_ASSERT_TRUE(cpu_image_step(fleet.image, &scratch) == cpu_step);
+    }
+    TEST_ASSERT_EQUAL_INT(0, cpu_verify(&scratch, &info));
+    cpu_fleet_load(&fleet, 1, &scratch);
+    TEST_ASSERT_EQUAL_INT(CPU_OK, cpu_step(&scratch));
+    TEST_ASSERT_EQUAL_INT(CPU_HALTED, cpu_step(&scratch));
+    TEST_ASSERT_EQUAL_UINT8(0x31, scratch.PC);
+    cpu_fleet_free(&fleet);
+
+    // Test 8: Bad split is rejected
+    TEST_ASSERT_EQUAL_INT(-1, cpu_fleet_init(&fleet, 1, MAX_MEMORY_SIZE + 1));
+}
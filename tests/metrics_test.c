@@ -0,0 +1,125 @@
+#include "unity/unity.h"
+#include "../cpu_metrics.h"
+
+static int file_has(const char *path, const char *line) {
+    char buffer[128];
+    int found = 0;
+    FILE *in = fopen(path, "r");
+    if (!in)
+        return 0;
+    while (!found && fgets(buffer, sizeof(buffer), in))
+        found = strcmp(buffer, line) == 0;
+    fclose(in);
+    return found;
+}
+
+// Run `program` to its halt on cpu_step and cpu_run_fast, return the reason
+static int halt_reason_of(const uint8_t *program, size_t size, uint8_t sp) {
+    CPU step, fast;
+    initCPU(&step);
+    memcpy(step.memory, program, size);
+    step.SP = sp;
+    fast = step;
+    while (cpu_step(&step) == CPU_OK) {
+    }
+    TEST_ASSERT_EQUAL_INT(CPU_HALTED, cpu_run_fast(&fast, UINT64_MAX, NULL));
+    TEST_ASSERT_EQUAL_INT(cpu_halt_reason(&step), cpu_halt_reason(&fast));
+    return cpu_halt_reason(&step);
+}
+
+void metrics_test(void) {
+    // Every halt reason, after a few ordinary instructions
+    const uint8_t halt[] = {OPCODE_NOP, 0, 0, OPCODE_HALT, 0, 0};
+    const uint8_t opcode[] = {OPCODE_B, COND_AL, 9, OPCODE_NOP, 0, 0,
+                              OPCODE_HALT, 0, 0, OPCODE_COUNT};
+    const uint8_t mode[] = {OPCODE_INX, 0, 0, OPCODE_LDA, MODE_COUNT, 0};
+    const uint8_t cond[] = {OPCODE_B, COND_COUNT, 0};
+    const uint8_t store[] = {OPCODE_STA, MODE_IMMEDIAT, 0};
+    const uint8_t push[] = {OPCODE_PUSH, MODE_REGISTER, STACK_REGS_ALL};
+    const uint8_t jsr[] = {OPCODE_JSR, MODE_ABSOLUTE, 0};
+    const uint8_t pop[] = {OPCODE_POP, MODE_REGISTER, STACK_REG_A};
+    const uint8_t rts[] = {OPCODE_RTS, 0, 0};
+    TEST_ASSERT_EQUAL_INT(CPU_HALT_INSTRUCTION,
+                          halt_reason_of(halt, sizeof(halt), STACK_BASE));
+    TEST_ASSERT_EQUAL_INT(CPU_HALT_ILLEGAL_OPCODE,
+                          halt_reason_of(opcode, sizeof(opcode), STACK_BASE));
+    TEST_ASSERT_EQUAL_INT(CPU_HALT_ILLEGAL_MODE,
+                          halt_reason_of(mode, sizeof(mode), STACK_BASE));
+    TEST_ASSERT_EQUAL_INT(CPU_HALT_ILLEGAL_MODE,
+                          halt_reason_of(cond, sizeof(cond), STACK_BASE));
+    TEST_ASSERT_EQUAL_INT(CPU_HALT_ILLEGAL_MODE,
+                          halt_reason_of(store, sizeof(store), STACK_BASE));
+    TEST_ASSERT_EQUAL_INT(CPU_HALT_STACK_OVERFLOW,
+                          halt_reason_of(push, sizeof(push), STACK_LIMIT + 1));
+    TEST_ASSERT_EQUAL_INT(CPU_HALT_STACK_OVERFLOW,
+                          halt_reason_of(jsr, sizeof(jsr), STACK_LIMIT - 1));
+    TEST_ASSERT_EQUAL_INT(CPU_HALT_STACK_UNDERFLOW,
+                          halt_reason_of(pop, sizeof(pop), STACK_BASE));
+    TEST_ASSERT_EQUAL_INT(CPU_HALT_STACK_UNDERFLOW,
+                          halt_reason_of(rts, sizeof(rts), STACK_BASE));
+
+    // Runs and drained cache counters add up per thread block
+    CPUMetricsRegistry registry;
+    static CPUMetrics threads[2];
+    cpu_metrics_registry_init(&registry);
+    for (int t = 0; t < 2; t++) {
+        cpu_metrics_reset(&threads[t]);
+        TEST_ASSERT_EQUAL_INT(t, cpu_metrics_register(&registry, &threads[t]));
+    }
+
+    CPU cpu;
+    uint64_t retired;
+    uint8_t calls[] = {
+        OPCODE_JSR, MODE_ABSOLUTE, 9,
+        OPCODE_JSR, MODE_ABSOLUTE, 9,
+        OPCODE_HALT, 0, 0,
+        OPCODE_RTS, 0, 0,                 // 9
+    };
+    initCPU(&cpu);
+    memcpy(cpu.memory, calls, sizeof(calls));
+    int status = cpu_run_fast(&cpu, 3, &retired);
+    cpu_metrics_run(&threads[0], &cpu, status, retired);
+    status = cpu_run_fast(&cpu, UINT64_MAX, &retired);
+    cpu_metrics_run(&threads[0], &cpu, status, retired);
+    status = cpu_run_fast(&cpu, UINT64_MAX, &retired);
+    cpu_metrics_run(&threads[0], &cpu, status, retired); // Not a new halt
+
+    CPUBlockCache *cache = cpu_block_cache_create();
+    TEST_ASSERT_NOT_NULL(cache);
+    initCPU(&cpu);
+    memcpy(cpu.memory, calls, sizeof(calls));
+    status = cpu_run_blocks(&cpu, cache, UINT64_MAX, &retired);
+    cpu_metrics_run(&threads[1], &cpu, status, retired);
+    uint64_t translations = cache->translations;
+    TEST_ASSERT_EQUAL_UINT64(1, cache->hits); // Second call of the RTS block
+    cpu_metrics_drain_blocks(&threads[1], cache);
+    cpu_block_cache_destroy(cache);
+
+    CPUMetrics total;
+    cpu_metrics_aggregate(&registry, &total);
+    TEST_ASSERT_EQUAL_UINT64(10, total.retired);
+    TEST_ASSERT_EQUAL_UINT64(4, total.runs);
+    TEST_ASSERT_EQUAL_UINT64(2, total.halts[CPU_HALT_INSTRUCTION]);
+    TEST_ASSERT_EQUAL_UINT64(1, total.hits[CPU_CACHE_BLOCK]);
+    TEST_ASSERT_EQUAL_UINT64(translations, total.misses[CPU_CACHE_BLOCK]);
+
+    // Text exposition through an atomically replaced file
+    const char *path = "/tmp/vm8_metrics_test.prom";
+    TEST_ASSERT_EQUAL_INT(0, cpu_metrics_export(&registry, path));
+    TEST_ASSERT_TRUE(file_has(path, "# TYPE vm8_halts_total counter\n"));
+    TEST_ASSERT_TRUE(file_has(path, "vm8_instructions_retired_total 10\n"));
+    TEST_ASSERT_TRUE(file_has(path, "vm8_halts_total{reason=\"halt\"} 2\n"));
+    char line[64];
+    snprintf(line, sizeof(line),
+             "vm8_cache_misses_total{cache=\"block\"} %llu\n",
+             (unsigned long long)translations);
+    TEST_ASSERT_TRUE(file_has(path, line));
+    remove(path);
+    TEST_ASSERT_EQUAL_INT(-1, cpu_metrics_export(&registry,
+                                                 "/nonexistent/metrics"));
+
+    // A full registry refuses more blocks
+    for (int t = 2; t < VM8_METRICS_THREADS; t++)
+        cpu_metrics_register(&registry, &threads[0]);
+    TEST_ASSERT_EQUAL_INT(-1, cpu_metrics_register(&registry, &threads[1]));
+}
@@ -0,0 +1,100 @@
+#include "unity/unity.h"
+#include "../cpu_pack.h"
+
+void packed_v2_test(void) {
+    CPU ref, cpu;
+    uint8_t code[MAX_MEMORY_SIZE];
+
+    // Operand-less instructions are one byte, the others two
+    TEST_ASSERT_EQUAL_UINT(1, packed_v2_length(PACK_INST_BYTE(OPCODE_NOP, 0)));
+    TEST_ASSERT_EQUAL_UINT(1, packed_v2_length(PACK_INST_BYTE(OPCODE_INX, 0)));
+    TEST_ASSERT_EQUAL_UINT(1, packed_v2_length(PACK_INST_BYTE(OPCODE_RTS, 0)));
+    TEST_ASSERT_EQUAL_UINT(1, packed_v2_length(PACK_INST_BYTE(OPCODE_PUSH, 0)));
+    TEST_ASSERT_EQUAL_UINT(2, packed_v2_length(
+                                  PACK_INST_BYTE(OPCODE_PUSH, MODE_REGISTER)));
+    TEST_ASSERT_EQUAL_UINT(1, packed_v2_length(
+                                  PACK_INST_BYTE(OPCODE_SHL, MODE_REGISTER)));
+    TEST_ASSERT_EQUAL_UINT(2, packed_v2_length(
+                                  PACK_INST_BYTE(OPCODE_SHL, MODE_ABSOLUTE)));
+    TEST_ASSERT_EQUAL_UINT(2, packed_v2_length(PACK_INST_BYTE(OPCODE_B, 0)));
+
+    // Loop with a subroutine call: sum 5 + 4 + ... + 1 into $F1
+    initCPU(&ref);
+    ref.memory[0xF0] = 5;
+    uint8_t program[] = {
+        OPCODE_LDX, MODE_ABSOLUTE, 0xF0,   // 0
+        OPCODE_JSR, MODE_ABSOLUTE, 18,     // 3: loop
+        OPCODE_DEX, 0, 0,
+        OPCODE_CPX, MODE_IMMEDIAT, 0,
+        OPCODE_B, COND_NE, 3,
+        OPCODE_HALT, 0, 0,
+        OPCODE_PUSH, MODE_REGISTER, STACK_REG_X,  // 18: subroutine
+        OPCODE_LDA, MODE_ABSOLUTE, 0xF1,
+        OPCODE_SHL, MODE_REGISTER, 0,
+        OPCODE_SHR, MODE_REGISTER, 0,
+        OPCODE_STX, MODE_ABSOLUTE, 0xF2,
+        OPCODE_ADD, MODE_ABSOLUTE, 0xF2,
+        OPCODE_STA, MODE_ABSOLUTE, 0xF1,
+        OPCODE_POP, MODE_REGISTER, STACK_REG_X,
+        OPCODE_RTS, 0, 0,
+    };
+    memcpy(ref.memory, program, sizeof(program));
+    cpu = ref;
+    while (cpu_step(&ref) == CPU_OK) {
+    }
+    TEST_ASSERT_EQUAL_UINT8(15, ref.memory[0xF1]);
+
+    // Wide -> v2: 45 bytes down to 25 (5 of 15 instructions are one byte)
+    int size = cpu_pack_v2(program, sizeof(program), CPU_FORMAT_WIDE, code,
+                           sizeof(code));
+    TEST_ASSERT_EQUAL_INT(25, size);
+    memset(cpu.memory, 0, (size_t)sizeof(program));
+    memcpy(cpu.memory, code, (size_t)size);
+    while (cpu_step_packed_v2(&cpu) == CPU_OK) {
+    }
+    TEST_ASSERT_EQUAL_UINT8(ref.A, cpu.A);
+    TEST_ASSERT_EQUAL_UINT8(ref.X, cpu.X);
+    TEST_ASSERT_EQUAL_UINT8(ref.SP, cpu.SP);
+    TEST_ASSERT_EQUAL_UINT8(ref.flags, cpu.flags);
+    TEST_ASSERT_EQUAL_UINT8(15, cpu.memory[0xF1]);
+
+    // Packed -> v2 gives the same code
+    uint8_t packed[sizeof(program) / 3 * 2];
+    for (unsigned i = 0; i < sizeof(program) / 3; i++) {
+        uint8_t opcode = program[3 * i], operand = program[3 * i + 2];
+        if (opcode == OPCODE_B || opcode == OPCODE_JSR)
+            operand = (uint8_t)(operand / 3 * 2); // Packed addresses
+        packed[2 * i] = PACK_INST_BYTE(opcode, program[3 * i + 1]);
+        packed[2 * i + 1] = operand;
+    }
+    uint8_t again[MAX_MEMORY_SIZE];
+    TEST_ASSERT_EQUAL_INT(size, cpu_pack_v2(packed, sizeof(packed),
+                                            CPU_FORMAT_PACKED, again,
+                                            sizeof(again)));
+    TEST_ASSERT_EQUAL_MEMORY(code, again, (size_t)size);
+
+    // Rejected: branch into an instruction, computed jump, partial
+    // instruction, no room
+    uint8_t mid[] = {OPCODE_B, COND_AL, 1};
+    TEST_ASSERT_EQUAL_INT(-1, cpu_pack_v2(mid, sizeof(mid), CPU_FORMAT_WIDE,
+                                          code, sizeof(code)));
+    uint8_t computed[] = {OPCODE_JMP, MODE_INDIRECT, 0xE0};
+    TEST_ASSERT_EQUAL_INT(-1, cpu_pack_v2(computed, sizeof(computed),
+                                          CPU_FORMAT_WIDE, code,
+                                          sizeof(code)));
+    TEST_ASSERT_EQUAL_INT(-1, cpu_pack_v2(program, 4, CPU_FORMAT_WIDE, code,
+                                          sizeof(code)));
+    TEST_ASSERT_EQUAL_INT(-1, cpu_pack_v2(program, sizeof(program),
+                                          CPU_FORMAT_WIDE, code, 24));
+
+    // Targets outside the converted range are kept
+    uint8_t far[] = {OPCODE_JSR, MODE_ABSOLUTE, 0x80, OPCODE_NOP, 0, 0};
+    TEST_ASSERT_EQUAL_INT(3, cpu_pack_v2(far, sizeof(far), CPU_FORMAT_WIDE,
+                                         code, sizeof(code)));
+    TEST_ASSERT_EQUAL_UINT8(0x80, code[1]);
+
+    // Undefined opcodes halt
+    initCPU(&cpu);
+    cpu.memory[0] = 0x1F;
+    TEST_ASSERT_EQUAL_INT(CPU_HALTED, cpu_step_packed_v2(&cpu));
+}
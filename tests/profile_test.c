@@ -0,0 +1,113 @@
+#include "unity/unity.h"
+#include "../cpu_profile.h"
+
+static int folded_has(FILE *out, const char *line) {
+    char buffer[128];
+    rewind(out);
+    while (fgets(buffer, sizeof(buffer), out))
+        if (strcmp(buffer, line) == 0)
+            return 1;
+    return 0;
+}
+
+void profile_test(void) {
+    CPU tmpl, cpu, ref;
+    uint64_t retired = 0;
+    CPUProfile *prof = cpu_profile_create(1);
+    TEST_ASSERT_NOT_NULL(prof);
+
+    // Nested calls: 10 instructions per loop iteration, 10 distinct stacks
+    initCPU(&tmpl);
+    uint8_t program[] = {
+        OPCODE_JSR, MODE_ABSOLUTE, 9,   // 0: loop
+        OPCODE_B, COND_AL, 0,
+        OPCODE_HALT, 0, 0,
+        OPCODE_JSR, MODE_ABSOLUTE, 18,  // 9: outer subroutine
+        OPCODE_JSR, MODE_ABSOLUTE, 21,
+        OPCODE_RTS, 0, 0,
+        OPCODE_INX, 0, 0,               // 18, 21: leaf subroutines
+        OPCODE_DEX, 0, 0,
+        OPCODE_RTS, 0, 0,
+    };
+    memcpy(tmpl.memory, program, sizeof(program));
+
+    // Period 1 samples after every instruction, the engine is unchanged
+    cpu = ref = tmpl;
+    TEST_ASSERT_EQUAL_INT(CPU_OK, cpu_run_profiled(&cpu, prof, 1000, &retired));
+    TEST_ASSERT_EQUAL_UINT64(1000, retired);
+    cpu_run_fast(&ref, 1000, NULL);
+    TEST_ASSERT_EQUAL_MEMORY(&ref, &cpu, sizeof(CPU));
+    TEST_ASSERT_EQUAL_UINT64(1000, prof->samples);
+    TEST_ASSERT_EQUAL_UINT32(10, prof->stacks);
+    TEST_ASSERT_EQUAL_UINT64(0, prof->dropped);
+    TEST_ASSERT_EQUAL_UINT64(100, prof->hits[0]);
+    TEST_ASSERT_EQUAL_UINT64(200, prof->hits[21]); // Two paths reach DEX
+
+    FILE *out = tmpfile();
+    TEST_ASSERT_NOT_NULL(out);
+    TEST_ASSERT_EQUAL_INT(10, cpu_profile_write_folded(prof, out));
+    TEST_ASSERT_TRUE(folded_has(out, "main;pc_00 100\n"));
+    TEST_ASSERT_TRUE(folded_has(out, "main;sub_09;pc_09 100\n"));
+    TEST_ASSERT_TRUE(folded_has(out, "main;sub_09;sub_12;pc_15 100\n"));
+    TEST_ASSERT_TRUE(folded_has(out, "main;sub_09;sub_15;pc_15 100\n"));
+    TEST_ASSERT_TRUE(folded_has(out, "main;sub_09;pc_0F 100\n"));
+    fclose(out);
+
+    // Jittered periods average out; short slices sample like one long run
+    cpu_profile_reset(prof, 1000);
+    cpu = tmpl;
+    cpu_run_profiled(&cpu, prof, 1000000, NULL);
+    TEST_ASSERT_UINT64_WITHIN(100, 1000, prof->samples);
+    CPUProfile *sliced = cpu_profile_create(1000);
+    TEST_ASSERT_NOT_NULL(sliced);
+    cpu = tmpl;
+    for (int i = 0; i < 1000000 / 7; i++)
+        cpu_run_profiled(&cpu, sliced, 7, NULL);
+    cpu_run_profiled(&cpu, sliced, 1000000 % 7, NULL);
+    TEST_ASSERT_EQUAL_UINT64(prof->samples, sliced->samples);
+    TEST_ASSERT_EQUAL_MEMORY(prof->hits, sliced->hits, sizeof(prof->hits));
+    cpu_profile_destroy(sliced);
+
+    // Recursion: DEPTH frames fit, the pushed A is not a frame; deeper
+    // recursion keeps the innermost DEPTH frames
+    uint8_t recurse[] = {
+        OPCODE_LDX, MODE_IMMEDIAT, 0,
+        OPCODE_JSR, MODE_ABSOLUTE, 6,
+        OPCODE_DEX, 0, 0,                          // 6: recursive subroutine
+        OPCODE_B, COND_EQ, 15,
+        OPCODE_JSR, MODE_ABSOLUTE, 6,
+        OPCODE_PUSH, MODE_REGISTER, STACK_REG_A,   // 15
+        OPCODE_HALT, 0, 0,
+    };
+    for (uint8_t extra = 0; extra < 3; extra += 2) {
+        cpu_profile_reset(prof, 1);
+        initCPU(&cpu);
+        memcpy(cpu.memory, recurse, sizeof(recurse));
+        cpu.memory[2] = CPU_PROFILE_DEPTH + extra;
+        cpu.A = 0x40;
+        TEST_ASSERT_EQUAL_INT(CPU_HALTED, cpu_run_profiled(&cpu, prof,
+                                                           UINT64_MAX,
+                                                           &retired));
+        TEST_ASSERT_EQUAL_UINT64(retired, prof->samples);
+        int found = 0;
+        for (uint32_t i = 0; i < CPU_PROFILE_SLOTS; i++) {
+            const CPUProfileStack *entry = &prof->stack[i];
+            if (!entry->count || entry->pc != 21)
+                continue;
+            TEST_ASSERT_EQUAL_UINT8(CPU_PROFILE_DEPTH, entry->depth);
+            TEST_ASSERT_EQUAL_UINT8(extra != 0, entry->truncated);
+            TEST_ASSERT_EQUAL_UINT8(6, entry->frame[CPU_PROFILE_DEPTH - 1]);
+            found++;
+        }
+        TEST_ASSERT_EQUAL_INT(1, found);
+    }
+
+    // Already halted: nothing runs, nothing sampled
+    uint64_t samples = prof->samples;
+    TEST_ASSERT_EQUAL_INT(CPU_HALTED,
+                          cpu_run_profiled(&cpu, prof, 100, &retired));
+    TEST_ASSERT_EQUAL_UINT64(0, retired);
+    TEST_ASSERT_EQUAL_UINT64(samples, prof->samples);
+
+    cpu_profile_destroy(prof);
+}
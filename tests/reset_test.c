@@ -0,0 +1,83 @@
+#include "unity/unity.h"
+#include "../cpu_arena.h"
+
+#define RESET_POPULATION 4096 // 1.25 MiB: large enough for streamed stores
+
+void reset_test(void) {
+    static CPU population[RESET_POPULATION];
+    CPU tmpl;
+    CPUVerifyInfo info;
+
+    // Template: counts memory[0xF0] down into memory[0xF1], pushes A
+    initCPU(&tmpl);
+    tmpl.memory[0xF0] = 4;
+    uint8_t program[] = {
+        OPCODE_LDX, MODE_ABSOLUTE, 0xF0,
+        OPCODE_INX, 0, 0,                   // Loop
+        OPCODE_STX, MODE_ABSOLUTE, 0xF1,
+        OPCODE_CPX, MODE_IMMEDIAT, 9,
+        OPCODE_B, COND_NE, 3,
+        OPCODE_PUSH, 0, 0,
+        OPCODE_HALT, 0, 0,
+    };
+    memcpy(tmpl.memory, program, sizeof(program));
+
+    // Test 1: Small population (cached copies) equals the template
+    memset(population, 0x5A, 8 * sizeof(CPU));
+    vm8_reset_many(population, 8, &tmpl);
+    for (int i = 0; i < 8; i++)
+        TEST_ASSERT_EQUAL_MEMORY(&tmpl, &population[i], sizeof(CPU));
+
+    // Test 2: Large population (streamed stores) equals the template
+    memset(population, 0x5A, sizeof(population));
+    vm8_reset_many(population, RESET_POPULATION, &tmpl);
+    TEST_ASSERT_EQUAL_MEMORY(&tmpl, &population[0], sizeof(CPU));
+    TEST_ASSERT_EQUAL_MEMORY(&tmpl, &population[RESET_POPULATION / 2],
+                             sizeof(CPU));
+    TEST_ASSERT_EQUAL_MEMORY(&tmpl, &population[RESET_POPULATION - 1],
+                             sizeof(CPU));
+
+    // Test 3: Dirty lines of a verified image
+    TEST_ASSERT_EQUAL_INT(1, cpu_verify(&tmpl, &info));
+    unsigned lines = vm8_dirty_lines(&info);
+    // Line 0 (registers), line 3 (0xF1 at byte 246), line 4 (stack at 0xFF)
+    TEST_ASSERT_EQUAL_HEX(0x19, lines);
+
+    // Test 4: Masked reset after running restores the template, both paths
+    size_t sizes[] = {3, RESET_POPULATION};
+    for (int s = 0; s < 2; s++) {
+        for (size_t i = 0; i < sizes[s]; i++)
+            while (cpu_step(&population[i]) == CPU_OK) {
+            }
+        TEST_ASSERT_EQUAL_UINT8(9, population[0].memory[0xF1]);
+        vm8_reset_many_lines(population, sizes[s], &tmpl, lines);
+        TEST_ASSERT_EQUAL_MEMORY(&tmpl, &population[0], sizeof(CPU));
+        TEST_ASSERT_EQUAL_MEMORY(&tmpl, &population[sizes[s] - 1],
+                                 sizeof(CPU));
+    }
+
+    // Test 5: Self-modifying images dirty every line
+    tmpl.memory[7] = MODE_ABSOLUTE_X;
+    cpu_verify(&tmpl, &info);
+    TEST_ASSERT_EQUAL_HEX(VM8_ALL_LINES, vm8_dirty_lines(&info));
+
+    // Test 6: A push loop has no proven depth: every stack line is dirty
+    uint8_t push_loop[] = {
+        OPCODE_PUSH, 0, 0,
+        OPCODE_DEX, 0, 0,
+        OPCODE_B, COND_NE, 0,
+        OPCODE_HALT, 0, 0,
+    };
+    initCPU(&tmpl);
+    memcpy(tmpl.memory, push_loop, sizeof(push_loop));
+    cpu_verify(&tmpl, &info);
+    TEST_ASSERT_FALSE(info.stack_proven);
+    lines = vm8_dirty_lines(&info);
+    population[0] = tmpl;
+    population[0].A = 0x55;
+    while (cpu_step(&population[0]) == CPU_OK) {
+    }
+    TEST_ASSERT_EQUAL_UINT8(0x55, population[0].memory[STACK_LIMIT]);
+    vm8_reset_many_lines(population, 1, &tmpl, lines);
+    TEST_ASSERT_EQUAL_MEMORY(&tmpl, &population[0], sizeof(CPU));
+}
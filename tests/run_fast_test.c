@@ -0,0 +1,126 @@
+#include "unity/unity.h"
+#include "../cpu.h"
+
+static void assert_same_cpu(const CPU *expected, const CPU *actual) {
+    TEST_ASSERT_EQUAL_UINT8(expected->A, actual->A);
+    TEST_ASSERT_EQUAL_UINT8(expected->X, actual->X);
+    TEST_ASSERT_EQUAL_UINT8(expected->PC, actual->PC);
+    TEST_ASSERT_EQUAL_UINT8(expected->SP, actual->SP);
+    TEST_ASSERT_EQUAL_UINT8(expected->flags, actual->flags);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected->memory, actual->memory,
+                                  MAX_MEMORY_SIZE);
+}
+
+void run_fast_test(void) {
+    CPU ref, fast;
+    uint64_t retired = 0;
+
+    // Test 1: Full program to HALT matches cpu_step, retired count included
+    initCPU(&ref);
+    ref.memory[0x80] = 0x81;
+    ref.memory[0x90] = 0x80;
+    ref.memory[0xF0] = 5;
+    uint8_t program[] = {
+        OPCODE_LDA, MODE_IMMEDIAT, 0x7F,
+        OPCODE_ADD, MODE_IMMEDIAT, 0x01,
+        OPCODE_PUSH, 0, 0,
+        OPCODE_SUB, MODE_ABSOLUTE, 0x80,
+        OPCODE_ROR, MODE_INDIRECT, 0x90,
+        OPCODE_SHL, MODE_REGISTER, 0,
+        OPCODE_POP, 0, 0,
+        OPCODE_LDX, MODE_ABSOLUTE, 0xF0,   // Loop: 5 times
+        OPCODE_DEX, 0, 0,
+        OPCODE_STX, MODE_ABSOLUTE, 0xF0,
+        OPCODE_STA, MODE_ABSOLUTE_X, 0xA0,
+        OPCODE_CPX, MODE_IMMEDIAT, 0,
+        OPCODE_B, COND_NE, 21,
+        OPCODE_HALT, 0, 0,
+    };
+    memcpy(ref.memory, program, sizeof(program));
+    fast = ref;
+
+    uint64_t steps = 0;
+    int result;
+    do {
+        result = cpu_step(&ref);
+        steps++;
+    } while (result == CPU_OK);
+
+    TEST_ASSERT_EQUAL_INT(CPU_HALTED, cpu_run_fast(&fast, 1000, &retired));
+    TEST_ASSERT_EQUAL_UINT64(steps, retired);
+    assert_same_cpu(&ref, &fast);
+
+    // Test 2: Budget exhausted mid-program flushes registers and resumes
+    initCPU(&ref);
+    memcpy(ref.memory, program, sizeof(program));
+    ref.memory[0xF0] = 5;
+    fast = ref;
+    for (int i = 0; i < 10; i++) {
+        TEST_ASSERT_EQUAL_INT(CPU_OK, cpu_step(&ref));
+    }
+    TEST_ASSERT_EQUAL_INT(CPU_OK, cpu_run_fast(&fast, 10, &retired));
+    TEST_ASSERT_EQUAL_UINT64(10, retired);
+    assert_same_cpu(&ref, &fast);
+
+    while (cpu_step(&ref) == CPU_OK) {
+    }
+    TEST_ASSERT_EQUAL_INT(CPU_HALTED, cpu_run_fast(&fast, 1000, NULL));
+    assert_same_cpu(&ref, &fast);
+
+    // Test 3: Invalid opcode, invalid mode and stack overflow
+    initCPU(&ref);
+    ref.memory[0] = 0xEE;
+    fast = ref;
+    TEST_ASSERT_EQUAL_INT(CPU_HALTED, cpu_step(&ref));
+    TEST_ASSERT_EQUAL_INT(CPU_HALTED, cpu_run_fast(&fast, 1000, &retired));
+    TEST_ASSERT_EQUAL_UINT64(1, retired);
+    assert_same_cpu(&ref, &fast);
+
+    initCPU(&ref);
+    ref.memory[0] = OPCODE_STA;
+    ref.memory[1] = 0x07;
+    fast = ref;
+    TEST_ASSERT_EQUAL_INT(CPU_HALTED, cpu_step(&ref));
+    TEST_ASSERT_EQUAL_INT(CPU_HALTED, cpu_run_fast(&fast, 1000, NULL));
+    assert_same_cpu(&ref, &fast);
+
+    initCPU(&ref);
+    ref.SP = STACK_BASE - STACK_SIZE;
+    ref.memory[0] = OPCODE_PUSH;
+    fast = ref;
+    TEST_ASSERT_EQUAL_INT(CPU_HALTED, cpu_step(&ref));
+    TEST_ASSERT_EQUAL_INT(CPU_HALTED, cpu_run_fast(&fast, 1000, NULL));
+    assert_same_cpu(&ref, &fast);
+
+    // Test 4: Zero budget does nothing
+    initCPU(&fast);
+    TEST_ASSERT_EQUAL_INT(CPU_OK, cpu_run_fast(&fast, 0, &retired));
+    TEST_ASSERT_EQUAL_UINT64(0, retired);
+    TEST_ASSERT_EQUAL_UINT8(0, fast.PC);
+
+    // Test 5: Calls and returns across slices
+    initCPU(&ref);
+    uint8_t calls[] = {
+        OPCODE_JSR, MODE_ABSOLUTE, 9,     // 0: outer call
+        OPCODE_B, COND_AL, 0,             // 3: again, forever
+        OPCODE_HALT, 0, 0,                // 6
+        OPCODE_JSR, MODE_ABSOLUTE, 15,    // 9: nested call
+        OPCODE_RTS, 0, 0,                 // 12
+        OPCODE_INX, 0, 0,                 // 15
+        OPCODE_RTS, 0, 0,                 // 18
+    };
+    memcpy(ref.memory, calls, sizeof(calls));
+    fast = ref;
+    for (int i = 0; i < 12; i++)
+        cpu_step(&ref);
+    TEST_ASSERT_EQUAL_INT(CPU_OK, cpu_run_fast(&fast, 5, NULL));
+    TEST_ASSERT_EQUAL_INT(CPU_OK, cpu_run_fast(&fast, 7, NULL));
+    assert_same_cpu(&ref, &fast);
+
+    // A rewritten return address is where RTS goes
+    fast.memory[STACK_BASE] = 6;        // Outer call now returns to HALT
+    fast.PC = 9;
+    fast.SP = STACK_BASE - 1;
+    TEST_ASSERT_EQUAL_INT(CPU_HALTED, cpu_run_fast(&fast, 1000, NULL));
+    TEST_ASSERT_EQUAL_UINT8(9, fast.PC);
+}
@@ -0,0 +1,88 @@
+#include "unity/unity.h"
+#include "../cpu_sched.h"
+
+static void load_countdown(CPU *cpu, uint8_t count) {
+    initCPU(cpu);
+    cpu->memory[0xF0] = count;
+    uint8_t program[] = {
+        OPCODE_LDX, MODE_ABSOLUTE, 0xF0,
+        OPCODE_DEX, 0, 0,                   // Loop
+        OPCODE_STX, MODE_ABSOLUTE, 0xF0,
+        OPCODE_CPX, MODE_IMMEDIAT, 0,
+        OPCODE_B, COND_NE, 3,
+        OPCODE_HALT, 0, 0,
+    };
+    memcpy(cpu->memory, program, sizeof(program));
+}
+
+void sched_test(void) {
+    CPUSched sched;
+    CPU guests[4], ref;
+
+    // Capacities whose queues would not fit 32-bit indices are refused
+    TEST_ASSERT_EQUAL_INT(-1, vm8_sched_init(&sched, UINT32_MAX, 5));
+
+    // Test 1: Guests run to HALT in slices, same result as cpu_step
+    TEST_ASSERT_EQUAL_INT(0, vm8_sched_init(&sched, 3, 5));
+    for (int i = 0; i < 3; i++) {
+        load_countdown(&guests[i], (uint8_t)(10 * (i + 1)));
+        TEST_ASSERT_EQUAL_INT64(i, vm8_sched_add(&sched, &guests[i], 0));
+    }
+    TEST_ASSERT_EQUAL_INT64(-1, vm8_sched_add(&sched, &guests[3], 0));
+    TEST_ASSERT_TRUE(vm8_sched_run(&sched, 0) > 3);
+    for (int i = 0; i < 3; i++) {
+        uint64_t steps = 0;
+        load_countdown(&ref, (uint8_t)(10 * (i + 1)));
+        do {
+            steps++;
+        } while (cpu_step(&ref) == CPU_OK);
+        TEST_ASSERT_EQUAL_UINT8(VM8_GUEST_HALTED, sched.guests[i].state);
+        TEST_ASSERT_EQUAL_UINT64(steps, sched.guests[i].retired);
+        TEST_ASSERT_EQUAL_MEMORY(&ref, &guests[i], sizeof(CPU));
+    }
+    TEST_ASSERT_EQUAL_UINT64(sched.guests[0].retired +
+                                 sched.guests[1].retired +
+                                 sched.guests[2].retired,
+                             sched.retired);
+    vm8_sched_free(&sched);
+
+    // Test 2: Strict priority, round robin within a bucket
+    TEST_ASSERT_EQUAL_INT(0, vm8_sched_init(&sched, 4, 4));
+    for (int i = 0; i < 3; i++) {
+        load_countdown(&guests[i], 200);
+        vm8_sched_add(&sched, &guests[i], i == 2 ? 1 : 0);
+    }
+    TEST_ASSERT_EQUAL_UINT64(10, vm8_sched_run(&sched, 10));
+    TEST_ASSERT_EQUAL_UINT64(20, sched.guests[0].retired);
+    TEST_ASSERT_EQUAL_UINT64(20, sched.guests[1].retired);
+    TEST_ASSERT_EQUAL_UINT64(0, sched.guests[2].retired);
+
+    // Test 3: Parked guests are skipped until woken
+    vm8_sched_park(&sched, 0);
+    vm8_sched_run(&sched, 4);
+    TEST_ASSERT_EQUAL_UINT64(20, sched.guests[0].retired);
+    TEST_ASSERT_EQUAL_UINT64(36, sched.guests[1].retired);
+    vm8_sched_wake(&sched, 0);
+    vm8_sched_wake(&sched, 0); // Already ready: not queued twice
+    vm8_sched_run(&sched, 2);
+    TEST_ASSERT_EQUAL_UINT64(24, sched.guests[0].retired);
+    TEST_ASSERT_EQUAL_UINT64(40, sched.guests[1].retired);
+
+    // Test 4: A guest spinning on a self-branch goes idle until woken
+    initCPU(&guests[3]);
+    guests[3].memory[0] = OPCODE_B;
+    guests[3].memory[1] = COND_AL;
+    guests[3].memory[2] = 0;
+    TEST_ASSERT_EQUAL_INT64(3, vm8_sched_add(&sched, &guests[3], 0));
+    for (int i = 0; i < 3; i++)
+        vm8_sched_park(&sched, (uint32_t)i);
+    TEST_ASSERT_EQUAL_UINT64(1, vm8_sched_run(&sched, 0));
+    TEST_ASSERT_EQUAL_UINT8(VM8_GUEST_IDLE, sched.guests[3].state);
+    guests[3].memory[0] = OPCODE_HALT; // The embedder changes the guest
+    vm8_sched_wake(&sched, 3);
+    TEST_ASSERT_EQUAL_UINT64(1, vm8_sched_run(&sched, 0));
+    TEST_ASSERT_EQUAL_UINT8(VM8_GUEST_HALTED, sched.guests[3].state);
+    vm8_sched_wake(&sched, 3); // Halted guests stay halted
+    TEST_ASSERT_EQUAL_UINT64(0, vm8_sched_run(&sched, 0));
+    vm8_sched_free(&sched);
+}
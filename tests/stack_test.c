@@ -0,0 +1,147 @@
+#include "unity/unity.h"
+#include "../cpu_block.h"
+#include "../cpu_tailcall.h"
+#include "../cpu_verify.h"
+
+void stack_test(void) {
+    CPU cpu, ref, fast, tail;
+    CPUVerifyInfo info;
+
+    // Test 1: Register-mask PUSH/POP restores A, X and flags
+    initCPU(&cpu);
+    cpu.A = 0x11;
+    cpu.X = 0x22;
+    cpu.flags = FLAG_CARRY | FLAG_OVERFLOW;
+    uint8_t save[] = {
+        OPCODE_PUSH, MODE_REGISTER, STACK_REGS_ALL,
+        OPCODE_LDA, MODE_IMMEDIAT, 0,        // Clobber A and flags
+        OPCODE_LDX, MODE_IMMEDIAT, 0x80,     // Clobber X
+        OPCODE_POP, MODE_REGISTER, STACK_REGS_ALL,
+        OPCODE_HALT, 0, 0,
+    };
+    memcpy(cpu.memory, save, sizeof(save));
+    TEST_ASSERT_EQUAL_INT(CPU_OK, cpu_step(&cpu));
+    TEST_ASSERT_EQUAL_UINT8(STACK_BASE - 3, cpu.SP);
+    TEST_ASSERT_EQUAL_UINT8(0x11, cpu.memory[STACK_BASE]);     // A first
+    TEST_ASSERT_EQUAL_UINT8(0x22, cpu.memory[STACK_BASE - 1]); // Then X
+    TEST_ASSERT_EQUAL_UINT8(FLAG_CARRY | FLAG_OVERFLOW,
+                            cpu.memory[STACK_BASE - 2]);       // Then flags
+    while (cpu_step(&cpu) == CPU_OK) {
+    }
+    TEST_ASSERT_EQUAL_UINT8(0x11, cpu.A);
+    TEST_ASSERT_EQUAL_UINT8(0x22, cpu.X);
+    TEST_ASSERT_EQUAL_UINT8(FLAG_CARRY | FLAG_OVERFLOW | FLAG_HALTED,
+                            cpu.flags);
+    TEST_ASSERT_EQUAL_UINT8(STACK_BASE, cpu.SP);
+
+    // Test 2: A push that does not fit halts without writing anything
+    initCPU(&cpu);
+    cpu.SP = STACK_LIMIT;  // One free slot, two registers
+    cpu.memory[0] = OPCODE_PUSH;
+    cpu.memory[1] = MODE_REGISTER;
+    cpu.memory[2] = STACK_REG_A | STACK_REG_X;
+    cpu.A = 0xAA;
+    TEST_ASSERT_EQUAL_INT(CPU_HALTED, cpu_step(&cpu));
+    TEST_ASSERT_EQUAL_UINT8(STACK_LIMIT, cpu.SP);
+    TEST_ASSERT_EQUAL_UINT8(0, cpu.memory[STACK_LIMIT]);
+
+    // Test 3: Shared subroutine called twice, verified, same on every engine
+    initCPU(&cpu);
+    cpu.memory[0xE0] = 5;
+    uint8_t calls[] = {
+        OPCODE_JSR, MODE_ABSOLUTE, 12,       // 0: double [$E0]
+        OPCODE_JSR, MODE_ABSOLUTE, 12,       // 3: and again
+        OPCODE_LDA, MODE_ABSOLUTE, 0xE0,     // 6
+        OPCODE_HALT, 0, 0,                   // 9
+        OPCODE_PUSH, MODE_REGISTER, STACK_REG_A, // 12: subroutine
+        OPCODE_SHL, MODE_ABSOLUTE, 0xE0,
+        OPCODE_POP, MODE_REGISTER, STACK_REG_A,
+        OPCODE_RTS, 0, 0,
+    };
+    memcpy(cpu.memory, calls, sizeof(calls));
+    TEST_ASSERT_EQUAL_INT(1, cpu_verify(&cpu, &info));
+    TEST_ASSERT_EQUAL_INT(2, info.max_depth);
+    TEST_ASSERT_TRUE(bitmap_test(&info.code, 6));  // Return path verified
+    ref = cpu;
+    fast = cpu;
+    tail = cpu;
+    while (cpu_step_unchecked(&cpu) == CPU_OK) {
+    }
+    while (cpu_step(&ref) == CPU_OK) {
+    }
+    TEST_ASSERT_EQUAL_INT(CPU_HALTED, cpu_run_fast(&fast, UINT64_MAX, NULL));
+    cpu_run_tailcall(&tail);
+    TEST_ASSERT_EQUAL_UINT8(20, ref.A);
+    TEST_ASSERT_EQUAL_UINT8(12, ref.PC);
+    TEST_ASSERT_EQUAL_UINT8(STACK_BASE, ref.SP);
+    TEST_ASSERT_EQUAL_MEMORY(&ref, &cpu, sizeof(CPU));
+    TEST_ASSERT_EQUAL_MEMORY(&ref, &fast, sizeof(CPU));
+    TEST_ASSERT_EQUAL_MEMORY(&ref, &tail, sizeof(CPU));
+
+    // Test 4: Return addresses the verifier cannot track stay checked
+    initCPU(&cpu);
+    cpu.memory[0] = OPCODE_RTS;              // Nothing was called
+    TEST_ASSERT_EQUAL_INT(0, cpu_verify(&cpu, &info));
+    TEST_ASSERT_FALSE(info.stack_proven);
+
+    initCPU(&cpu);
+    uint8_t drop[] = {
+        OPCODE_JSR, MODE_ABSOLUTE, 6,
+        OPCODE_HALT, 0, 0,
+        OPCODE_POP, 0, 0,                    // Pops its return address
+        OPCODE_PUSH, 0, 0,
+        OPCODE_RTS, 0, 0,
+    };
+    memcpy(cpu.memory, drop, sizeof(drop));
+    TEST_ASSERT_EQUAL_INT(0, cpu_verify(&cpu, &info));
+    TEST_ASSERT_FALSE(info.stack_proven);
+
+    initCPU(&cpu);
+    uint8_t poke[] = {
+        OPCODE_JSR, MODE_ABSOLUTE, 6,
+        OPCODE_HALT, 0, 0,
+        OPCODE_STA, MODE_ABSOLUTE, STACK_BASE, // Overwrites it
+        OPCODE_RTS, 0, 0,
+    };
+    memcpy(cpu.memory, poke, sizeof(poke));
+    TEST_ASSERT_EQUAL_INT(0, cpu_verify(&cpu, &info));
+    TEST_ASSERT_FALSE(info.stack_proven);
+
+    // Test 5: An empty mask moves A, as PUSH/POP did before masks existed
+    initCPU(&cpu);
+    cpu.A = 0x80;
+    uint8_t legacy[] = {
+        OPCODE_PUSH, MODE_REGISTER, 0,
+        OPCODE_LDA, MODE_IMMEDIAT, 1,        // Clobber A, clear N
+        OPCODE_POP, MODE_REGISTER, 0,
+        OPCODE_HALT, 0, 0,
+    };
+    memcpy(cpu.memory, legacy, sizeof(legacy));
+    TEST_ASSERT_EQUAL_INT(1, cpu_verify(&cpu, &info));
+    TEST_ASSERT_EQUAL_INT(1, info.max_depth);
+    ref = cpu;
+    fast = cpu;
+    tail = cpu;
+    CPU block = cpu;
+    TEST_ASSERT_EQUAL_INT(CPU_OK, cpu_step(&ref));
+    TEST_ASSERT_EQUAL_UINT8(0x80, ref.memory[STACK_BASE]);
+    TEST_ASSERT_EQUAL_UINT8(STACK_BASE - 1, ref.SP);
+    while (cpu_step(&ref) == CPU_OK) {
+    }
+    TEST_ASSERT_EQUAL_UINT8(0x80, ref.A);
+    TEST_ASSERT_TRUE(ref.flags & FLAG_NEGATIVE);        // POP sets N, Z
+    TEST_ASSERT_EQUAL_UINT8(STACK_BASE, ref.SP);
+    TEST_ASSERT_EQUAL_INT(CPU_HALTED, cpu_run_fast(&fast, UINT64_MAX, NULL));
+    cpu_run_tailcall(&tail);
+    CPUBlockCache *cache = cpu_block_cache_create();
+    TEST_ASSERT_NOT_NULL(cache);
+    TEST_ASSERT_EQUAL_INT(CPU_HALTED,
+                          cpu_run_blocks(&block, cache, UINT64_MAX, NULL));
+    cpu_block_cache_destroy(cache);
+    while (cpu_step_unchecked(&cpu) == CPU_OK) {
+    }
+    TEST_ASSERT_EQUAL_MEMORY(&ref, &cpu, sizeof(CPU));
+    TEST_ASSERT_EQUAL_MEMORY(&ref, &fast, sizeof(CPU));
+    TEST_ASSERT_EQUAL_MEMORY(&ref, &tail, sizeof(CPU));
+    TEST_ASSERT_EQUAL_MEMORY(&ref, &block, sizeof(CPU));
+}
@@ -0,0 +1,84 @@
+#include "unity/unity.h"
+#include "../cpu_tailcall.h"
+
+/* Run `ref` with cpu_step and `tc` with the tail-call engine from the same
+   state and check both end in the same architectural state */
+static void assert_same_as_step(CPU *ref, CPU *tc) {
+    while (cpu_step(ref) == CPU_OK) {
+    }
+    TEST_ASSERT_EQUAL_INT(CPU_HALTED, cpu_run_tailcall(tc));
+    TEST_ASSERT_EQUAL_UINT8(ref->A, tc->A);
+    TEST_ASSERT_EQUAL_UINT8(ref->X, tc->X);
+    TEST_ASSERT_EQUAL_UINT8(ref->PC, tc->PC);
+    TEST_ASSERT_EQUAL_UINT8(ref->SP, tc->SP);
+    TEST_ASSERT_EQUAL_UINT8(ref->flags, tc->flags);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(ref->memory, tc->memory, MAX_MEMORY_SIZE);
+}
+
+void tailcall_test(void) {
+    CPU ref, tc;
+
+    // Test 1: Counting loop with memory counter (LDX/DEX/STX/CPX/B NE)
+    initCPU(&ref);
+    ref.memory[0xF0] = 20;
+    uint8_t loop[] = {
+        OPCODE_LDX, MODE_ABSOLUTE, 0xF0,
+        OPCODE_DEX, 0, 0,
+        OPCODE_STX, MODE_ABSOLUTE, 0xF0,
+        OPCODE_CPX, MODE_IMMEDIAT, 0,
+        OPCODE_B, COND_NE, 3,
+        OPCODE_HALT, 0, 0,
+    };
+    memcpy(ref.memory, loop, sizeof(loop));
+    tc = ref;
+    assert_same_as_step(&ref, &tc);
+    TEST_ASSERT_EQUAL_UINT8(0, tc.X);
+    TEST_ASSERT_EQUAL_UINT8(18, tc.PC);
+
+    // Test 2: Arithmetic, logic, stack and read-modify-write ops
+    initCPU(&ref);
+    ref.memory[0x80] = 0x81;
+    ref.memory[0x90] = 0x80;  // Pointer for indirect modes
+    uint8_t mix[] = {
+        OPCODE_LDA, MODE_IMMEDIAT, 0x7F,
+        OPCODE_ADD, MODE_IMMEDIAT, 0x01,   // Overflow + negative
+        OPCODE_PUSH, 0, 0,
+        OPCODE_SUB, MODE_ABSOLUTE, 0x80,
+        OPCODE_XOR, MODE_IMMEDIAT, 0x5A,
+        OPCODE_AND, MODE_INDIRECT, 0x90,
+        OPCODE_OR, MODE_IMMEDIAT, 0x10,
+        OPCODE_ROR, MODE_ABSOLUTE, 0x80,
+        OPCODE_ROL, MODE_REGISTER, 0,
+        OPCODE_SHR, MODE_INDIRECT, 0x90,
+        OPCODE_SHL, MODE_REGISTER, 0,
+        OPCODE_INX, 0, 0,
+        OPCODE_STA, MODE_ABSOLUTE_X, 0x80,
+        OPCODE_CMP, MODE_ABSOLUTE, 0x81,
+        OPCODE_POP, 0, 0,
+        OPCODE_HALT, 0, 0,
+    };
+    memcpy(ref.memory, mix, sizeof(mix));
+    tc = ref;
+    assert_same_as_step(&ref, &tc);
+
+    // Test 3: Invalid opcode halts one byte past the opcode
+    initCPU(&ref);
+    ref.memory[0] = OPCODE_NOP;
+    ref.memory[3] = 0xEE;
+    tc = ref;
+    assert_same_as_step(&ref, &tc);
+    TEST_ASSERT_EQUAL_UINT8(4, tc.PC);
+
+    // Test 4: Invalid mode and stack underflow halt like cpu_step
+    initCPU(&ref);
+    ref.memory[0] = OPCODE_LDA;
+    ref.memory[1] = 0xFF;
+    tc = ref;
+    assert_same_as_step(&ref, &tc);
+
+    initCPU(&ref);
+    ref.memory[0] = OPCODE_POP;
+    tc = ref;
+    assert_same_as_step(&ref, &tc);
+    TEST_ASSERT_TRUE(tc.flags & FLAG_HALTED);
+}
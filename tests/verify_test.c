@@ -0,0 +1,118 @@
+#include "unity/unity.h"
+#include "../cpu_verify.h"
+
+void verify_test(void) {
+    CPU cpu, ref;
+    CPUVerifyInfo info;
+
+    // Test 1: Counting loop verifies and runs the same unchecked
+    initCPU(&cpu);
+    cpu.memory[0xF0] = 10;
+    uint8_t loop[] = {
+        OPCODE_LDX, MODE_ABSOLUTE, 0xF0,
+        OPCODE_DEX, 0, 0,
+        OPCODE_STX, MODE_ABSOLUTE, 0xF0,
+        OPCODE_CPX, MODE_IMMEDIAT, 0,
+        OPCODE_B, COND_NE, 3,
+        OPCODE_HALT, 0, 0,
+        0xEE, 0xEE, 0xEE,  // Unreachable garbage is fine
+    };
+    memcpy(cpu.memory, loop, sizeof(loop));
+    ref = cpu;
+    TEST_ASSERT_EQUAL_INT(1, cpu_verify(&cpu, &info));
+    TEST_ASSERT_TRUE(info.valid);
+    TEST_ASSERT_FALSE(info.self_modifying);
+    TEST_ASSERT_TRUE(info.stack_proven);
+    TEST_ASSERT_TRUE(bitmap_test(&info.code, 15));   // HALT is reachable
+    TEST_ASSERT_FALSE(bitmap_test(&info.code, 18));  // Garbage is not
+    TEST_ASSERT_TRUE(bitmap_test(&info.written, 0xF0));
+    TEST_ASSERT_TRUE(cpu_select_step(&info) == cpu_step_unchecked);
+
+    while (cpu_step_unchecked(&cpu) == CPU_OK) {
+    }
+    while (cpu_step(&ref) == CPU_OK) {
+    }
+    TEST_ASSERT_EQUAL_UINT8(ref.PC, cpu.PC);
+    TEST_ASSERT_EQUAL_UINT8(ref.X, cpu.X);
+    TEST_ASSERT_EQUAL_UINT8(ref.flags, cpu.flags);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(ref.memory, cpu.memory, MAX_MEMORY_SIZE);
+
+    // Test 2: Reachable invalid opcode / mode / condition are rejected
+    initCPU(&cpu);
+    cpu.memory[0] = OPCODE_NOP;
+    cpu.memory[3] = 0xEE;
+    TEST_ASSERT_EQUAL_INT(0, cpu_verify(&cpu, &info));
+    TEST_ASSERT_FALSE(info.valid);
+    TEST_ASSERT_EQUAL_UINT8(3, info.bad_pc);
+    TEST_ASSERT_TRUE(cpu_select_step(&info) == cpu_step);
+
+    initCPU(&cpu);
+    cpu.memory[0] = OPCODE_LDA;      // LDA has no register mode
+    cpu.memory[1] = MODE_REGISTER;
+    TEST_ASSERT_EQUAL_INT(0, cpu_verify(&cpu, &info));
+    TEST_ASSERT_FALSE(info.valid);
+
+    initCPU(&cpu);
+    cpu.memory[0] = OPCODE_STA;      // Store to an immediate
+    cpu.memory[1] = MODE_IMMEDIAT;
+    TEST_ASSERT_EQUAL_INT(0, cpu_verify(&cpu, &info));
+
+    initCPU(&cpu);
+    cpu.memory[0] = OPCODE_B;
+    cpu.memory[1] = 0x09;            // Unknown condition
+    TEST_ASSERT_EQUAL_INT(0, cpu_verify(&cpu, &info));
+
+    // Test 3: Stores that may hit code are self-modifying
+    initCPU(&cpu);
+    cpu.memory[0] = OPCODE_STA;
+    cpu.memory[1] = MODE_ABSOLUTE;
+    cpu.memory[2] = 0x04;            // Mode byte of the next instruction
+    cpu.memory[3] = OPCODE_HALT;
+    TEST_ASSERT_EQUAL_INT(0, cpu_verify(&cpu, &info));
+    TEST_ASSERT_TRUE(info.valid);
+    TEST_ASSERT_TRUE(info.self_modifying);
+
+    initCPU(&cpu);
+    cpu.memory[0] = OPCODE_STA;
+    cpu.memory[1] = MODE_ABSOLUTE_X; // Computed address
+    cpu.memory[2] = 0x80;
+    cpu.memory[3] = OPCODE_HALT;
+    TEST_ASSERT_EQUAL_INT(0, cpu_verify(&cpu, &info));
+    TEST_ASSERT_TRUE(info.self_modifying);
+
+    // Test 4: Balanced PUSH/POP proves the stack depth
+    initCPU(&cpu);
+    uint8_t balanced[] = {
+        OPCODE_PUSH, 0, 0,
+        OPCODE_PUSH, 0, 0,
+        OPCODE_POP, 0, 0,
+        OPCODE_POP, 0, 0,
+        OPCODE_HALT, 0, 0,
+    };
+    memcpy(cpu.memory, balanced, sizeof(balanced));
+    TEST_ASSERT_EQUAL_INT(1, cpu_verify(&cpu, &info));
+    TEST_ASSERT_EQUAL_INT(2, info.max_depth);
+    TEST_ASSERT_TRUE(bitmap_test(&info.written, STACK_BASE));
+    TEST_ASSERT_TRUE(bitmap_test(&info.written, STACK_BASE - 1));
+
+    // Test 5: POP on an empty stack cannot be proven safe
+    initCPU(&cpu);
+    cpu.memory[0] = OPCODE_POP;
+    cpu.memory[3] = OPCODE_HALT;
+    TEST_ASSERT_EQUAL_INT(0, cpu_verify(&cpu, &info));
+    TEST_ASSERT_TRUE(info.valid);
+    TEST_ASSERT_FALSE(info.stack_proven);
+
+    // Test 6: PUSH inside a loop has a path-dependent depth
+    initCPU(&cpu);
+    uint8_t growing[] = {
+        OPCODE_PUSH, 0, 0,
+        OPCODE_DEX, 0, 0,
+        OPCODE_B, COND_NE, 0,
+        OPCODE_HALT, 0, 0,
+    };
+    memcpy(cpu.memory, growing, sizeof(growing));
+    TEST_ASSERT_EQUAL_INT(0, cpu_verify(&cpu, &info));
+    TEST_ASSERT_FALSE(info.stack_proven);
+    TEST_ASSERT_TRUE(cpu_select_step(&info) == cpu_step);
+}
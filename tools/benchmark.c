@@ -1,4 +1,16 @@
 #include "../cpu.h"
+#include "../cpu_arena.h"
+#include "../cpu_block.h"
+#include "../cpu_dispatch.h"
+#include "../cpu_pack.h"
+#include "../cpu_profile.h"
+#include "../cpu_sched.h"
+#include "../cpu_tailcall.h"
+#include "../cpu_verify.h"
+#include "perf_counters.h"
+
+/* Hardware counters around each measured run, NULL unless asked for */
+static PerfCounters *perf;
 
 // Test programs
 static void load_simple_loop(CPU *cpu) {
@@ -135,13 +147,18 @@ static double benchmark_cpu(void (*init_func)(CPU *), int (*step_func)(CPU *),
   clock_t start, end;
   long total_cycles = 0;
 
+  CPU tmpl;
+  init_func(&tmpl);
+  load_func(&tmpl);
+
   printf("Running %s (%d iterations)...\n", test_name, iterations);
 
+  if (perf)
+    perf_counters_start(perf);
   start = clock();
 
   for (int i = 0; i < iterations; i++) {
-    init_func(&cpu);
-    load_func(&cpu);
+    vm8_reset_many(&cpu, 1, &tmpl); // Prebuilt template, no reload
 
     int cycles = 0;
     int result;
@@ -152,6 +169,52 @@ static double benchmark_cpu(void (*init_func)(CPU *), int (*step_func)(CPU *),
   }
 
   end = clock();
+  if (perf)
+    perf_counters_stop(perf);
+  double time_taken = ((double)(end - start)) / CLOCKS_PER_SEC;
+
+  printf("  Time: %.6f seconds\n", time_taken);
+  printf("  Total cycles: %ld\n", total_cycles);
+  if (time_taken > 0) {
+    printf("  Cycles per second: %.0f\n", total_cycles / time_taken);
+    printf("  Estimated MIPS: %.2f\n", total_cycles / (time_taken * 1e6));
+  }
+  if (perf)
+    perf_counters_report(perf, (uint64_t)total_cycles, "  ");
+
+  return time_taken;
+}
+
+/* Same as benchmark_cpu for engines that run the guest until it halts.
+   Cycle counts come from a cpu_step reference run of the same program. */
+static double benchmark_run(int (*run_func)(CPU *), void (*load_func)(CPU *),
+                            const char *test_name, int iterations) {
+  CPU cpu, tmpl;
+  clock_t start, end;
+  long cycles = 0;
+
+  initCPU(&tmpl);
+  load_func(&tmpl);
+  cpu = tmpl;
+  while (cpu_step(&cpu) == 0) {
+    cycles++;
+  }
+  long total_cycles = cycles * iterations;
+
+  printf("Running %s (%d iterations)...\n", test_name, iterations);
+
+  if (perf)
+    perf_counters_start(perf);
+  start = clock();
+
+  for (int i = 0; i < iterations; i++) {
+    vm8_reset_many(&cpu, 1, &tmpl);
+    run_func(&cpu);
+  }
+
+  end = clock();
+  if (perf)
+    perf_counters_stop(perf);
   double time_taken = ((double)(end - start)) / CLOCKS_PER_SEC;
 
   printf("  Time: %.6f seconds\n", time_taken);
@@ -160,16 +223,430 @@ static double benchmark_cpu(void (*init_func)(CPU *), int (*step_func)(CPU *),
     printf("  Cycles per second: %.0f\n", total_cycles / time_taken);
     printf("  Estimated MIPS: %.2f\n", total_cycles / (time_taken * 1e6));
   }
+  if (perf)
+    perf_counters_report(perf, (uint64_t)total_cycles, "  ");
 
   return time_taken;
 }
 
+/* Reset a whole population between trials: per-instance initCPU + program
+   load, against vm8_reset_many from a template and the dirty-line variant.
+   Every round runs the population to HALT first so resets see real state. */
+static void benchmark_reset(void (*load_func)(CPU *), size_t population,
+                            int rounds) {
+  CPUArena *arena = vm8_arena_create(population, -1);
+  CPU tmpl;
+  CPUVerifyInfo info;
+  double times[3] = {0, 0, 0};
+  const char *names[3] = {"initCPU + load", "vm8_reset_many",
+                          "vm8_reset_many_lines"};
+
+  if (!arena)
+    return;
+  initCPU(&tmpl);
+  load_func(&tmpl);
+  cpu_verify(&tmpl, &info);
+  unsigned lines = vm8_dirty_lines(&info);
+  vm8_arena_init(arena, 0, population);
+  vm8_reset_many(arena->slab, population, &tmpl);
+
+  for (int r = 0; r < rounds; r++) {
+    for (int method = 0; method < 3; method++) {
+      for (size_t k = 0; k < population; k++)
+        cpu_run_fast(&arena->slab[k], UINT64_MAX, NULL);
+
+      clock_t start = clock();
+      if (method == 0) {
+        for (size_t k = 0; k < population; k++) {
+          initCPU(&arena->slab[k]);
+          load_func(&arena->slab[k]);
+        }
+      } else if (method == 1) {
+        vm8_reset_many(arena->slab, population, &tmpl);
+      } else {
+        vm8_reset_many_lines(arena->slab, population, &tmpl, lines);
+      }
+      times[method] += (double)(clock() - start) / CLOCKS_PER_SEC;
+    }
+  }
+
+  printf("Resetting %zu CPUs x %d rounds (dirty lines 0x%02X):\n", population,
+         rounds, lines);
+  for (int method = 0; method < 3; method++)
+    printf("  %-22s %.6f seconds (%.1f ns/CPU)\n", names[method],
+           times[method], times[method] * 1e9 / (double)(population * rounds));
+  vm8_arena_destroy(arena);
+}
+
+/* Sampling profiler cost on the call-heavy guest: cpu_run_fast against
+   cpu_run_profiled at the default period (best of 3 each), optionally
+   writing the folded stacks for flamegraph.pl */
+static void benchmark_profile(uint64_t steps, const char *folded) {
+  CPU tmpl, cpu;
+  CPUProfile *prof = cpu_profile_create(CPU_PROFILE_PERIOD);
+  uint8_t program[] = {
+      OPCODE_JSR, MODE_ABSOLUTE, 9,  // Loop
+      OPCODE_B, COND_AL, 0,
+      OPCODE_HALT, 0, 0,
+      OPCODE_JSR, MODE_ABSOLUTE, 18, // Outer subroutine
+      OPCODE_JSR, MODE_ABSOLUTE, 21,
+      OPCODE_RTS, 0, 0,
+      OPCODE_INX, 0, 0,              // Leaf subroutines
+      OPCODE_DEX, 0, 0,
+      OPCODE_RTS, 0, 0,
+  };
+
+  if (!prof) {
+    printf("  profile allocation failed\n");
+    return;
+  }
+  initCPU(&tmpl);
+  memcpy(tmpl.memory, program, sizeof(program));
+
+  double plain = 0, profiled = 0;
+  for (int r = 0; r < 3; r++) {
+    cpu = tmpl;
+    clock_t start = clock();
+    cpu_run_fast(&cpu, steps, NULL);
+    double t = (double)(clock() - start) / CLOCKS_PER_SEC;
+    if (r == 0 || t < plain)
+      plain = t;
+
+    cpu = tmpl;
+    cpu_profile_reset(prof, CPU_PROFILE_PERIOD);
+    start = clock();
+    cpu_run_profiled(&cpu, prof, steps, NULL);
+    t = (double)(clock() - start) / CLOCKS_PER_SEC;
+    if (r == 0 || t < profiled)
+      profiled = t;
+  }
+
+  printf("%llu instructions, period %d, %llu samples, %u stacks:\n",
+         (unsigned long long)steps, CPU_PROFILE_PERIOD,
+         (unsigned long long)prof->samples, prof->stacks);
+  printf("  cpu_run_fast            %.6f seconds\n", plain);
+  printf("  cpu_run_profiled        %.6f seconds", profiled);
+  if (plain > 0)
+    printf("  (%+.2f%%)", (profiled - plain) * 100.0 / plain);
+  printf("\n");
+
+  if (folded) {
+    FILE *out = fopen(folded, "w");
+    int lines = out ? cpu_profile_write_folded(prof, out) : -1;
+    if (out && fclose(out) != 0)
+      lines = -1;
+    if (lines < 0)
+      printf("  %s: %s\n", folded, strerror(errno));
+    else
+      printf("  %d folded stacks written to %s\n", lines, folded);
+  }
+
+  // The difference above is within run-to-run noise: time the samples alone
+  // (after the export, they pile onto one stack)
+  uint64_t samples = prof->samples;
+  clock_t start = clock();
+  for (uint64_t i = 0; i < samples * 100; i++)
+    cpu_profile_sample(prof, &cpu);
+  double sampling = (double)(clock() - start) / CLOCKS_PER_SEC / 100;
+  printf("  Sampling cost           %.1f ns/sample, %.3f%% of run time\n",
+         samples ? sampling * 1e9 / (double)samples : 0.0,
+         plain > 0 ? sampling * 100.0 / plain : 0.0);
+  cpu_profile_destroy(prof);
+}
+
+/* Scheduler overhead: `guests` never-halting guests, `rounds` slices each,
+   through vm8_sched_run vs a bare loop calling cpu_run_fast per guest */
+static void benchmark_sched(uint32_t guests, uint64_t slice, int rounds) {
+  CPUArena *arena = vm8_arena_create(guests, -1);
+  CPUSched sched;
+  CPU tmpl;
+  uint8_t program[] = {
+      OPCODE_LDA, MODE_ABSOLUTE, 0xF0, // Loop
+      OPCODE_ADD, MODE_ABSOLUTE, 0xF1,
+      OPCODE_STA, MODE_ABSOLUTE, 0xF1,
+      OPCODE_INX, 0, 0,
+      OPCODE_B, COND_AL, 0,
+  };
+
+  if (!arena || vm8_sched_init(&sched, guests, slice) != 0)
+    return;
+  initCPU(&tmpl);
+  tmpl.memory[0xF0] = 3;
+  memcpy(tmpl.memory, program, sizeof(program));
+
+  // Same work both ways: every guest runs `rounds` slices, retired counted.
+  // Alternated, best of 3, so neither side pays the first touch of the slab
+  double direct = 0, scheduled = 0;
+  uint64_t retired = 0;
+  for (int t = 0; t < 3; t++) {
+    vm8_reset_many(arena->slab, guests, &tmpl);
+    retired = 0;
+    clock_t start = clock();
+    for (int r = 0; r < rounds; r++)
+      for (uint32_t k = 0; k < guests; k++) {
+        uint64_t n = 0;
+        cpu_run_fast(&arena->slab[k], slice, &n);
+        retired += n;
+      }
+    double elapsed = (double)(clock() - start) / CLOCKS_PER_SEC;
+    if (t == 0 || elapsed < direct)
+      direct = elapsed;
+
+    vm8_reset_many(arena->slab, guests, &tmpl);
+    vm8_sched_free(&sched);
+    if (vm8_sched_init(&sched, guests, slice) != 0) {
+      vm8_arena_destroy(arena);
+      return;
+    }
+    for (uint32_t k = 0; k < guests; k++)
+      vm8_sched_add(&sched, &arena->slab[k], 0);
+    start = clock();
+    vm8_sched_run(&sched, (uint64_t)guests * (uint64_t)rounds);
+    elapsed = (double)(clock() - start) / CLOCKS_PER_SEC;
+    if (t == 0 || elapsed < scheduled)
+      scheduled = elapsed;
+  }
+
+  printf("%u guests x %d slices of %llu instructions:\n", guests, rounds,
+         (unsigned long long)slice);
+  printf("  Bare cpu_run_fast loop  %.6f seconds (%llu instructions)\n", direct,
+         (unsigned long long)retired);
+  printf("  vm8_sched_run           %.6f seconds (%llu instructions)\n",
+         scheduled, (unsigned long long)sched.retired);
+  if (direct > 0)
+    printf("  Scheduling overhead     %.2f%%\n",
+           (scheduled - direct) * 100.0 / direct);
+  vm8_sched_free(&sched);
+  vm8_arena_destroy(arena);
+}
+
+/* Run loops of every ISA variant the host supports on the same program */
+static void benchmark_isa(void (*load_func)(CPU *), int iterations) {
+  CPU tmpl, cpu;
+
+  initCPU(&tmpl);
+  load_func(&tmpl);
+  printf("Selected variant: %s\n", cpu_engines()->name);
+  for (int isa = 0; isa < CPU_ISA_COUNT; isa++) {
+    const CPUEngines *engines = cpu_engines_isa((CPUIsa)isa);
+    if (!engines)
+      continue;
+
+    const cpu_run_fn runs[2] = {engines->run_step, engines->run_fast};
+    double times[2];
+    uint64_t retired = 0;
+    for (int r = 0; r < 2; r++) {
+      clock_t start = clock();
+      retired = 0;
+      for (int i = 0; i < iterations; i++) {
+        uint64_t n = 0;
+        vm8_reset_many(&cpu, 1, &tmpl);
+        runs[r](&cpu, UINT64_MAX, &n);
+        retired += n;
+      }
+      times[r] = (double)(clock() - start) / CLOCKS_PER_SEC;
+    }
+    printf("  %-8s run_step %.6f s  run_fast %.6f s", engines->name, times[0],
+           times[1]);
+    if (times[1] > 0)
+      printf("  (%.2f MIPS)", (double)retired / (times[1] * 1e6));
+    printf("\n");
+  }
+}
+
+/* Code size and cpu_step time of a program against its packed v2 form
+   (code is the 3-byte program below 0xC0, where the data areas start) */
+static void benchmark_packed_v2(void (*load_func)(CPU *), const char *name,
+                                int iterations) {
+  CPU wide, v2, cpu;
+  unsigned len = 0;
+
+  initCPU(&wide);
+  load_func(&wide);
+  for (unsigned i = 0; i < 0xC0; i++)
+    if (wide.memory[i])
+      len = (i / 3 + 1) * 3;
+
+  v2 = wide;
+  memset(v2.memory, 0, len);
+  int size = cpu_pack_v2(wide.memory, len, CPU_FORMAT_WIDE, v2.memory, len);
+  if (size < 0) {
+    printf("  %-10s %3u bytes, not convertible\n", name, len);
+    return;
+  }
+
+  double times[2];
+  for (int r = 0; r < 2; r++) {
+    const CPU *tmpl = r ? &v2 : &wide;
+    clock_t start = clock();
+    for (int i = 0; i < iterations; i++) {
+      vm8_reset_many(&cpu, 1, tmpl);
+      if (r)
+        while (cpu_step_packed_v2(&cpu) == CPU_OK) {
+        }
+      else
+        while (cpu_step(&cpu) == CPU_OK) {
+        }
+    }
+    times[r] = (double)(clock() - start) / CLOCKS_PER_SEC;
+  }
+  printf("  %-10s %3u -> %3d bytes  cpu_step %.6f s  cpu_step_packed_v2 "
+         "%.6f s\n",
+         name, len, size, times[0], times[1]);
+}
+
+/* cpu_step against the block translator on one program. The cache is kept
+   across iterations (the code does not change), so translation is paid once. */
+static void benchmark_blocks(void (*load_func)(CPU *), const char *name,
+                             int iterations) {
+  CPU tmpl, cpu;
+  CPUBlockCache *cache = cpu_block_cache_create();
+
+  if (!cache)
+    return;
+  initCPU(&tmpl);
+  load_func(&tmpl);
+
+  double times[2];
+  for (int r = 0; r < 2; r++) {
+    clock_t start = clock();
+    for (int i = 0; i < iterations; i++) {
+      vm8_reset_many(&cpu, 1, &tmpl);
+      if (r)
+        cpu_run_blocks(&cpu, cache, UINT64_MAX, NULL);
+      else
+        while (cpu_step(&cpu) == CPU_OK) {
+        }
+    }
+    times[r] = (double)(clock() - start) / CLOCKS_PER_SEC;
+  }
+  printf("  %-10s cpu_step %.6f s  cpu_run_blocks %.6f s", name, times[0],
+         times[1]);
+  if (times[1] > 0)
+    printf("  (%.2fx)", times[0] / times[1]);
+  printf("  %llu blocks, %llu instructions folded, %llu with dead flags\n",
+         (unsigned long long)cache->translations,
+         (unsigned long long)cache->folded,
+         (unsigned long long)cache->dead_flags);
+  cpu_block_cache_destroy(cache);
+}
+
+/* 64-byte table copy: LDA $a,X / STA $b,X / INX / CPX / B NE per byte,
+   against one MOVE (A = length, X = destination) */
+static void benchmark_copy(int iterations) {
+  CPU loop, move, cpu;
+  uint64_t steps[2] = {0, 0};
+
+  initCPU(&loop);
+  for (int i = 0; i < 64; i++)
+    loop.memory[0x80 + i] = (uint8_t)(i * 3);
+  move = loop;
+  uint8_t copy_loop[] = {
+      OPCODE_LDX, MODE_IMMEDIAT, 0,
+      OPCODE_LDA, MODE_ABSOLUTE_X, 0x80, // 3: loop
+      OPCODE_STA, MODE_ABSOLUTE_X, 0xC0,
+      OPCODE_INX, 0, 0,
+      OPCODE_CPX, MODE_IMMEDIAT, 64,
+      OPCODE_B, COND_NE, 3,
+      OPCODE_HALT, 0, 0,
+  };
+  uint8_t copy_move[] = {
+      OPCODE_LDA, MODE_IMMEDIAT, 64,
+      OPCODE_LDX, MODE_IMMEDIAT, 0xC0,
+      OPCODE_MOVE, MODE_ABSOLUTE, 0x80,
+      OPCODE_HALT, 0, 0,
+  };
+  memcpy(loop.memory, copy_loop, sizeof(copy_loop));
+  memcpy(move.memory, copy_move, sizeof(copy_move));
+
+  double times[2];
+  for (int r = 0; r < 2; r++) {
+    const CPU *tmpl = r ? &move : &loop;
+    clock_t start = clock();
+    for (int i = 0; i < iterations; i++) {
+      vm8_reset_many(&cpu, 1, tmpl);
+      cpu_run_fast(&cpu, UINT64_MAX, &steps[r]);
+    }
+    times[r] = (double)(clock() - start) / CLOCKS_PER_SEC;
+  }
+  printf("  byte loop %4llu instructions %.6f s\n",
+         (unsigned long long)steps[0], times[0]);
+  printf("  MOVE      %4llu instructions %.6f s", (unsigned long long)steps[1],
+         times[1]);
+  if (times[1] > 0)
+    printf("  (%.1fx)", times[0] / times[1]);
+  printf("\n");
+}
+
+static int run_fast_to_halt(CPU *cpu) {
+  return cpu_run_fast(cpu, UINT64_MAX, NULL);
+}
+
+static void load_shift_program(CPU *cpu) {
+  // Rotate/shift checksum over a 16-byte buffer (read-modify-write heavy)
+  for (int i = 0; i < 16; i++)
+    cpu->memory[0xC0 + i] = (uint8_t)(i * 37 + 11); // Data
+  cpu->memory[0xD0] = 0x5A; // Rotating state
+  cpu->memory[0xD1] = 0x01; // Shifting state
+  cpu->memory[0xE0] = 0xD0; // Pointer to rotating state
+
+  uint8_t program[] = {
+      OPCODE_LDX,
+      MODE_IMMEDIAT,
+      16, // X = buffer length
+      OPCODE_ROL,
+      MODE_REGISTER,
+      0, // Rotate checksum
+      OPCODE_XOR,
+      MODE_ABSOLUTE_X,
+      0xBF, // Mix in data[X - 1]
+      OPCODE_ROR,
+      MODE_ABSOLUTE,
+      0xD0, // Rotate state in memory
+      OPCODE_XOR,
+      MODE_INDIRECT,
+      0xE0, // Mix in state through pointer
+      OPCODE_SHL,
+      MODE_ABSOLUTE,
+      0xD1, // Shift state in memory
+      OPCODE_SHR,
+      MODE_REGISTER,
+      0, // Shift checksum
+      OPCODE_DEX,
+      0,
+      0, // Next byte
+      OPCODE_B,
+      COND_NE,
+      3, // Loop while X != 0
+      OPCODE_HALT,
+      0,
+      0 // End
+  };
+
+  memcpy(cpu->memory, program, sizeof(program));
+}
+
 int main(int argc, char *argv[]) {
   int iterations = 5000;
   double total_time = 0;
+  double total_tailcall_time = 0;
+  double total_fast_time = 0;
+  double total_verified_time = 0;
+  PerfCounters counters;
 
-  if (argc > 1) {
-    iterations = atoi(argv[1]);
+  const char *folded = NULL;
+
+  // benchmark [iterations] [perf] [folded=FILE]
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "perf") == 0) {
+      perf = &counters;
+      continue;
+    }
+    if (strncmp(argv[i], "folded=", 7) == 0) {
+      folded = argv[i] + 7;
+      continue;
+    }
+    iterations = atoi(argv[i]);
     if (iterations <= 0)
       iterations = 5000;
   }
@@ -178,11 +655,21 @@ int main(int argc, char *argv[]) {
   static void (*benchmark[])(CPU *) = {
       load_simple_loop,
       load_fibonacci_program,
-      load_arithmetic_program
+      load_arithmetic_program,
+      load_shift_program
   };
 
   printf("=== CPU Performance Benchmark ===\n");
-  printf("Iterations per test: %d\n\n", iterations);
+  printf("Iterations per test: %d\n", iterations);
+  if (perf && perf_counters_open(perf) == 0) {
+    printf("Hardware counters: unavailable (%s)\n",
+           strerror(perf->error[PERF_CYCLES]));
+    perf = NULL;
+  } else if (perf) {
+    printf("Hardware counters: %d of %d events\n", perf->opened,
+           PERF_EVENT_COUNT);
+  }
+  printf("\n");
 
   size_t num_benchmarks = sizeof(benchmark) / sizeof(benchmark[0]);
   for (int i = 0; i < (int)num_benchmarks; ++i) {
@@ -191,11 +678,71 @@ int main(int argc, char *argv[]) {
   double time = benchmark_cpu(initCPU, cpu_step, benchmark[i],
                                      "Normal CPU (switch)", iterations);
   total_time += time;
+  time = benchmark_run(cpu_run_tailcall, benchmark[i],
+                       "Tail-call engine (" CPU_TAILCALL_DISPATCH ")",
+                       iterations);
+  total_tailcall_time += time;
+  time = benchmark_run(run_fast_to_halt, benchmark[i],
+                       "Register-cached loop (cpu_run_fast)", iterations);
+  total_fast_time += time;
+
+  CPU image;
+  CPUVerifyInfo info;
+  initCPU(&image);
+  benchmark[i](&image);
+  // Constant step functions so the compiler can inline either engine
+  if (cpu_verify(&image, &info))
+    time = benchmark_cpu(initCPU, cpu_step_unchecked, benchmark[i],
+                         "Verified image (cpu_step_unchecked)", iterations);
+  else
+    time = benchmark_cpu(initCPU, cpu_step, benchmark[i],
+                         "Rejected image (cpu_step)", iterations);
+  total_verified_time += time;
 }
 
   // Overall results
   printf("\n=== SUMMARY ===\n");
   printf("Total normal time: %.6f seconds\n", total_time);
+  printf("Total tail-call time: %.6f seconds\n", total_tailcall_time);
+  if (total_tailcall_time > 0)
+    printf("Tail-call speedup: %.2fx\n", total_time / total_tailcall_time);
+  printf("Total cpu_run_fast time: %.6f seconds\n", total_fast_time);
+  if (total_fast_time > 0)
+    printf("cpu_run_fast speedup: %.2fx\n", total_time / total_fast_time);
+  printf("Total verified time: %.6f seconds\n", total_verified_time);
+  if (total_verified_time > 0)
+    printf("Verified speedup: %.2fx\n", total_time / total_verified_time);
+
+  // Population reset (trial-heavy workloads)
+  printf("\n=== BULK RESET ===\n");
+  benchmark_reset(load_fibonacci_program, 100000, 20);
+
+  // Sampling profiler
+  printf("\n=== SAMPLING PROFILER ===\n");
+  benchmark_profile(100000000, folded);
+
+  // Cooperative scheduler
+  printf("\n=== SCHEDULER ===\n");
+  benchmark_sched(10000, 1000, 20);
+
+  // Variable-length encoding
+  printf("\n=== PACKED V2 ===\n");
+  const char *names[] = {"loop", "fibonacci", "arithmetic", "shift"};
+  for (size_t i = 0; i < num_benchmarks; i++)
+    benchmark_packed_v2(benchmark[i], names[i], iterations * 10);
+
+  // Basic-block translation with constant folding
+  printf("\n=== BLOCK TRANSLATOR ===\n");
+  for (size_t i = 0; i < num_benchmarks; i++)
+    benchmark_blocks(benchmark[i], names[i], iterations * 10);
+
+  // Bulk copy instruction against the equivalent guest loop
+  printf("\n=== BLOCK COPY ===\n");
+  benchmark_copy(iterations * 10);
+
+  // Per-ISA engine variants
+  printf("\n=== ISA VARIANTS ===\n");
+  benchmark_isa(load_fibonacci_program, iterations * 10);
 
   // Build info
   printf("\n=== BUILD INFO ===\n");
@@ -212,5 +759,7 @@ int main(int argc, char *argv[]) {
   printf("Optimization: Disabled\n");
 #endif
 
+  if (perf)
+    perf_counters_close(perf);
   return 0;
 }
@@ -0,0 +1,653 @@
+#include "../cpu.h"
+#include "../cpu_block.h"
+#include "../cpu_debug.h"
+#include "../cpu_dispatch.h"
+#include "../cpu_pack.h"
+#include "../cpu_tailcall.h"
+#include "../cpu_verify.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+
+/*
+ * Differential fuzzer: every engine against cpu_step.
+ *
+ * Each program is a random 256-byte image (mostly valid instructions below
+ * 0xC0, data above) with random registers, run for up to N steps on:
+ *   - cpu_step             reference, compared after every step by:
+ *   - cpu_step_debug       with random breakpoints/watchpoints (stepped over)
+ *   - cpu_step_unchecked   when cpu_verify accepts the image
+ *   - cpu_run_fast         with the same step budget (retired count too)
+ *   - cpu_run_blocks       same budget, through a fresh block cache
+ *   - cpu_run_tailcall     when the reference halts within the budget
+ *   - cpu_step_packed      on a restricted image (mostly valid forms, data
+ *                          above 0x80) converted to the 2-byte format, with
+ *                          branch targets remapped
+ *   - cpu_step_packed_v2   on the same image converted by cpu_pack_v2
+ *   - run_step, run_fast and run_packed of every ISA variant the host
+ *                          supports (cpu_dispatch.h), same budget
+ * Modes an opcode is not defined for (e.g. STA #imm, LDA A) are generated
+ * now and then: every engine must halt on them as cpu_step does.
+ *
+ * The first divergence stops every thread; the failing case is minimised
+ * (instructions replaced by NOPs, bytes cleared, budget cut to the first
+ * diverging step) and printed as a C initialiser.
+ *
+ * Usage: fuzz [-t threads] [-n programs] [-d seconds] [-k steps] [-s seed]
+ */
+
+#define FUZZ_DEFAULT_STEPS 256
+
+typedef struct {
+  uint64_t state;
+} fuzz_rng;
+
+/* xorshift64* */
+static inline uint64_t rng_next(fuzz_rng *rng) {
+  uint64_t x = rng->state;
+  x ^= x >> 12;
+  x ^= x << 25;
+  x ^= x >> 27;
+  rng->state = x;
+  return x * 0x2545F4914F6CDD1DULL;
+}
+
+static inline uint8_t rng_byte(fuzz_rng *rng) {
+  return (uint8_t)(rng_next(rng) >> 56);
+}
+
+static inline unsigned rng_below(fuzz_rng *rng, unsigned n) {
+  return (unsigned)((rng_next(rng) >> 32) % n);
+}
+
+// A fuzz case: initial state, debugger setup, and the engine that failed
+typedef struct {
+  CPU cpu;
+  CPUDebug dbg;
+  uint64_t steps;
+  int packed;          // Restricted case (cpu_step_packed)
+  const char *engine;  // Diverging engine
+  const char *detail;  // What differed
+} fuzz_case;
+
+static atomic_int fuzz_stop;
+static atomic_uint_fast64_t fuzz_programs;
+static atomic_uint_fast64_t fuzz_verified;
+static atomic_uint_fast64_t fuzz_steps; // Reference instructions compared
+static pthread_mutex_t fuzz_lock = PTHREAD_MUTEX_INITIALIZER;
+static const CPUEngines *fuzz_variants[CPU_ISA_COUNT]; // NULL: unsupported
+
+// Engine names of the ISA variants: run_step, run_fast, run_packed
+static const char *const variant_names[CPU_ISA_COUNT][3] = {
+    [CPU_ISA_BASELINE] = {"run_step (baseline)", "run_fast (baseline)",
+                          "run_packed (baseline)"},
+    [CPU_ISA_AVX2] = {"run_step (avx2)", "run_fast (avx2)",
+                      "run_packed (avx2)"},
+    [CPU_ISA_AVX512] = {"run_step (avx512)", "run_fast (avx512)",
+                        "run_packed (avx512)"},
+};
+static fuzz_case fuzz_failure;
+static int fuzz_failed;
+
+// ============================================================================
+// GENERATORS
+// ============================================================================
+
+/* A mode from opcode_modes, or (1 in 32) any mode below MODE_COUNT */
+static uint8_t random_mode(fuzz_rng *rng, uint8_t opcode) {
+  if (opcode == OPCODE_B)
+    return (uint8_t)rng_below(rng, COND_COUNT);
+  if (rng_below(rng, 32) == 0)
+    return (uint8_t)rng_below(rng, MODE_COUNT);
+  for (;;) {
+    uint8_t mode = (uint8_t)rng_below(rng, MODE_COUNT);
+    if ((opcode_modes[opcode] >> mode) & 1)
+      return mode;
+  }
+}
+
+static void random_registers(fuzz_rng *rng, CPU *cpu) {
+  cpu->A = rng_byte(rng);
+  cpu->X = rng_byte(rng);
+  cpu->flags = rng_byte(rng) & (FLAG_CARRY | FLAG_ZERO | FLAG_NEGATIVE |
+                                FLAG_OVERFLOW);
+  cpu->SP = rng_below(rng, 16) == 0
+                ? rng_byte(rng) // Anywhere: stack checks are compared too
+                : (uint8_t)(STACK_BASE - rng_below(rng, STACK_SIZE + 1));
+}
+
+#define FUZZ_DATA 0xC0 // Most memory operands and pointers land above
+
+/* Full image: instructions below FUZZ_DATA, data above. HALTs, illegal
+   opcodes and bad modes are rare (~1% each), branch targets and memory
+   operands mostly well-formed, so programs run long enough to reach
+   interesting state while stray stores still hit code now and then. */
+static void random_image(fuzz_rng *rng, CPU *cpu) {
+  initCPU(cpu);
+  for (int i = 0; i < FUZZ_DATA; i += 3) {
+    uint8_t opcode;
+    do {
+      opcode = (uint8_t)rng_below(rng, OPCODE_COUNT);
+    } while (opcode == OPCODE_HALT && rng_below(rng, 4) != 0);
+    uint8_t mode = random_mode(rng, opcode);
+    uint8_t operand = rng_byte(rng);
+
+    if (rng_below(rng, 128) == 0)
+      opcode = (uint8_t)(OPCODE_COUNT + rng_below(rng, 256 - OPCODE_COUNT));
+    if (rng_below(rng, 128) == 0)
+      mode = (uint8_t)(MODE_COUNT + rng_below(rng, 256 - MODE_COUNT));
+    if (rng_below(rng, 8) != 0) {
+      if (opcode == OPCODE_B || opcode == OPCODE_JSR ||
+          (opcode == OPCODE_JMP && mode == MODE_ABSOLUTE))
+        operand = (uint8_t)(3 * rng_below(rng, FUZZ_DATA / 3));
+      else if (mode == MODE_REGISTER &&
+               (opcode == OPCODE_PUSH || opcode == OPCODE_POP))
+        operand = (uint8_t)rng_below(rng, STACK_REGS_ALL + 1);
+      else if (mode != MODE_IMMEDIAT)
+        operand = (uint8_t)(FUZZ_DATA + rng_below(rng, 256 - FUZZ_DATA));
+    }
+    cpu->memory[i] = opcode;
+    cpu->memory[i + 1] = mode;
+    cpu->memory[i + 2] = operand;
+  }
+  for (int i = FUZZ_DATA; i < MAX_MEMORY_SIZE; i++)
+    cpu->memory[i] = rng_below(rng, 4) == 0
+                         ? rng_byte(rng)
+                         : (uint8_t)(FUZZ_DATA + rng_below(rng, 256 - FUZZ_DATA));
+  random_registers(rng, cpu);
+  cpu->PC = rng_below(rng, 16) == 0 ? rng_byte(rng)
+                                    : (uint8_t)(3 * rng_below(rng, FUZZ_DATA / 3));
+}
+
+#define PACKED_DATA 0x80 // Data and stack above, code below in both formats
+
+/* Restricted image for the packed engine: count instructions from 0, mostly
+   valid forms, memory operands in [PACKED_DATA, 256), HALT at the end. No
+   JSR/RTS/JMP: code addresses in memory differ between the formats. No
+   MOVE/FILL: they write at X, which may be code. */
+static int random_packed_image(fuzz_rng *rng, CPU *cpu) {
+  int count = 2 + (int)rng_below(rng, 40);
+
+  initCPU(cpu);
+  for (int i = PACKED_DATA; i < MAX_MEMORY_SIZE; i++)
+    cpu->memory[i] = rng_byte(rng);
+  for (int i = 0; i < count; i++) {
+    uint8_t opcode, mode, operand = rng_byte(rng);
+
+    do {
+      opcode = i == count - 1 ? OPCODE_HALT
+                              : (uint8_t)rng_below(rng, OPCODE_COUNT);
+      mode = random_mode(rng, opcode);
+      // No computed addresses: they could reach code, which differs
+    } while (opcode == OPCODE_JSR || opcode == OPCODE_RTS ||
+             opcode == OPCODE_JMP || opcode == OPCODE_MOVE ||
+             opcode == OPCODE_FILL ||
+             (opcode != OPCODE_B &&
+              (mode == MODE_ABSOLUTE_X || mode == MODE_INDIRECT ||
+               mode == MODE_INDIRECT_X)));
+    if (opcode == OPCODE_B)
+      operand = (uint8_t)(3 * rng_below(rng, (unsigned)count));
+    else if (mode == MODE_ABSOLUTE)
+      operand = (uint8_t)(PACKED_DATA + rng_below(rng, PACKED_DATA));
+    cpu->memory[3 * i] = opcode;
+    cpu->memory[3 * i + 1] = mode;
+    cpu->memory[3 * i + 2] = operand;
+  }
+  random_registers(rng, cpu);
+  cpu->SP = (uint8_t)(STACK_BASE - rng_below(rng, STACK_SIZE + 1));
+  cpu->PC = (uint8_t)(3 * rng_below(rng, (unsigned)count));
+  return count;
+}
+
+/* 3-byte restricted image -> 2-byte packed image (branch targets remapped) */
+static void to_packed(const CPU *in, CPU *out) {
+  *out = *in;
+  __builtin_memset(out->memory, 0, PACKED_DATA);
+  for (int pc = 0; pc + 2 < PACKED_DATA; pc += 3) {
+    uint8_t opcode = in->memory[pc];
+    uint8_t operand = in->memory[pc + 2];
+    if (opcode == OPCODE_B)
+      operand = (uint8_t)(operand / 3 * 2);
+    out->memory[pc / 3 * 2] = PACK_INST_BYTE(opcode, in->memory[pc + 1]);
+    out->memory[pc / 3 * 2 + 1] = operand;
+  }
+  out->PC = (uint8_t)(in->PC / 3 * 2);
+}
+
+/* 3-byte restricted image -> packed v2 image (cpu_pack_v2 of the code below
+   PACKED_DATA). to_wide maps each v2 instruction start, and the end of the
+   code, back to its 3-byte address; other entries are 0xFF, never a PC of
+   the restricted code. Returns 0, -1 if cpu_pack_v2 rejects the code. */
+static int to_packed_v2(const CPU *in, CPU *out, uint8_t *to_wide) {
+  const unsigned len = PACKED_DATA / 3 * 3;
+  unsigned size = 0;
+
+  *out = *in;
+  __builtin_memset(out->memory, 0, PACKED_DATA);
+  if (cpu_pack_v2(in->memory, len, CPU_FORMAT_WIDE, out->memory,
+                  PACKED_DATA) < 0)
+    return -1;
+  __builtin_memset(to_wide, 0xFF, MAX_MEMORY_SIZE);
+  for (unsigned pc = 0; pc < len; pc += 3) {
+    if (pc == in->PC)
+      out->PC = (uint8_t)size;
+    to_wide[size] = (uint8_t)pc;
+    size += packed_v2_length(
+        PACK_INST_BYTE(in->memory[pc], in->memory[pc + 1]));
+  }
+  to_wide[size] = (uint8_t)len;
+  return 0;
+}
+
+// ============================================================================
+// COMPARISON
+// ============================================================================
+
+/* NULL when equal, else the first differing field */
+static const char *fuzz_diff(const CPU *a, const CPU *b, int from, int to) {
+  if (a->A != b->A)
+    return "A";
+  if (a->X != b->X)
+    return "X";
+  if (a->PC != b->PC)
+    return "PC";
+  if (a->SP != b->SP)
+    return "SP";
+  if (a->flags != b->flags)
+    return "flags";
+  if (__builtin_memcmp(a->memory + from, b->memory + from,
+                       (size_t)(to - from)) != 0)
+    return "memory";
+  return NULL;
+}
+
+/* Run one case on every engine. Returns 0, or 1 with engine/detail set. */
+static int fuzz_run(fuzz_case *c) {
+  CPU ref = c->cpu, other;
+  uint64_t steps = 0, retired;
+  int result = CPU_OK;
+  const char *diff;
+
+  if (c->packed) {
+    CPU packed, v2;
+    uint8_t v2_to_wide[MAX_MEMORY_SIZE];
+    int has_v2 = to_packed_v2(&c->cpu, &v2, v2_to_wide) == 0;
+    to_packed(&c->cpu, &packed);
+    for (; steps < c->steps && result == CPU_OK; steps++) {
+      result = cpu_step(&ref);
+      int packed_result = cpu_step_packed(&packed);
+      other = packed;
+      other.PC = (uint8_t)(packed.PC / 2 * 3);
+      if (packed_result != result ||
+          (diff = fuzz_diff(&ref, &other, PACKED_DATA, MAX_MEMORY_SIZE))) {
+        c->engine = "cpu_step_packed";
+        c->detail = packed_result != result ? "result" : diff;
+        c->steps = steps + 1;
+        return 1;
+      }
+      if (!has_v2)
+        continue;
+      int v2_result = cpu_step_packed_v2(&v2);
+      other = v2;
+      other.PC = v2_to_wide[v2.PC];
+      if (v2_result != result ||
+          (diff = fuzz_diff(&ref, &other, PACKED_DATA, MAX_MEMORY_SIZE))) {
+        c->engine = "cpu_step_packed_v2";
+        c->detail = v2_result != result ? "result" : diff;
+        c->steps = steps + 1;
+        return 1;
+      }
+    }
+
+    // Packed loops of the ISA variants over the same prefix
+    for (int isa = 0; isa < CPU_ISA_COUNT; isa++) {
+      if (!fuzz_variants[isa])
+        continue;
+      to_packed(&c->cpu, &other);
+      int run_result = fuzz_variants[isa]->run_packed(&other, steps, &retired);
+      other.PC = (uint8_t)(other.PC / 2 * 3);
+      if (run_result != result || retired != steps ||
+          (diff = fuzz_diff(&ref, &other, PACKED_DATA, MAX_MEMORY_SIZE))) {
+        c->engine = variant_names[isa][2];
+        c->detail = run_result != result ? "result"
+                    : retired != steps   ? "retired"
+                                         : diff;
+        c->steps = steps;
+        return 1;
+      }
+    }
+    return 0;
+  }
+
+  // Reference + stepped engines, in lock step
+  CPU debug = c->cpu, unchecked = c->cpu;
+  CPUDebug dbg = c->dbg;
+  CPUVerifyInfo info;
+  int verified = cpu_verify(&c->cpu, &info);
+  if (verified)
+    atomic_fetch_add_explicit(&fuzz_verified, 1, memory_order_relaxed);
+
+  while (steps < c->steps && result == CPU_OK) {
+    result = cpu_step(&ref);
+    steps++;
+
+    int debug_result;
+    do {
+      debug_result = cpu_step_debug(&debug, &dbg);
+    } while (debug_result == CPU_BREAK);
+    if (debug_result != result ||
+        (diff = fuzz_diff(&ref, &debug, 0, MAX_MEMORY_SIZE))) {
+      c->engine = "cpu_step_debug";
+      c->detail = debug_result != result ? "result" : diff;
+      c->steps = steps;
+      return 1;
+    }
+    if (verified) {
+      int unchecked_result = cpu_step_unchecked(&unchecked);
+      if (unchecked_result != result ||
+          (diff = fuzz_diff(&ref, &unchecked, 0, MAX_MEMORY_SIZE))) {
+        c->engine = "cpu_step_unchecked";
+        c->detail = unchecked_result != result ? "result" : diff;
+        c->steps = steps;
+        return 1;
+      }
+    }
+  }
+
+  atomic_fetch_add_explicit(&fuzz_steps, steps, memory_order_relaxed);
+
+  // Budgeted engine over the same prefix
+  other = c->cpu;
+  int fast_result = cpu_run_fast(&other, steps, &retired);
+  if (fast_result != result || retired != steps ||
+      (diff = fuzz_diff(&ref, &other, 0, MAX_MEMORY_SIZE))) {
+    c->engine = "cpu_run_fast";
+    c->detail = fast_result != result ? "result"
+                : retired != steps    ? "retired"
+                                      : diff;
+    c->steps = steps;
+    return 1;
+  }
+
+  // ISA variants of the budgeted engines
+  for (int isa = 0; isa < CPU_ISA_COUNT; isa++) {
+    if (!fuzz_variants[isa])
+      continue;
+    const cpu_run_fn runs[2] = {fuzz_variants[isa]->run_step,
+                                fuzz_variants[isa]->run_fast};
+    for (int r = 0; r < 2; r++) {
+      other = c->cpu;
+      fast_result = runs[r](&other, steps, &retired);
+      if (fast_result != result || retired != steps ||
+          (diff = fuzz_diff(&ref, &other, 0, MAX_MEMORY_SIZE))) {
+        c->engine = variant_names[isa][r];
+        c->detail = fast_result != result ? "result"
+                    : retired != steps    ? "retired"
+                                          : diff;
+        c->steps = steps;
+        return 1;
+      }
+    }
+  }
+
+  // Translated blocks (folding, dead flags, code invalidation)
+  CPUBlockCache *cache = cpu_block_cache_create();
+  if (cache) {
+    other = c->cpu;
+    fast_result = cpu_run_blocks(&other, cache, steps, &retired);
+    cpu_block_cache_destroy(cache);
+    if (fast_result != result || retired != steps ||
+        (diff = fuzz_diff(&ref, &other, 0, MAX_MEMORY_SIZE))) {
+      c->engine = "cpu_run_blocks";
+      c->detail = fast_result != result ? "result"
+                  : retired != steps    ? "retired"
+                                        : diff;
+      c->steps = steps;
+      return 1;
+    }
+  }
+
+  // Run-to-halt engine, only where the reference halted
+  if (result == CPU_HALTED) {
+    other = c->cpu;
+    cpu_run_tailcall(&other);
+    if ((diff = fuzz_diff(&ref, &other, 0, MAX_MEMORY_SIZE))) {
+      c->engine = "cpu_run_tailcall";
+      c->detail = diff;
+      c->steps = steps;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// ============================================================================
+// MINIMISATION
+// ============================================================================
+
+/* Shrink a failing case while it keeps failing on the same engine */
+static void fuzz_minimize(fuzz_case *c) {
+  fuzz_case trial;
+  int changed = 1;
+
+  // Budget: fuzz_run already cut it to the diverging step
+  while (changed) {
+    changed = 0;
+    // Instructions -> NOP (packed cases keep their HALT and layout)
+    for (int pc = 0; pc < MAX_MEMORY_SIZE; pc += 3) {
+      if (c->cpu.memory[pc] == OPCODE_NOP &&
+          c->cpu.memory[(pc + 1) & 0xFF] == 0 &&
+          c->cpu.memory[(pc + 2) & 0xFF] == 0)
+        continue;
+      if (c->packed && (pc >= PACKED_DATA || c->cpu.memory[pc] == OPCODE_HALT))
+        continue;
+      trial = *c;
+      trial.cpu.memory[pc] = OPCODE_NOP;
+      trial.cpu.memory[(pc + 1) & 0xFF] = 0;
+      trial.cpu.memory[(pc + 2) & 0xFF] = 0;
+      if (fuzz_run(&trial) && trial.engine == c->engine) {
+        *c = trial;
+        changed = 1;
+      }
+    }
+    // Remaining bytes -> 0
+    for (int i = 0; i < MAX_MEMORY_SIZE; i++) {
+      if (c->cpu.memory[i] == 0 || (c->packed && i < PACKED_DATA))
+        continue;
+      trial = *c;
+      trial.cpu.memory[i] = 0;
+      if (fuzz_run(&trial) && trial.engine == c->engine) {
+        *c = trial;
+        changed = 1;
+      }
+    }
+    // Debugger setup
+    for (int i = 0; i < MAX_MEMORY_SIZE / 64; i++) {
+      trial = *c;
+      trial.dbg.breakpoints.bits[i] = 0;
+      trial.dbg.watch_read.bits[i] = 0;
+      trial.dbg.watch_write.bits[i] = 0;
+      if (__builtin_memcmp(&trial.dbg, &c->dbg, sizeof(CPUDebug)) != 0 &&
+          fuzz_run(&trial) && trial.engine == c->engine) {
+        *c = trial;
+        changed = 1;
+      }
+    }
+  }
+}
+
+static void fuzz_print(const fuzz_case *c) {
+  printf("DIVERGENCE: %s differs from cpu_step (%s) at step %llu%s\n",
+         c->engine, c->detail, (unsigned long long)c->steps,
+         c->packed ? " (3-byte image shown, run packed)" : "");
+  printf("  A=0x%02X X=0x%02X PC=0x%02X SP=0x%02X flags=0x%02X\n", c->cpu.A,
+         c->cpu.X, c->cpu.PC, c->cpu.SP, c->cpu.flags);
+  printf("  uint8_t memory[256] = {\n");
+  for (int i = 0; i < MAX_MEMORY_SIZE; i += 12) {
+    printf("     ");
+    for (int j = i; j < i + 12 && j < MAX_MEMORY_SIZE; j++)
+      printf(" 0x%02X,", c->cpu.memory[j]);
+    printf("\n");
+  }
+  printf("  };\n");
+  for (int i = 0; i < MAX_MEMORY_SIZE; i++) {
+    if (bitmap_test(&c->dbg.breakpoints, (uint8_t)i))
+      printf("  breakpoint 0x%02X\n", i);
+    if (bitmap_test(&c->dbg.watch_read, (uint8_t)i) ||
+        bitmap_test(&c->dbg.watch_write, (uint8_t)i))
+      printf("  watch 0x%02X %s%s\n", i,
+             bitmap_test(&c->dbg.watch_read, (uint8_t)i) ? "r" : "",
+             bitmap_test(&c->dbg.watch_write, (uint8_t)i) ? "w" : "");
+  }
+}
+
+// ============================================================================
+// DRIVER
+// ============================================================================
+
+typedef struct {
+  uint64_t seed;
+  uint64_t steps;
+  uint64_t quota; // Programs for this thread, 0 = until stopped
+} fuzz_worker;
+
+static void *fuzz_thread(void *arg) {
+  const fuzz_worker *worker = arg;
+  fuzz_rng rng = {worker->seed ? worker->seed : 1};
+  fuzz_case c;
+
+  for (uint64_t n = 0; !worker->quota || n < worker->quota; n++) {
+    if (atomic_load_explicit(&fuzz_stop, memory_order_relaxed))
+      break;
+
+    __builtin_memset(&c, 0, sizeof(c));
+    c.steps = worker->steps;
+    c.packed = (n & 3) == 3; // One case in four on the packed engine
+    if (c.packed) {
+      random_packed_image(&rng, &c.cpu);
+    } else {
+      random_image(&rng, &c.cpu);
+      cpu_debug_init(&c.dbg);
+      for (unsigned i = rng_below(&rng, 4); i > 0; i--)
+        cpu_debug_set_breakpoint(&c.dbg, rng_byte(&rng));
+      for (unsigned i = rng_below(&rng, 4); i > 0; i--)
+        cpu_debug_set_watch(&c.dbg, rng_byte(&rng),
+                            (int)(1 + rng_below(&rng, 3)));
+    }
+
+    fuzz_case original = c;
+    if (fuzz_run(&c)) {
+      atomic_store(&fuzz_stop, 1);
+      original.engine = c.engine;
+      original.detail = c.detail;
+      original.steps = c.steps;
+      fuzz_minimize(&original);
+      pthread_mutex_lock(&fuzz_lock);
+      if (!fuzz_failed) {
+        fuzz_failed = 1;
+        fuzz_failure = original;
+      }
+      pthread_mutex_unlock(&fuzz_lock);
+      break;
+    }
+    atomic_fetch_add_explicit(&fuzz_programs, 1, memory_order_relaxed);
+  }
+  return NULL;
+}
+
+static double now_seconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char *argv[]) {
+  long threads = sysconf(_SC_NPROCESSORS_ONLN);
+  uint64_t programs = 1000000, steps = FUZZ_DEFAULT_STEPS;
+  uint64_t seed = (uint64_t)time(NULL);
+  double duration = 0;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "t:n:d:k:s:")) != -1) {
+    switch (opt) {
+    case 't':
+      threads = atol(optarg);
+      break;
+    case 'n':
+      programs = strtoull(optarg, NULL, 0);
+      break;
+    case 'd':
+      duration = atof(optarg);
+      programs = 0;
+      break;
+    case 'k':
+      steps = strtoull(optarg, NULL, 0);
+      break;
+    case 's':
+      seed = strtoull(optarg, NULL, 0);
+      break;
+    default:
+      fprintf(stderr,
+              "usage: %s [-t threads] [-n programs] [-d seconds] "
+              "[-k steps] [-s seed]\n",
+              argv[0]);
+      return 2;
+    }
+  }
+  if (threads < 1)
+    threads = 1;
+
+  pthread_t *tids = calloc((size_t)threads, sizeof(pthread_t));
+  fuzz_worker *workers = calloc((size_t)threads, sizeof(fuzz_worker));
+  if (!tids || !workers)
+    return 2;
+  printf("=== Differential fuzzer ===\n");
+  printf("Threads: %ld, steps: %llu, seed: %llu, %s", threads,
+         (unsigned long long)steps, (unsigned long long)seed,
+         programs ? "" : "until stopped\n");
+  if (programs)
+    printf("programs: %llu\n", (unsigned long long)programs);
+
+  printf("ISA variants:");
+  for (int isa = 0; isa < CPU_ISA_COUNT; isa++) {
+    fuzz_variants[isa] = cpu_engines_isa((CPUIsa)isa);
+    if (fuzz_variants[isa])
+      printf(" %s", fuzz_variants[isa]->name);
+  }
+  printf("\n");
+
+  double start = now_seconds();
+  for (long t = 0; t < threads; t++) {
+    workers[t].seed = seed * 0x9E3779B97F4A7C15ULL + (uint64_t)t + 1;
+    workers[t].steps = steps;
+    workers[t].quota = programs ? (programs + (uint64_t)threads - 1) /
+                                      (uint64_t)threads
+                                : 0;
+    pthread_create(&tids[t], NULL, fuzz_thread, &workers[t]);
+  }
+  if (duration > 0) {
+    while (!atomic_load(&fuzz_stop) && now_seconds() - start < duration)
+      usleep(100000);
+    atomic_store(&fuzz_stop, 1);
+  }
+  for (long t = 0; t < threads; t++)
+    pthread_join(tids[t], NULL);
+  double elapsed = now_seconds() - start;
+  free(tids);
+  free(workers);
+
+  uint64_t done = atomic_load(&fuzz_programs);
+  printf("Programs: %llu (%llu verified) in %.2f s, %.0f programs/min\n",
+         (unsigned long long)done,
+         (unsigned long long)atomic_load(&fuzz_verified), elapsed,
+         elapsed > 0 ? (double)done * 60.0 / elapsed : 0.0);
+  printf("Average steps per 3-byte program: %.1f\n",
+         done ? (double)atomic_load(&fuzz_steps) / (double)done * 4 / 3 : 0.0);
+  if (fuzz_failed) {
+    fuzz_print(&fuzz_failure);
+    return 1;
+  }
+  printf("No divergence\n");
+  return 0;
+}
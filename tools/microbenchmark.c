@@ -27,6 +27,7 @@
        ./microbench                # run both decoders, default 10_000_000 steps
        ./microbench 5000000 42    # run both, 5M steps, seed 42
        ./microbench packed 2000000 123 debug  # run only packed, debug on
+       ./microbench perf                      # add perf_event_open counters
 */
 
 #include <stdio.h>
@@ -35,16 +36,42 @@
 #include <string.h>
 #include <time.h>
 #include <math.h>
+#ifdef __APPLE__
 #include <mach/mach_time.h>
+#endif
 
 #include "../cpu.h"
+#include "perf_counters.h"
 
 /* ---------------- timing ---------------- */
 static inline uint64_t now_ns(void) {
+#ifdef __APPLE__
     static mach_timebase_info_data_t tb = {0,0};
     if (tb.denom == 0) mach_timebase_info(&tb);
     uint64_t t = mach_absolute_time();
     return (t * tb.numer) / tb.denom;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+/* ---------------- hardware counters ----------------
+   Enabled with the 'perf' argument: every run_with_step call is counted,
+   measured reps are summed and reported per guest instruction. */
+static PerfCounters *perf = NULL;
+
+static void perf_accumulate(uint64_t *sum) {
+    for (int i = 0; i < PERF_EVENT_COUNT; i++)
+        sum[i] += perf->value[i];
+}
+
+static void perf_print(const uint64_t *sum, uint64_t guest_instructions) {
+    PerfCounters total = *perf;
+    memcpy(total.value, sum, sizeof(total.value));
+    printf("  counters (all reps):\n");
+    perf_counters_report(&total, guest_instructions, "    ");
 }
 
 /* ---------------- constants derived from cpu.h ---------------- */
@@ -260,6 +287,7 @@ static uint64_t run_with_step(const CPU *template_cpu, step_fn step,
     /* Pre-calculate debug parameters to minimize hot loop overhead */
     uint64_t next_debug_step = dbg_enabled ? dbg_interval : UINT64_MAX;
 
+    if (perf) perf_counters_start(perf);
     uint64_t t0 = now_ns();
     for (int r = 0; r < reps; ++r) {
         CPU cpu;
@@ -297,6 +325,7 @@ static uint64_t run_with_step(const CPU *template_cpu, step_fn step,
         final_pc_sink += cpu.PC;
     }
     uint64_t t1 = now_ns();
+    if (perf) perf_counters_stop(perf);
 
     if (out_steps)  *out_steps  = total_steps;
     if (out_errors) *out_errors = total_errors;
@@ -371,13 +400,15 @@ int main(int argc, char **argv) {
     int diagnostic_mode = 0;
 
     /* simple arg parsing:
-       ./microbench [packed] [cycles] [seed] [debug] [prefill] [reps=N]
+       ./microbench [packed] [cycles] [seed] [debug] [prefill] [perf] [reps=N]
     */
+    PerfCounters counters;
     for (int i = 1; i < argc; ++i) {
         if (strcmp(argv[i], "packed") == 0) { run_packed_only = 1; continue; }
         if (strcmp(argv[i], "debug") == 0) { dbg_enabled = 1; continue; }
         if (strcmp(argv[i], "prefill") == 0) { prefill = 1; continue; }
         if (strcmp(argv[i], "diag") == 0) { diagnostic_mode = 1; continue; }
+        if (strcmp(argv[i], "perf") == 0) { perf = &counters; continue; }
         if (strncmp(argv[i], "reps=", 5) == 0) {
             int r = atoi(argv[i] + 5);
             if (r > 0) num_reps = r;
@@ -396,6 +427,14 @@ int main(int argc, char **argv) {
            run_packed_only ? "packed" : "both", num_reps);
     if (dbg_enabled) printf("microbench: debug enabled\n");
     if (diagnostic_mode) printf("microbench: diagnostic mode enabled\n");
+    if (perf && perf_counters_open(perf) == 0) {
+        printf("microbench: hardware counters unavailable (%s)\n",
+               strerror(perf->error[PERF_CYCLES]));
+        perf = NULL;
+    } else if (perf) {
+        printf("microbench: hardware counters: %d of %d events\n",
+               perf->opened, PERF_EVENT_COUNT);
+    }
 
     /* Build normal and packed templates from the single `program[]` array */
     CPU tmpl_normal;
@@ -444,6 +483,7 @@ int main(int argc, char **argv) {
     if (!run_packed_only) {
         uint64_t *times_normal = malloc((num_reps + 1) * sizeof(uint64_t));
         uint64_t total_steps_normal = 0;
+        uint64_t perf_normal[PERF_EVENT_COUNT] = {0};
 
         /* Burn-in run (not counted in statistics) */
         printf("microbench: 3-byte burn-in run...\n");
@@ -460,6 +500,7 @@ int main(int argc, char **argv) {
             uint64_t steps3 = 0, errors3 = 0, halts3 = 0;
             times_normal[rep] = run_with_step(&tmpl_normal, cpu_step, cycles, 1, &steps3, &errors3, &halts3);
             if (rep == 0) total_steps_normal = steps3; /* Assume same for all reps */
+            if (perf) perf_accumulate(perf_normal);
 
             if (diagnostic_mode) {
                 printf("  3-byte rep %d: %llu ns (%.3f ns/op)\n", rep + 1,
@@ -476,6 +517,7 @@ int main(int argc, char **argv) {
         stats_t stats_normal;
         calculate_stats(times_normal, num_reps, total_steps_normal, &stats_normal);
         print_stats("cpu_step (3-byte)", &stats_normal, total_steps_normal);
+        if (perf) perf_print(perf_normal, total_steps_normal * (uint64_t)num_reps);
         free(times_normal);
     }
 
@@ -483,6 +525,7 @@ int main(int argc, char **argv) {
     {
         uint64_t *times_packed = malloc((num_reps + 1) * sizeof(uint64_t));
         uint64_t total_steps_packed = 0;
+        uint64_t perf_packed[PERF_EVENT_COUNT] = {0};
 
         /* Burn-in run (not counted in statistics) */
         printf("microbench: packed burn-in run...\n");
@@ -499,6 +542,7 @@ int main(int argc, char **argv) {
             uint64_t steps_p = 0, errors_p = 0, halts_p = 0;
             times_packed[rep] = run_with_step(&tmpl_packed, cpu_step_packed, cycles, 1, &steps_p, &errors_p, &halts_p);
             if (rep == 0) total_steps_packed = steps_p; /* Assume same for all reps */
+            if (perf) perf_accumulate(perf_packed);
 
             if (diagnostic_mode) {
                 printf("  packed rep %d: %llu ns (%.3f ns/op)\n", rep + 1,
@@ -515,10 +559,12 @@ int main(int argc, char **argv) {
         stats_t stats_packed;
         calculate_stats(times_packed, num_reps, total_steps_packed, &stats_packed);
         print_stats("cpu_step_packed (2-byte)", &stats_packed, total_steps_packed);
+        if (perf) perf_print(perf_packed, total_steps_packed * (uint64_t)num_reps);
         free(times_packed);
     }
 
     /* done */
     (void)final_pc_sink;
+    if (perf) perf_counters_close(perf);
     return 0;
 }
@@ -0,0 +1,167 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+/*
+ * Hardware performance counters around a measured run (benchmark tools only).
+ *
+ * Each event gets its own perf_event_open descriptor on the calling thread,
+ * user space only, so an event the host cannot count (no PMU in a VM, no
+ * L1-icache event on the core, perf_event_paranoid too high) is reported as
+ * unavailable without taking the others down. Counts are scaled by
+ * time_enabled / time_running when the kernel had to multiplex them.
+ *
+ * Results are divided by the guest instructions retired in the run: host
+ * cycles, host instructions, branch misses and L1-icache misses per guest
+ * instruction, plus IPC. Non-Linux builds get stubs that report nothing.
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+enum {
+  PERF_CYCLES = 0x00,
+  PERF_INSTRUCTIONS,
+  PERF_BRANCH_MISSES,
+  PERF_L1I_MISSES,
+  PERF_EVENT_COUNT,
+};
+
+static const char *const perf_event_names[PERF_EVENT_COUNT] = {
+    "cycles", "instructions", "branch-misses", "L1-icache-misses"};
+
+typedef struct {
+  int fd[PERF_EVENT_COUNT];          // -1 when the event could not be opened
+  uint64_t value[PERF_EVENT_COUNT];  // Scaled counts of the last run
+  int error[PERF_EVENT_COUNT];       // errno of a failed open
+  int opened;                        // Events available
+} PerfCounters;
+
+#ifdef __linux__
+
+static int perf_event_open_one(uint32_t type, uint64_t config) {
+  struct perf_event_attr attr;
+
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = type;
+  attr.config = config;
+  attr.disabled = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format =
+      PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+  return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+/* Open every event on the calling thread. Returns the number available. */
+static inline int perf_counters_open(PerfCounters *pc) {
+  static const struct {
+    uint32_t type;
+    uint64_t config;
+  } events[PERF_EVENT_COUNT] = {
+      {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+      {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+      {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+      {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1I |
+                               (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                               (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+  };
+
+  memset(pc, 0, sizeof(*pc));
+  for (int i = 0; i < PERF_EVENT_COUNT; i++) {
+    pc->fd[i] = perf_event_open_one(events[i].type, events[i].config);
+    if (pc->fd[i] < 0)
+      pc->error[i] = errno;
+    else
+      pc->opened++;
+  }
+  return pc->opened;
+}
+
+static inline void perf_counters_close(PerfCounters *pc) {
+  for (int i = 0; i < PERF_EVENT_COUNT; i++)
+    if (pc->fd[i] >= 0)
+      close(pc->fd[i]);
+  pc->opened = 0;
+}
+
+static inline void perf_counters_start(PerfCounters *pc) {
+  for (int i = 0; i < PERF_EVENT_COUNT; i++) {
+    if (pc->fd[i] < 0)
+      continue;
+    ioctl(pc->fd[i], PERF_EVENT_IOC_RESET, 0);
+    ioctl(pc->fd[i], PERF_EVENT_IOC_ENABLE, 0);
+  }
+}
+
+static inline void perf_counters_stop(PerfCounters *pc) {
+  // Disable everything first so reading one event is not counted by another
+  for (int i = 0; i < PERF_EVENT_COUNT; i++)
+    if (pc->fd[i] >= 0)
+      ioctl(pc->fd[i], PERF_EVENT_IOC_DISABLE, 0);
+
+  for (int i = 0; i < PERF_EVENT_COUNT; i++) {
+    uint64_t data[3]; // value, time_enabled, time_running
+
+    pc->value[i] = 0;
+    if (pc->fd[i] < 0 || read(pc->fd[i], data, sizeof(data)) != sizeof(data))
+      continue;
+    if (data[2] == 0)
+      continue; // Never scheduled on the PMU
+    pc->value[i] = data[2] < data[1]
+                       ? (uint64_t)((double)data[0] * (double)data[1] /
+                                    (double)data[2])
+                       : data[0];
+  }
+}
+
+#else
+
+static inline int perf_counters_open(PerfCounters *pc) {
+  memset(pc, 0, sizeof(*pc));
+  for (int i = 0; i < PERF_EVENT_COUNT; i++) {
+    pc->fd[i] = -1;
+    pc->error[i] = ENOSYS;
+  }
+  return 0;
+}
+
+static inline void perf_counters_close(PerfCounters *pc) { pc->opened = 0; }
+static inline void perf_counters_start(PerfCounters *pc) { (void)pc; }
+static inline void perf_counters_stop(PerfCounters *pc) { (void)pc; }
+
+#endif
+
+/* Print the last run per guest instruction, indented to match the tools */
+static inline void perf_counters_report(const PerfCounters *pc,
+                                        uint64_t guest_instructions,
+                                        const char *indent) {
+  double per = guest_instructions ? 1.0 / (double)guest_instructions : 0.0;
+
+  for (int i = 0; i < PERF_EVENT_COUNT; i++) {
+    if (pc->fd[i] < 0) {
+      printf("%s%-17s unavailable (%s)\n", indent, perf_event_names[i],
+             strerror(pc->error[i]));
+      continue;
+    }
+    printf("%s%-17s %14llu  (%.3f per guest instruction)\n", indent,
+           perf_event_names[i], (unsigned long long)pc->value[i],
+           (double)pc->value[i] * per);
+  }
+  if (pc->fd[PERF_CYCLES] >= 0 && pc->fd[PERF_INSTRUCTIONS] >= 0 &&
+      pc->value[PERF_CYCLES] > 0)
+    printf("%s%-17s %14.2f\n", indent, "IPC",
+           (double)pc->value[PERF_INSTRUCTIONS] /
+               (double)pc->value[PERF_CYCLES]);
+}
+
+#endif // PERF_COUNTERS_H
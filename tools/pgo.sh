@@ -0,0 +1,101 @@
+#!/bin/sh
+# Profile-guided build of the benchmark (make pgo).
+#
+#   1. baseline build with the release flags       build/pgo/benchmark-base
+#   2. instrumented build, trained on the benchmark workloads
+#   3. rebuild with the profile                     build/pgo/benchmark
+#   4. BOLT layout pass when llvm-bolt is installed build/pgo/benchmark-bolt
+#   5. before/after comparison of the engine totals
+#
+# Environment (set by the Makefile): CC, CFLAGS, SRCS, PGO_TRAIN (training
+# iterations), PGO_RUN (comparison iterations), BOLT (llvm-bolt binary).
+set -e
+
+CC=${CC:-cc}
+SRCS=${SRCS:-"cpu.c cpu_arena.c cpu_dispatch.c"}
+PGO_TRAIN=${PGO_TRAIN:-2000}
+PGO_RUN=${PGO_RUN:-50000}
+BOLT=${BOLT:-llvm-bolt}
+OUT=build/pgo
+BIN=$OUT/benchmark
+
+mkdir -p "$OUT"
+rm -rf "$OUT/profile" "$OUT"/*.profraw "$OUT"/*.fdata
+
+if $CC --version 2>/dev/null | grep -qi clang; then
+  GEN="-fprofile-instr-generate=$OUT/benchmark-%p.profraw"
+  USE="-fprofile-instr-use=$OUT/benchmark.profdata"
+  CLANG=1
+else
+  # Same output name for both builds: GCC names the .gcda files after it
+  GEN="-fprofile-generate=$OUT/profile -fprofile-update=single"
+  USE="-fprofile-use=$OUT/profile -fprofile-partial-training -Wno-missing-profile"
+  CLANG=0
+fi
+
+echo "pgo: baseline build"
+$CC $CFLAGS -o "$OUT/benchmark-base" tools/benchmark.c $SRCS
+
+echo "pgo: instrumented build, training ($PGO_TRAIN iterations)"
+$CC $CFLAGS $GEN -o "$BIN" tools/benchmark.c $SRCS
+"$BIN" "$PGO_TRAIN" > "$OUT/train.log"
+if [ $CLANG = 1 ]; then
+  llvm-profdata merge -o "$OUT/benchmark.profdata" "$OUT"/*.profraw
+fi
+
+# BOLT rewrites the binary and needs its relocations
+RELOCS=
+if command -v "$BOLT" > /dev/null 2>&1; then
+  RELOCS=-Wl,--emit-relocs
+fi
+
+echo "pgo: optimized build"
+$CC $CFLAGS $USE $RELOCS -o "$BIN" tools/benchmark.c $SRCS
+
+VARIANTS="base:$OUT/benchmark-base pgo:$BIN"
+if [ -n "$RELOCS" ]; then
+  echo "pgo: BOLT instrumentation and layout"
+  "$BOLT" "$BIN" -instrument -instrumentation-file="$OUT/benchmark.fdata" \
+    -o "$OUT/benchmark-bolt-instr" > "$OUT/bolt.log" 2>&1
+  "$OUT/benchmark-bolt-instr" "$PGO_TRAIN" > /dev/null
+  "$BOLT" "$BIN" -data="$OUT/benchmark.fdata" -o "$OUT/benchmark-bolt" \
+    -reorder-blocks=ext-tsp -reorder-functions=hfsort -split-functions \
+    -split-all-cold -icf=1 >> "$OUT/bolt.log" 2>&1
+  VARIANTS="$VARIANTS pgo+bolt:$OUT/benchmark-bolt"
+else
+  echo "pgo: $BOLT not found, skipping BOLT"
+fi
+
+echo "pgo: comparing ($PGO_RUN iterations)"
+for variant in $VARIANTS; do
+  name=${variant%%:*}
+  "${variant#*:}" "$PGO_RUN" > "$OUT/run-$name.log"
+done
+
+# Engine totals from the summary, each build against the baseline
+echo ""
+echo "=== PGO COMPARISON ==="
+printf "%-26s" "engine"
+for variant in $VARIANTS; do
+  printf "%16s" "${variant%%:*}"
+done
+echo ""
+for engine in normal tail-call cpu_run_fast verified; do
+  printf "%-26s" "$engine"
+  base=$(awk -v e="$engine" '$1 == "Total" && $2 == e { print $4 }' \
+    "$OUT/run-base.log")
+  for variant in $VARIANTS; do
+    name=${variant%%:*}
+    t=$(awk -v e="$engine" '$1 == "Total" && $2 == e { print $4 }' \
+      "$OUT/run-$name.log")
+    if [ "$name" = base ]; then
+      printf "%15.4fs" "$t"
+    else
+      printf "%9.4fs %5.2fx" "$t" "$(awk -v b="$base" -v t="$t" \
+        'BEGIN { print (t > 0 ? b / t : 0) }')"
+    fi
+  done
+  echo ""
+done
+echo ""
+echo "Full runs: $OUT/run-*.log"